@@ -0,0 +1,226 @@
+/*
+ *   affinity.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   CPU lists, sysfs NUMA topology, thread pinning and memory binding.
+ */
+
+#include "iombench.h"
+#include "affinity.h"
+
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+
+#define IOMB_MPOL_BIND 2
+#define IOMB_MPOL_MF_MOVE (1 << 1)
+#endif
+
+/*
+ * "0-3,8,10-11" into l, in the given order. Return 0, or -1 on malformed
+ * input or a CPU number of MAX_CPUS or more.
+ */
+int cpu_list_parse(struct cpu_list *l, const char *spec)
+{
+    const char *p = spec;
+
+    l->nr = 0;
+    while (*p != '\0') {
+        char *end;
+        long first = strtol(p, &end, 10), last;
+
+        if (end == p || first < 0)
+            return -1;
+        last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first)
+                return -1;
+        }
+        if (last >= MAX_CPUS || l->nr + (last - first + 1) > MAX_CPUS)
+            return -1;
+        for (; first <= last; first++)
+            l->cpu[l->nr++] = (int)first;
+        if (*end == ',')
+            end++;
+        else if (*end != '\0')
+            return -1;
+        p = end;
+    }
+    return l->nr > 0 ? 0 : -1;
+}
+
+/* back to the "0-3,8" form, consecutive CPUs as ranges */
+void cpu_list_format(const struct cpu_list *l, char *buf, size_t len)
+{
+    size_t used = 0;
+    int i = 0;
+
+    buf[0] = '\0';
+    while (i < l->nr && used < len) {
+        int j = i;
+        while (j + 1 < l->nr && l->cpu[j + 1] == l->cpu[j] + 1)
+            j++;
+        if (j == i)
+            used += snprintf(buf + used, len - used, "%s%d",
+                             i == 0 ? "" : ",", l->cpu[i]);
+        else
+            used += snprintf(buf + used, len - used, "%s%d-%d",
+                             i == 0 ? "" : ",", l->cpu[i], l->cpu[j]);
+        i = j + 1;
+    }
+}
+
+/* first line of a small sysfs file, -1 if it cannot be read */
+static int read_sysfs(const char *path, char *buf, size_t len)
+{
+    FILE *fp = fopen(path, "r");
+    char *nl;
+
+    if (fp == NULL)
+        return -1;
+    if (fgets(buf, (int)len, fp) == NULL) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    nl = strchr(buf, '\n');
+    if (nl != NULL)
+        *nl = '\0';
+    return 0;
+}
+
+/* the CPUs of a NUMA node. Return 0, or -1 if there is no such node. */
+int numa_node_cpus(int node, struct cpu_list *l)
+{
+    char path[64];
+    char buf[4096];
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+             node);
+    if (read_sysfs(path, buf, sizeof(buf)) != 0)
+        return -1;
+    return cpu_list_parse(l, buf);
+}
+
+/*
+ * NUMA node of the block device holding <path>, or of <path> itself if it
+ * is a block device. A file that does not exist yet is looked up by its
+ * directory. Return -1 if the node is unknown, e.g. for virtual devices or
+ * on a single node machine.
+ */
+int numa_node_of_path(const char *path)
+{
+#ifdef __linux__
+    char sys[64], dev[PATH_MAX], buf[32];
+    struct stat s;
+    dev_t d;
+
+    if (stat(path, &s) != 0) {
+        char *copy = strdup(path);
+        int ret = copy == NULL ? -1 : stat(dirname(copy), &s);
+        free(copy);
+        if (ret != 0)
+            return -1;
+    }
+    d = S_ISBLK(s.st_mode) ? s.st_rdev : s.st_dev;
+    snprintf(sys, sizeof(sys), "/sys/dev/block/%u:%u", major(d), minor(d));
+    if (realpath(sys, dev) == NULL)
+        return -1;
+
+    /* partition, disk, controller, PCI function: the first with a node */
+    while (strcmp(dev, "/sys/devices") != 0 && strchr(dev, '/') != NULL) {
+        char file[PATH_MAX + 16];
+        snprintf(file, sizeof(file), "%s/numa_node", dev);
+        if (read_sysfs(file, buf, sizeof(buf)) == 0)
+            return atoi(buf) >= 0 ? atoi(buf) : -1;
+        *strrchr(dev, '/') = '\0';
+    }
+#else
+    (void)path;
+#endif
+    return -1;
+}
+
+/* restrict the calling thread to the CPUs of l. Return 0 or -errno. */
+int pin_thread(const struct cpu_list *l)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    int i;
+
+    CPU_ZERO(&set);
+    for (i = 0; i < l->nr; i++)
+        CPU_SET(l->cpu[i], &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        return -errno;
+#else
+    (void)l;
+#endif
+    return 0;
+}
+
+/*
+ * Bind the pages of [addr, addr + len) to <node>, addr page aligned.
+ * Return 0 or -errno.
+ */
+int bind_memory(void *addr, size_t len, int node)
+{
+#ifdef __linux__
+    unsigned long mask[MAX_CPUS / (8 * sizeof(unsigned long))];
+
+    if (node < 0 || node >= MAX_CPUS)
+        return -EINVAL;
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] |=
+        1UL << (node % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_mbind, addr, len, IOMB_MPOL_BIND, mask,
+                (unsigned long)MAX_CPUS + 1, IOMB_MPOL_MF_MOVE) != 0)
+        return -errno;
+#else
+    (void)addr;
+    (void)len;
+    (void)node;
+#endif
+    return 0;
+}
+
+/* where the calling thread runs now, -1 if unknown */
+void current_cpu(int *cpu, int *node)
+{
+    *cpu = -1;
+    *node = -1;
+#ifdef __linux__
+    {
+        unsigned int c, n;
+        if (syscall(SYS_getcpu, &c, &n, NULL) == 0) {
+            *cpu = (int)c;
+            *node = (int)n;
+        }
+    }
+#endif
+}
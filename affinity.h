@@ -0,0 +1,53 @@
+/*
+ *   affinity.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   CPU and NUMA placement of the IO threads (--cpus_allowed,
+ *   --cpus_allowed_policy, --numa_node). A thread is pinned before it
+ *   allocates and touches its buffers, so they are placed on its node; with
+ *   --numa_node they are also bound there with mbind(). The node of the
+ *   device under test comes from sysfs: the numa_node file of the first
+ *   parent of /sys/dev/block/<major>:<minor> that has one, usually its PCI
+ *   function. Linux only, elsewhere the options are accepted and ignored.
+ */
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stddef.h>
+
+#define MAX_CPUS 1024
+#define MAX_CPU_LIST_LENGTH 256
+
+/* --numa_node */
+#define NUMA_NODE_NONE -1
+#define NUMA_NODE_LOCAL -2      /* the node of the device, from sysfs */
+
+struct cpu_list {
+    int nr;                     /* 0 if threads are not pinned */
+    int cpu[MAX_CPUS];
+};
+
+int cpu_list_parse(struct cpu_list *l, const char *spec);
+void cpu_list_format(const struct cpu_list *l, char *buf, size_t len);
+int numa_node_cpus(int node, struct cpu_list *l);
+int numa_node_of_path(const char *path);
+int pin_thread(const struct cpu_list *l);
+int bind_memory(void *addr, size_t len, int node);
+void current_cpu(int *cpu, int *node);
+
+#endif /* AFFINITY_H */
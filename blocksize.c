@@ -0,0 +1,169 @@
+/*
+ *   blocksize.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Block size specs: parsing and the precomputed lookup tables.
+ */
+
+#include "iombench.h"
+#include "blocksize.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * "4096", "4k", "64K", "1m", "2g". Binary units. Return -1 on malformed
+ * input.
+ */
+long long parse_size(const char *str)
+{
+    char *end;
+    long long size = strtoll(str, &end, 10);
+
+    if (end == str || size < 0)
+        return -1;
+    switch (*end) {
+    case 'k': case 'K':
+        size *= 1024;
+        end++;
+        break;
+    case 'm': case 'M':
+        size *= 1024 * 1024;
+        end++;
+        break;
+    case 'g': case 'G':
+        size *= 1024LL * 1024 * 1024;
+        end++;
+        break;
+    }
+    if (*end == 'b' || *end == 'B')
+        end++;
+    return *end == '\0' ? size : -1;
+}
+
+static int valid_block_size(long long size)
+{
+    return size >= SECTOR_SIZE && size <= MAX_BLOCK_SIZE &&
+           size % SECTOR_SIZE == 0;
+}
+
+int bs_parse_split(struct bs_spec *bs, const char *spec)
+{
+    char *copy = strdup(spec);
+    char *save = NULL;
+    char *tok;
+    int total = 0;
+    int i, n = 0;
+
+    memset(bs, 0, sizeof(struct bs_spec));
+    strncpy(bs->spec, spec, MAX_BS_SPEC_LENGTH - 1);
+    bs->mode = BS_SPLIT;
+
+    for (tok = strtok_r(copy, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        char *colon = strchr(tok, ':');
+        long long size;
+        int percent;
+
+        if (colon == NULL || n == MAX_BS_CLASSES)
+            goto err;
+        *colon = '\0';
+        size = parse_size(tok);
+        percent = atoi(colon + 1);
+        if (!valid_block_size(size) || percent <= 0 || total + percent > 100)
+            goto err;
+
+        for (i = total; i < total + percent; i++)
+            bs->lookup[i] = n;
+        total += percent;
+        bs->class_size[n++] = (int)size;
+    }
+    if (n == 0 || total != 100)
+        goto err;
+
+    free(copy);
+    bs->nr_classes = n;
+    bs->min_bs = bs->max_bs = bs->class_size[0];
+    for (i = 1; i < n; i++) {
+        if (bs->class_size[i] < bs->min_bs)
+            bs->min_bs = bs->class_size[i];
+        if (bs->class_size[i] > bs->max_bs)
+            bs->max_bs = bs->class_size[i];
+    }
+    return 0;
+err:
+    free(copy);
+    return -1;
+}
+
+int bs_parse_range(struct bs_spec *bs, const char *spec)
+{
+    char *copy = strdup(spec);
+    char *dash = strchr(copy, '-');
+    long long min, max;
+
+    memset(bs, 0, sizeof(struct bs_spec));
+    strncpy(bs->spec, spec, MAX_BS_SPEC_LENGTH - 1);
+    bs->mode = BS_RANGE;
+
+    if (dash == NULL) {
+        free(copy);
+        return -1;
+    }
+    *dash = '\0';
+    min = parse_size(copy);
+    max = parse_size(dash + 1);
+    free(copy);
+    if (!valid_block_size(min) || !valid_block_size(max) || min > max)
+        return -1;
+
+    bs->min_bs = (int)min;
+    bs->max_bs = (int)max;
+    return 0;
+}
+
+/*
+ * Fill in the classes once all options are known. Without --bssplit or
+ * --bsrange the fixed -p size is the only class.
+ */
+int bs_finalize(struct bs_spec *bs, int page_size, int align)
+{
+    int i;
+
+    if (bs->mode == BS_FIXED) {
+        bs->min_bs = bs->max_bs = page_size;
+        bs->nr_classes = 1;
+        bs->class_size[0] = page_size;
+        bs->align = align > 0 ? align : SECTOR_SIZE;
+        return 0;
+    }
+
+    bs->align = align > 0 ? align : bs->min_bs;
+    if (bs->align % SECTOR_SIZE != 0)
+        return -1;
+
+    if (bs->mode == BS_RANGE) {
+        if ((bs->max_bs - bs->min_bs) % bs->align != 0)
+            return -1;
+        bs->range_first_log = bs_log2(bs->min_bs);
+        bs->nr_classes = bs_log2(bs->max_bs) - bs->range_first_log + 1;
+        for (i = 0; i < bs->nr_classes; i++)
+            bs->class_size[i] = 1 << (bs->range_first_log + i);
+        bs->class_size[0] = bs->min_bs;
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ *   blocksize.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Block size selection. A run uses either the fixed -p size, a weighted
+ *   list of sizes (--bssplit 4k:70,64k:20,1m:10) or a uniform range
+ *   (--bsrange 4k-128k, multiples of --bs_align). Every size belongs to a
+ *   class for the per-size statistics: one class per --bssplit entry, one
+ *   per power of two for --bsrange.
+ */
+
+#ifndef BLOCKSIZE_H
+#define BLOCKSIZE_H
+
+#include "rand.h"
+
+#define BS_FIXED 0
+#define BS_SPLIT 1
+#define BS_RANGE 2
+
+#define MAX_BS_CLASSES 24
+#define MAX_BLOCK_SIZE (64 * 1024 * 1024)
+#define MAX_BS_SPEC_LENGTH 256
+
+struct bs_spec {
+    int mode;
+    char spec[MAX_BS_SPEC_LENGTH];
+    int min_bs;
+    int max_bs;
+    int align;
+
+    /* split: entry picked by a uniform draw in [0, 100) */
+    unsigned char lookup[100];
+
+    /* stats classes, class_size[] is the label printed in the report */
+    int nr_classes;
+    int class_size[MAX_BS_CLASSES];
+    int range_first_log;
+};
+
+long long parse_size(const char *str);
+int bs_parse_split(struct bs_spec *bs, const char *spec);
+int bs_parse_range(struct bs_spec *bs, const char *spec);
+int bs_finalize(struct bs_spec *bs, int page_size, int align);
+
+static inline int bs_log2(unsigned int v)
+{
+    return 31 - __builtin_clz(v);
+}
+
+/* block size of the next request and its stats class */
+static inline int bs_next(const struct bs_spec *bs, struct rand_state *st,
+                          int *cls)
+{
+    int size;
+
+    switch (bs->mode) {
+    case BS_SPLIT:
+        *cls = bs->lookup[rand_below(st, 100)];
+        return bs->class_size[*cls];
+    case BS_RANGE:
+        size = bs->min_bs + (int)rand_below(st,
+                   (bs->max_bs - bs->min_bs) / bs->align + 1) * bs->align;
+        *cls = bs_log2(size) - bs->range_first_log;
+        return size;
+    default:
+        *cls = 0;
+        return bs->max_bs;
+    }
+}
+
+#endif /* BLOCKSIZE_H */
@@ -0,0 +1,365 @@
+/*
+ *   compare.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Baseline comparison.
+ */
+
+#include "iombench.h"
+#include "compare.h"
+#include "gettime.h"
+#include "json.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COMPARE_ALPHA 0.05
+#define COMPARE_Z 1.96              /* two sided 95% */
+#define DEFAULT_TAIL_PERCENTILE 99.0
+
+struct verdict {
+    const char *job;
+    const char *metric;
+    double baseline;
+    double current;
+    double p;                       /* < 0 if no p-value */
+    int significant;                /* 1, 0, or -1 if it cannot be tested */
+    int higher_is_better;
+};
+
+/* continued fraction of the regularized incomplete beta function */
+static double betacf(double a, double b, double x)
+{
+    double c = 1.0, d = 1.0 - (a + b) * x / (a + 1.0), h;
+    int m;
+
+    if (fabs(d) < 1e-300)
+        d = 1e-300;
+    d = 1.0 / d;
+    h = d;
+    for (m = 1; m <= 200; m++) {
+        int m2 = 2 * m;
+        double aa = m * (b - m) * x / ((a + m2 - 1) * (a + m2)), del;
+
+        d = 1.0 + aa * d;
+        c = 1.0 + aa / c;
+        if (fabs(d) < 1e-300)
+            d = 1e-300;
+        if (fabs(c) < 1e-300)
+            c = 1e-300;
+        d = 1.0 / d;
+        h *= d * c;
+        aa = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1));
+        d = 1.0 + aa * d;
+        c = 1.0 + aa / c;
+        if (fabs(d) < 1e-300)
+            d = 1e-300;
+        if (fabs(c) < 1e-300)
+            c = 1e-300;
+        d = 1.0 / d;
+        del = d * c;
+        h *= del;
+        if (fabs(del - 1.0) < 1e-12)
+            break;
+    }
+    return h;
+}
+
+static double betai(double a, double b, double x)
+{
+    double bt;
+
+    if (x <= 0.0)
+        return 0.0;
+    if (x >= 1.0)
+        return 1.0;
+    bt = exp(lgamma(a + b) - lgamma(a) - lgamma(b) +
+             a * log(x) + b * log(1.0 - x));
+    if (x < (a + 1.0) / (a + b + 2.0))
+        return bt * betacf(a, b, x) / a;
+    return 1.0 - bt * betacf(b, a, 1.0 - x) / b;
+}
+
+static void mean_var(const double *x, int n, double *mean, double *var)
+{
+    double sum = 0, sq = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+        sum += x[i];
+    *mean = sum / n;
+    for (i = 0; i < n; i++)
+        sq += (x[i] - *mean) * (x[i] - *mean);
+    *var = n > 1 ? sq / (n - 1) : 0.0;
+}
+
+/*
+ * Two sided p-value of Welch's t-test for equal means, with the
+ * Welch-Satterthwaite degrees of freedom. Both sides need two samples.
+ */
+static double welch_p(const double *x, int nx, const double *y, int ny)
+{
+    double mx, vx, my, vy, sx, sy, t, df;
+
+    mean_var(x, nx, &mx, &vx);
+    mean_var(y, ny, &my, &vy);
+    sx = vx / nx;
+    sy = vy / ny;
+    if (sx + sy == 0.0)
+        return mx == my ? 1.0 : 0.0;
+    t = (mx - my) / sqrt(sx + sy);
+    df = (sx + sy) * (sx + sy) /
+         (sx * sx / (nx - 1) + sy * sy / (ny - 1));
+    return betai(df / 2.0, 0.5, df / (df + t * t));
+}
+
+/* a histogram from the JSON results, -1 if its bucket layout differs */
+static int load_hist(const struct json_value *stats, struct histogram *h)
+{
+    const struct json_value *hv = json_get(stats, "histogram");
+    const struct json_value *b, *buckets = json_get(hv, "buckets");
+
+    if (buckets == NULL || buckets->type != JSON_ARRAY ||
+        json_get_number(hv, "sub_bits", 0) != HIST_SUB_BITS ||
+        json_get_number(hv, "max_bits", 0) != HIST_MAX_BITS)
+        return -1;
+    hist_init(h);
+    for (b = buckets->child; b != NULL; b = b->next) {
+        const struct json_value *idx = b->child;
+        int i;
+
+        if (idx == NULL || idx->next == NULL)
+            return -1;
+        i = (int)idx->number;
+        if (i < 0 || i >= HIST_NR_BUCKETS)
+            return -1;
+        h->buckets[i] = (uint64_t)idx->next->number;
+        h->count += h->buckets[i];
+    }
+    h->min = (uint64_t)json_get_number(hv, "min_ns", 0);
+    h->max = (uint64_t)json_get_number(hv, "max_ns", 0);
+    h->sum = (uint64_t)json_get_number(hv, "sum_ns", 0);
+    return 0;
+}
+
+/* 95% confidence bounds of a percentile, from the ranks it may fall on */
+static void percentile_bounds(const struct histogram *h, double percent,
+                              double *lo, double *hi)
+{
+    double q = percent / 100.0;
+    double rank = q * h->count;
+    double half = COMPARE_Z * sqrt(h->count * q * (1.0 - q));
+    double low = rank - half < 1 ? 1 : floor(rank - half);
+
+    *lo = hist_rank_value(h, (uint64_t)low);
+    *hi = hist_rank_value(h, (uint64_t)ceil(rank + half));
+}
+
+/* print or record one result, return 1 for a regression */
+static int report_verdict(struct json_writer *w, const struct verdict *v)
+{
+    double change = v->baseline == 0 ? 0.0 :
+                    100.0 * (v->current - v->baseline) / v->baseline;
+    double worse = v->higher_is_better ? -change : change;
+    const char *result = "ok";
+    static const char *sig[3] = { "unknown", "no", "yes" };
+
+    /* an untestable change is inconclusive, never a regression */
+    if (v->significant > 0 && worse > compare_threshold)
+        result = "regression";
+    else if (v->significant > 0 && worse < -compare_threshold)
+        result = "improvement";
+
+    if (w != NULL) {
+        json_object_begin(w, NULL);
+        json_string(w, "job", v->job);
+        json_string(w, "metric", v->metric);
+        json_double(w, "baseline", v->baseline);
+        json_double(w, "current", v->current);
+        json_double(w, "change_percent", change);
+        if (v->p >= 0)
+            json_double(w, "p", v->p);
+        json_string(w, "significant", sig[v->significant + 1]);
+        json_string(w, "result", result);
+        json_object_end(w);
+    } else {
+        char p[32] = "-";
+        if (v->p >= 0)
+            snprintf(p, sizeof(p), "%.4g", v->p);
+        fprintf(GET_OUTPUT(output_file), "compare: job %s , metric %s , "
+                "baseline %.3f , current %.3f , change(%%) %.2f , p %s , "
+                "significant %s , result %s\n", v->job, v->metric,
+                v->baseline, v->current, change, p,
+                sig[v->significant + 1], result);
+    }
+    return strcmp(result, "regression") == 0;
+}
+
+/* samples of a JSON number array, NULL if there are fewer than two */
+static double *load_samples(const struct json_value *arr, int *n)
+{
+    const struct json_value *c;
+    double *x;
+    int i = 0;
+
+    *n = 0;
+    if (arr == NULL || arr->type != JSON_ARRAY)
+        return NULL;
+    for (c = arr->child; c != NULL; c = c->next)
+        (*n)++;
+    if (*n < 2 || (x = malloc(sizeof(double) * *n)) == NULL)
+        return NULL;
+    for (c = arr->child; c != NULL; c = c->next)
+        x[i++] = c->number;
+    return x;
+}
+
+static int compare_throughput(struct json_writer *w, const struct job *job,
+                              const struct json_value *base)
+{
+    static const char *metrics[2] = { "iops", "bw(B/s)" };
+    static const char *keys[2] = { "iops", "bw_bytes" };
+    const struct json_value *ivl = json_get(base, "intervals");
+    const struct json_value *sum = json_get(base, "summary");
+    double secs = job->wall_ns / (double)NSEC_PER_SEC;
+    double overall[2];
+    int i, regressions = 0;
+
+    overall[0] = secs > 0 ? job->total_hist[DDIR_TOTAL].count / secs : 0;
+    overall[1] = secs > 0 ? job->total_bytes / secs : 0;
+    for (i = 0; i < 2; i++) {
+        const double *cur = i == 0 ? job->iops_samples : job->bw_samples;
+        struct verdict v = { job->name, metrics[i], 0, 0, -1, -1, 1 };
+        int n;
+        double *x = load_samples(json_get(ivl, keys[i]), &n);
+
+        if (x != NULL && job->nr_samples >= 2) {
+            double var;
+            mean_var(x, n, &v.baseline, &var);
+            mean_var(cur, job->nr_samples, &v.current, &var);
+            v.p = welch_p(x, n, cur, job->nr_samples);
+            v.significant = v.p < COMPARE_ALPHA;
+        } else {
+            /* too short to sample, the whole run is the only data point */
+            v.baseline = json_get_number(sum, keys[i], 0);
+            v.current = overall[i];
+        }
+        free(x);
+        regressions += report_verdict(w, &v);
+    }
+    return regressions;
+}
+
+static int compare_latency(struct json_writer *w, const struct job *job,
+                           const struct json_value *base)
+{
+    static const char *dirs[DDIR_RW] = { "read", "write" };
+    const struct json_value *sum = json_get(base, "summary");
+    double tail[MAX_PERCENTILES];
+    int nr_tail = 0, d, i, regressions = 0;
+
+    for (i = 0; i < nr_percentiles; i++)
+        if (percentiles[i] >= 90.0)
+            tail[nr_tail++] = percentiles[i];
+    if (nr_tail == 0)
+        tail[nr_tail++] = DEFAULT_TAIL_PERCENTILE;
+
+    for (d = 0; d < DDIR_RW; d++) {
+        const struct histogram *cur = &job->total_hist[d];
+        struct histogram *h;
+
+        if (cur->count == 0 || json_get(sum, dirs[d]) == NULL)
+            continue;
+        h = malloc(sizeof(struct histogram));
+        if (h == NULL) {
+            perror("compare_latency:malloc()");
+            exit(errno);
+        }
+        if (load_hist(json_get(sum, dirs[d]), h) != 0) {
+            fprintf(stderr, "compare: job %s has no %s histogram with "
+                    "this bucket layout in the baseline.\n", job->name,
+                    dirs[d]);
+            free(h);
+            continue;
+        }
+        for (i = 0; i < nr_tail && h->count > 0; i++) {
+            char metric[64];
+            double blo, bhi, clo, chi;
+            struct verdict v = { job->name, metric, 0, 0, -1, 0, 0 };
+
+            snprintf(metric, sizeof(metric), "%s_p%g(us)", dirs[d], tail[i]);
+            v.baseline = hist_percentile(h, tail[i]) / 1000.0;
+            v.current = hist_percentile(cur, tail[i]) / 1000.0;
+            percentile_bounds(h, tail[i], &blo, &bhi);
+            percentile_bounds(cur, tail[i], &clo, &chi);
+            v.significant = clo > bhi || chi < blo;
+            regressions += report_verdict(w, &v);
+        }
+        free(h);
+    }
+    return regressions;
+}
+
+/*
+ * Compare all jobs against the baseline at <path>, printing "compare:"
+ * lines, or a "compare" object into <w> for JSON output. Return the
+ * number of regressions.
+ */
+int compare_baseline(const char *path, struct json_writer *w)
+{
+    struct json_value *root = json_parse_file(path);
+    const struct json_value *bjobs = json_get(root, "jobs");
+    int i, regressions = 0;
+
+    if (root == NULL || bjobs == NULL || bjobs->type != JSON_ARRAY) {
+        if (root == NULL && errno != 0)
+            perror("compare_baseline:open()");
+        printf("%s is not an iombench JSON result file.\n", path);
+        exit(-57);
+    }
+    if (w != NULL) {
+        json_object_begin(w, "compare");
+        json_string(w, "baseline", path);
+        json_double(w, "threshold_percent", compare_threshold);
+        json_array_begin(w, "results");
+    }
+    for (i = 0; i < nr_jobs; i++) {
+        const struct json_value *b;
+
+        for (b = bjobs->child; b != NULL; b = b->next) {
+            const char *name = json_get_string(b, "name");
+            if (name != NULL && strcmp(name, jobs[i].name) == 0)
+                break;
+        }
+        if (b == NULL) {
+            fprintf(stderr, "compare: job %s is not in the baseline.\n",
+                    jobs[i].name);
+            continue;
+        }
+        regressions += compare_throughput(w, &jobs[i], b);
+        regressions += compare_latency(w, &jobs[i], b);
+    }
+    if (w != NULL) {
+        json_array_end(w);
+        json_int(w, "regressions", regressions);
+        json_object_end(w);
+    }
+    json_free(root);
+    return regressions;
+}
@@ -0,0 +1,39 @@
+/*
+ *   compare.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   --compare: check this run against a baseline written earlier with
+ *   --output-format json. Jobs are matched by name.
+ *
+ *   Throughput (IOPS and bandwidth) is compared on the per interval
+ *   samples of both runs with Welch's t-test. Tail latency percentiles are
+ *   compared on the histograms: each percentile gets a 95% confidence
+ *   interval from the binomial distribution of its rank, and a change is
+ *   significant when the two intervals do not overlap. A metric regresses
+ *   when it got worse by more than --compare_threshold percent and the
+ *   change is significant. A change that cannot be tested for lack of
+ *   samples is reported with significant "unknown" and result "ok".
+ */
+
+#ifndef COMPARE_H
+#define COMPARE_H
+
+struct json_writer;
+
+int compare_baseline(const char *path, struct json_writer *w);
+
+#endif /* COMPARE_H */
@@ -1,4 +1,4 @@
 #!/bin/bash
 
-gcc -o iombench iombench.c -lpthread -O3 -Wall -Wextra
+gcc -o iombench iombench.c ioengine.c engine_io_uring.c engine_libaio.c engine_mmap.c histogram.c gettime.c dist.c blocksize.c trace.c report.c precond.c jobfile.c json.c compare.c affinity.c verify.c payload.c replay.c meta.c sweep.c cpustat.c target.c -lpthread -lm -O3 -Wall -Wextra
 
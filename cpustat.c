@@ -0,0 +1,270 @@
+/*
+ *   cpustat.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   perf_event_open() and rusage counters of the IO threads.
+ */
+
+#include "iombench.h"
+#include "cpustat.h"
+#include "gettime.h"
+#include "json.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+static const char *source_names[] = { "rusage", "perf_user", "perf" };
+
+#ifdef __linux__
+
+static int perf_open(uint32_t type, uint64_t config, int exclude_kernel)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    /* this thread, on any CPU */
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1,
+                        PERF_FLAG_FD_CLOEXEC);
+}
+
+/* the count, scaled up if the PMU was shared with other events */
+static uint64_t perf_read(int fd)
+{
+    uint64_t v[3];
+
+    if (read(fd, v, sizeof(v)) != sizeof(v))
+        return 0;
+    if (v[2] > 0 && v[2] < v[1])
+        return (uint64_t)((double)v[0] * v[1] / v[2]);
+    return v[0];
+}
+
+static void rusage_read(uint64_t *user_ns, uint64_t *sys_ns, uint64_t *vcsw,
+                        uint64_t *ivcsw, uint64_t *faults)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_THREAD, &ru) != 0) {
+        *user_ns = *sys_ns = *vcsw = *ivcsw = *faults = 0;
+        return;
+    }
+    *user_ns = (uint64_t)ru.ru_utime.tv_sec * NSEC_PER_SEC +
+               (uint64_t)ru.ru_utime.tv_usec * 1000;
+    *sys_ns = (uint64_t)ru.ru_stime.tv_sec * NSEC_PER_SEC +
+              (uint64_t)ru.ru_stime.tv_usec * 1000;
+    *vcsw = (uint64_t)ru.ru_nvcsw;
+    *ivcsw = (uint64_t)ru.ru_nivcsw;
+    *faults = (uint64_t)(ru.ru_minflt + ru.ru_majflt);
+}
+
+/* Open the counters of the calling thread. Missing ones are left out. */
+void cpu_stat_open(struct cpu_stat *c)
+{
+    static const struct { uint32_t type; uint64_t config; } ev[] = {
+        [CPU_EV_CYCLES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        [CPU_EV_INSTRUCTIONS] = { PERF_TYPE_HARDWARE,
+                                  PERF_COUNT_HW_INSTRUCTIONS },
+        [CPU_EV_CS] = { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+        [CPU_EV_FAULTS] = { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    };
+    int i, exclude_kernel = 0;
+
+    for (i = 0; i < CPU_NR_EVENTS; i++) {
+        /* context switches and most faults happen in the kernel, the
+         * software events are only of use counting it, else rusage */
+        if (ev[i].type == PERF_TYPE_SOFTWARE) {
+            c->fd[i] = perf_open(ev[i].type, ev[i].config, 0);
+            continue;
+        }
+        c->fd[i] = perf_open(ev[i].type, ev[i].config, exclude_kernel);
+        /* perf_event_paranoid 2 and up: user space only */
+        if (c->fd[i] < 0 && (errno == EACCES || errno == EPERM) &&
+            !exclude_kernel) {
+            exclude_kernel = 1;
+            c->fd[i] = perf_open(ev[i].type, ev[i].config, exclude_kernel);
+        }
+    }
+    if (c->fd[CPU_EV_CYCLES] < 0)
+        c->source = CPU_SOURCE_RUSAGE;
+    else
+        c->source = exclude_kernel ? CPU_SOURCE_PERF_USER : CPU_SOURCE_PERF;
+}
+
+/* start, or restart, counting: the measured run begins */
+void cpu_stat_begin(struct cpu_stat *c)
+{
+    int i;
+
+    for (i = 0; i < CPU_NR_EVENTS; i++)
+        c->base[i] = c->fd[i] >= 0 ? perf_read(c->fd[i]) : 0;
+    rusage_read(&c->base_user_ns, &c->base_sys_ns, &c->base_vcsw,
+                &c->base_ivcsw, &c->base_faults);
+}
+
+void cpu_stat_end(struct cpu_stat *c)
+{
+    int i;
+
+    rusage_read(&c->user_ns, &c->sys_ns, &c->vcsw, &c->ivcsw, &c->faults);
+    c->user_ns -= c->base_user_ns;
+    c->sys_ns -= c->base_sys_ns;
+    c->vcsw -= c->base_vcsw;
+    c->ivcsw -= c->base_ivcsw;
+    c->faults -= c->base_faults;
+    for (i = 0; i < CPU_NR_EVENTS; i++)
+        c->count[i] = c->fd[i] >= 0 ? perf_read(c->fd[i]) - c->base[i] : 0;
+    /* the software counter sees faults rusage may not, e.g. of DAX */
+    if (c->fd[CPU_EV_FAULTS] >= 0)
+        c->faults = c->count[CPU_EV_FAULTS];
+    if (c->fd[CPU_EV_CS] < 0)
+        c->count[CPU_EV_CS] = c->vcsw + c->ivcsw;
+}
+
+void cpu_stat_close(struct cpu_stat *c)
+{
+    int i;
+
+    for (i = 0; i < CPU_NR_EVENTS; i++) {
+        if (c->fd[i] >= 0)
+            close(c->fd[i]);
+        c->fd[i] = -1;
+    }
+}
+
+#else
+
+void cpu_stat_open(struct cpu_stat *c)
+{
+    int i;
+
+    for (i = 0; i < CPU_NR_EVENTS; i++)
+        c->fd[i] = -1;
+    c->source = CPU_SOURCE_RUSAGE;
+}
+
+void cpu_stat_begin(struct cpu_stat *c)
+{
+    (void)c;
+}
+
+void cpu_stat_end(struct cpu_stat *c)
+{
+    (void)c;
+}
+
+void cpu_stat_close(struct cpu_stat *c)
+{
+    (void)c;
+}
+
+#endif /* __linux__ */
+
+struct cpu_total {
+    int source;
+    uint64_t ios;
+    uint64_t cpu_ns;
+    uint64_t user_ns;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t cs;
+    uint64_t vcsw;
+    uint64_t ivcsw;
+    uint64_t faults;
+};
+
+static void sum_threads(const struct job *job, struct cpu_total *t)
+{
+    int i;
+
+    memset(t, 0, sizeof(*t));
+    t->source = CPU_SOURCE_PERF;
+    t->ios = job->total_hist[DDIR_TOTAL].count;
+    for (i = 0; i < job->thread_count; i++) {
+        const struct cpu_stat *c = &job->threads[i].cpu_stat;
+        if (c->source < t->source)
+            t->source = c->source;
+        t->cpu_ns += c->user_ns + c->sys_ns;
+        t->user_ns += c->user_ns;
+        t->cycles += c->count[CPU_EV_CYCLES];
+        t->instructions += c->count[CPU_EV_INSTRUCTIONS];
+        t->cs += c->count[CPU_EV_CS];
+        t->vcsw += c->vcsw;
+        t->ivcsw += c->ivcsw;
+        t->faults += c->faults;
+    }
+    if (t->source == CPU_SOURCE_RUSAGE)
+        t->cycles = t->instructions = 0;
+}
+
+static double per_io(uint64_t v, uint64_t ios)
+{
+    return ios > 0 ? (double)v / ios : 0.0;
+}
+
+void print_cpu_line(const struct job *job, const char *sep)
+{
+    struct cpu_total t;
+
+    sum_threads(job, &t);
+    fprintf(GET_OUTPUT(output_file), "cpu: counters %s , cpu_time(s) %.3f , "
+            "user_percent %.1f , %scycles_per_io %.0f , "
+            "instructions_per_io %.0f , ipc %.2f , ios_per_core_sec %.0f , %s"
+            "voluntary_cs %llu , involuntary_cs %llu , page_faults %llu\n",
+            source_names[t.source], t.cpu_ns / (double)NSEC_PER_SEC,
+            t.cpu_ns > 0 ? 100.0 * t.user_ns / t.cpu_ns : 0.0, sep,
+            per_io(t.cycles, t.ios), per_io(t.instructions, t.ios),
+            t.cycles > 0 ? (double)t.instructions / t.cycles : 0.0,
+            t.cpu_ns > 0 ? t.ios / (t.cpu_ns / (double)NSEC_PER_SEC) : 0.0,
+            sep, (unsigned long long)t.vcsw, (unsigned long long)t.ivcsw,
+            (unsigned long long)t.faults);
+}
+
+void cpu_json(struct json_writer *w, const struct job *job)
+{
+    struct cpu_total t;
+
+    sum_threads(job, &t);
+    json_object_begin(w, "cpu");
+    json_string(w, "counters", source_names[t.source]);
+    json_double(w, "cpu_time_s", t.cpu_ns / (double)NSEC_PER_SEC);
+    json_double(w, "user_s", t.user_ns / (double)NSEC_PER_SEC);
+    json_uint(w, "cycles", t.cycles);
+    json_uint(w, "instructions", t.instructions);
+    json_double(w, "cycles_per_io", per_io(t.cycles, t.ios));
+    json_double(w, "instructions_per_io", per_io(t.instructions, t.ios));
+    json_double(w, "ios_per_core_sec", t.cpu_ns > 0 ?
+                t.ios / (t.cpu_ns / (double)NSEC_PER_SEC) : 0.0);
+    json_uint(w, "context_switches", t.cs);
+    json_uint(w, "voluntary_cs", t.vcsw);
+    json_uint(w, "involuntary_cs", t.ivcsw);
+    json_uint(w, "page_faults", t.faults);
+    json_object_end(w);
+}
@@ -0,0 +1,84 @@
+/*
+ *   cpustat.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   CPU cost of the IO. Each IO thread opens perf_event_open() counters on
+ *   itself for cycles, instructions, context switches and page faults, and
+ *   takes getrusage(RUSAGE_THREAD) snapshots, at the start and the end of
+ *   its measured run. The counters are only read there, the IO loop does no
+ *   extra work.
+ *
+ *   Kernel cycles are the storage stack's share and are counted when
+ *   perf_event_paranoid allows it, otherwise only user cycles ("perf_user").
+ *   Context switches and page faults mostly happen in the kernel: their
+ *   software events are only used when they can count it, else rusage.
+ *   Where perf counters are not available at all (containers, VMs without
+ *   a PMU, other systems) the report falls back to rusage ("rusage"): CPU
+ *   time, context switches and page faults, without cycles.
+ *
+ *   Reported per job on a "cpu:" line: cycles and instructions per IO, IOs
+ *   per second of CPU time (a core-second), and the voluntary (blocked,
+ *   e.g. waiting for the device) and involuntary (preempted) context
+ *   switches of the IO threads.
+ */
+
+#ifndef CPUSTAT_H
+#define CPUSTAT_H
+
+#include <stdint.h>
+
+#define CPU_EV_CYCLES 0
+#define CPU_EV_INSTRUCTIONS 1
+#define CPU_EV_CS 2
+#define CPU_EV_FAULTS 3
+#define CPU_NR_EVENTS 4
+
+/* what the counts come from, worst of the threads for a job */
+#define CPU_SOURCE_RUSAGE 0
+#define CPU_SOURCE_PERF_USER 1
+#define CPU_SOURCE_PERF 2
+
+struct job;
+struct json_writer;
+
+struct cpu_stat {
+    int fd[CPU_NR_EVENTS];      /* -1 if the event could not be opened */
+    int source;
+    uint64_t base[CPU_NR_EVENTS];
+    uint64_t count[CPU_NR_EVENTS];
+
+    /* rusage over the run */
+    uint64_t base_user_ns;
+    uint64_t base_sys_ns;
+    uint64_t base_vcsw;
+    uint64_t base_ivcsw;
+    uint64_t base_faults;
+    uint64_t user_ns;
+    uint64_t sys_ns;
+    uint64_t vcsw;
+    uint64_t ivcsw;
+    uint64_t faults;
+};
+
+void cpu_stat_open(struct cpu_stat *c);
+void cpu_stat_begin(struct cpu_stat *c);
+void cpu_stat_end(struct cpu_stat *c);
+void cpu_stat_close(struct cpu_stat *c);
+void print_cpu_line(const struct job *job, const char *sep);
+void cpu_json(struct json_writer *w, const struct job *job);
+
+#endif /* CPUSTAT_H */
@@ -0,0 +1,259 @@
+/*
+ *   dist.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Offset distributions. Specs accepted by dist_parse():
+ *
+ *     random          uniform (default)
+ *     zipf:<theta>    zipf with exponent theta, theta > 0 and != 1
+ *     pareto:<h>      pareto, 0 < h < 1, e.g. 0.9
+ *     normal:<dev>    gaussian around the middle of the span, standard
+ *                     deviation <dev> percent of the span
+ *     hotset:<x>/<y>  <x> percent of the IOs go to the first <y> percent
+ *                     of the span, the rest uniformly to the remainder
+ *
+ *   Zipf and pareto draw ranks that concentrate on a few values. Ranks are
+ *   scattered over the span with a multiplicative bijection so that the hot
+ *   blocks are not all adjacent.
+ */
+
+#include "dist.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* sum the first ZETA_EXACT terms exactly, approximate the rest */
+#define ZETA_EXACT 1000000ULL
+
+int dist_parse(struct offset_dist *d, const char *spec)
+{
+    char *end;
+
+    memset(d, 0, sizeof(struct offset_dist));
+    strncpy(d->spec, spec, MAX_DIST_SPEC_LENGTH - 1);
+
+    if (strcmp(spec, "random") == 0) {
+        d->type = DIST_UNIFORM;
+        return 0;
+    }
+    if (strncmp(spec, "zipf:", 5) == 0) {
+        d->type = DIST_ZIPF;
+        d->param = strtod(spec + 5, &end);
+        if (*end != '\0' || d->param <= 0.0 || d->param == 1.0)
+            return -1;
+        return 0;
+    }
+    if (strncmp(spec, "pareto:", 7) == 0) {
+        d->type = DIST_PARETO;
+        d->param = strtod(spec + 7, &end);
+        if (*end != '\0' || d->param <= 0.0 || d->param >= 1.0)
+            return -1;
+        return 0;
+    }
+    if (strncmp(spec, "normal:", 7) == 0) {
+        d->type = DIST_NORMAL;
+        d->param = strtod(spec + 7, &end);
+        if (*end != '\0' || d->param <= 0.0 || d->param > 100.0)
+            return -1;
+        return 0;
+    }
+    if (strncmp(spec, "hotset:", 7) == 0) {
+        d->type = DIST_HOTSET;
+        d->param = strtod(spec + 7, &end);
+        if (*end != '/')
+            return -1;
+        d->param2 = strtod(end + 1, &end);
+        if (*end != '\0' || d->param < 0.0 || d->param > 100.0 ||
+            d->param2 <= 0.0 || d->param2 >= 100.0)
+            return -1;
+        return 0;
+    }
+    return -1;
+}
+
+/* generalized harmonic number H(n, theta) */
+static double zeta(uint64_t n, double theta)
+{
+    uint64_t i, exact = n < ZETA_EXACT ? n : ZETA_EXACT;
+    double sum = 0.0;
+
+    for (i = 1; i <= exact; i++)
+        sum += pow((double)i, -theta);
+
+    /* midpoint rule for the smooth tail, exact enough for multi-TB spans
+     * where summing every term would take seconds */
+    if (n > exact)
+        sum += (pow(n + 0.5, 1.0 - theta) - pow(exact + 0.5, 1.0 - theta)) /
+               (1.0 - theta);
+    return sum;
+}
+
+static uint64_t gcd64(uint64_t a, uint64_t b)
+{
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static inline uint64_t scatter(const struct offset_dist *d, uint64_t rank)
+{
+    return (uint64_t)(((unsigned __int128)rank * d->scatter_mult) %
+                      d->nblocks);
+}
+
+int dist_init(struct offset_dist *d, uint64_t nblocks)
+{
+    if (nblocks == 0)
+        return -1;
+    d->nblocks = nblocks;
+
+    /* any multiplier coprime to nblocks permutes [0, nblocks) */
+    d->scatter_mult = 0x9e3779b97f4a7c15ULL % nblocks;
+    if (d->scatter_mult == 0)
+        d->scatter_mult = 1;
+    while (gcd64(d->scatter_mult, nblocks) != 1)
+        d->scatter_mult++;
+
+    switch (d->type) {
+    case DIST_ZIPF:
+        d->zetan = zeta(nblocks, d->param);
+        d->zeta2 = zeta(2, d->param);
+        d->alpha = 1.0 / (1.0 - d->param);
+        d->eta = (1.0 - pow(2.0 / nblocks, 1.0 - d->param)) /
+                 (1.0 - d->zeta2 / d->zetan);
+        break;
+    case DIST_PARETO:
+        d->pareto_pow = log(d->param) / log(1.0 - d->param);
+        break;
+    case DIST_NORMAL:
+        d->center = nblocks / 2.0;
+        d->stddev = nblocks * d->param / 100.0;
+        break;
+    case DIST_HOTSET:
+        d->hot_fraction = d->param / 100.0;
+        d->hot_blocks = (uint64_t)(nblocks * d->param2 / 100.0);
+        if (d->hot_blocks == 0)
+            d->hot_blocks = 1;
+        if (d->hot_blocks >= nblocks)
+            return -1;
+        break;
+    }
+    return 0;
+}
+
+/* block index in [0, nblocks) */
+uint64_t dist_next(const struct offset_dist *d, struct rand_state *st)
+{
+    uint64_t rank;
+    double u;
+
+    switch (d->type) {
+    case DIST_ZIPF:
+        u = rand_double(st);
+        if (u * d->zetan < 1.0)
+            rank = 0;
+        else if (u * d->zetan < 1.0 + pow(0.5, d->param))
+            rank = 1;
+        else
+            rank = (uint64_t)(d->nblocks *
+                              pow(d->eta * u - d->eta + 1.0, d->alpha));
+        if (rank >= d->nblocks)
+            rank = d->nblocks - 1;
+        return scatter(d, rank);
+
+    case DIST_PARETO:
+        rank = (uint64_t)((d->nblocks - 1) *
+                          pow(rand_double(st), d->pareto_pow));
+        return scatter(d, rank);
+
+    case DIST_NORMAL:
+        /* Box-Muller, resample the rare draws outside the span */
+        for (;;) {
+            double u1 = 1.0 - rand_double(st);
+            double u2 = rand_double(st);
+            double z = sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+            double x = d->center + z * d->stddev;
+            if (x >= 0.0 && x < (double)d->nblocks)
+                return (uint64_t)x;
+        }
+
+    case DIST_HOTSET:
+        if (rand_double(st) < d->hot_fraction)
+            return rand_below(st, d->hot_blocks);
+        return d->hot_blocks + rand_below(st, d->nblocks - d->hot_blocks);
+
+    default:
+        return rand_below(st, d->nblocks);
+    }
+}
+
+void perm_init(struct block_perm *p, uint64_t nblocks)
+{
+    int bits = 1;
+
+    while (bits < 64 && (1ULL << bits) < nblocks)
+        bits++;
+    p->nblocks = nblocks;
+    p->half_bits = (bits + 1) / 2;
+    p->half_mask = (1ULL << p->half_bits) - 1;
+}
+
+/* round keys for one pass, every pass gets a different order */
+void perm_keys(uint64_t keys[PERM_ROUNDS], uint64_t seed, uint64_t pass)
+{
+    uint64_t x = seed ^ (pass * 0xa0761d6478bd642fULL);
+    int i;
+    for (i = 0; i < PERM_ROUNDS; i++)
+        keys[i] = splitmix64(&x);
+}
+
+static inline uint64_t feistel(const struct block_perm *p,
+                               const uint64_t *keys, uint64_t x)
+{
+    uint64_t left = x >> p->half_bits;
+    uint64_t right = x & p->half_mask;
+    int i;
+
+    for (i = 0; i < PERM_ROUNDS; i++) {
+        uint64_t f = right ^ keys[i];
+        uint64_t tmp;
+        f = splitmix64(&f) & p->half_mask;
+        tmp = right;
+        right = left ^ f;
+        left = tmp;
+    }
+    return (left << p->half_bits) | right;
+}
+
+/*
+ * Position i of the pass maps to a distinct block. The Feistel domain is
+ * the next power of 4 above nblocks; values outside [0, nblocks) are fed
+ * through again (cycle walking), which on average takes < 4 rounds.
+ */
+uint64_t perm_index(const struct block_perm *p, const uint64_t *keys,
+                    uint64_t i)
+{
+    uint64_t x = feistel(p, keys, i);
+    while (x >= p->nblocks)
+        x = feistel(p, keys, x);
+    return x;
+}
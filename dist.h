@@ -0,0 +1,93 @@
+/*
+ *   dist.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Non-uniform offset distributions for random IO (-r). Everything that
+ *   depends on the size of the address space is computed once in
+ *   dist_init(), so drawing an offset is O(1) per request. A distribution
+ *   is read-only after init and shared by all threads; each thread passes
+ *   its own random state.
+ */
+
+#ifndef DIST_H
+#define DIST_H
+
+#include <stdint.h>
+
+#include "rand.h"
+
+#define DIST_UNIFORM 0
+#define DIST_ZIPF 1
+#define DIST_PARETO 2
+#define DIST_NORMAL 3
+#define DIST_HOTSET 4
+
+#define MAX_DIST_SPEC_LENGTH 64
+
+struct offset_dist {
+    int type;
+    char spec[MAX_DIST_SPEC_LENGTH];
+    double param;           /* zipf theta, pareto h, normal stddev percent,
+                               hotset percent of IOs */
+    double param2;          /* hotset percent of the span */
+    uint64_t nblocks;
+
+    /* zipf, Gray et al. "Quickly generating billion-record synthetic
+     * databases" */
+    double zetan;
+    double zeta2;
+    double alpha;
+    double eta;
+
+    /* pareto */
+    double pareto_pow;
+
+    /* normal */
+    double center;
+    double stddev;
+
+    /* hotset */
+    uint64_t hot_blocks;
+    double hot_fraction;
+
+    /* rank -> block scatter, (rank * mult) mod nblocks, a bijection */
+    uint64_t scatter_mult;
+};
+
+/*
+ * Random order without replacement: a keyed Feistel network over the block
+ * index, so a pass visits every block of [0, nblocks) exactly once without
+ * materializing the order. Memory use is constant regardless of span.
+ */
+#define PERM_ROUNDS 4
+
+struct block_perm {
+    uint64_t nblocks;
+    int half_bits;
+    uint64_t half_mask;
+};
+
+int dist_parse(struct offset_dist *d, const char *spec);
+int dist_init(struct offset_dist *d, uint64_t nblocks);
+uint64_t dist_next(const struct offset_dist *d, struct rand_state *st);
+
+void perm_init(struct block_perm *p, uint64_t nblocks);
+void perm_keys(uint64_t keys[PERM_ROUNDS], uint64_t seed, uint64_t pass);
+uint64_t perm_index(const struct block_perm *p, const uint64_t *keys,
+                    uint64_t i);
+
+#endif /* DIST_H */
@@ -0,0 +1,331 @@
+/*
+ *   engine_io_uring.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   io_uring engine. Talks to the kernel through the raw syscalls and the
+ *   uapi header so that no liburing is needed to build iombench.
+ *
+ *   Options: -q (iodepth), --iodepth_batch, --iodepth_batch_complete,
+ *   --fixedbufs (IORING_REGISTER_BUFFERS + READ/WRITE_FIXED),
+ *   --registerfiles (IORING_REGISTER_FILES + IOSQE_FIXED_FILE) and
+ *   --sqpoll (IORING_SETUP_SQPOLL, kernel thread polls the SQ ring).
+ */
+
+#include "iombench.h"
+#include "ioengine.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+struct uring_data {
+    int ring_fd;
+    unsigned int flags;
+
+    /* submission queue */
+    void *sq_ptr;
+    size_t sq_ring_size;
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_mask;
+    unsigned int *sq_flags;
+    unsigned int *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned int sq_local_tail;
+
+    /* completion queue */
+    void *cq_ptr;
+    size_t cq_ring_size;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_mask;
+    struct io_uring_cqe *cqes;
+};
+
+static int sys_io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned int to_submit,
+                              unsigned int min_complete, unsigned int flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned int opcode, void *arg,
+                                 unsigned int nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static int uring_map_rings(struct uring_data *ud, struct io_uring_params *p)
+{
+    ud->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+    ud->sq_ptr = mmap(NULL, ud->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ud->ring_fd,
+                      IORING_OFF_SQ_RING);
+    if (ud->sq_ptr == MAP_FAILED)
+        return -errno;
+
+    ud->sq_head = (unsigned int *)((char *)ud->sq_ptr + p->sq_off.head);
+    ud->sq_tail = (unsigned int *)((char *)ud->sq_ptr + p->sq_off.tail);
+    ud->sq_mask = (unsigned int *)((char *)ud->sq_ptr + p->sq_off.ring_mask);
+    ud->sq_flags = (unsigned int *)((char *)ud->sq_ptr + p->sq_off.flags);
+    ud->sq_array = (unsigned int *)((char *)ud->sq_ptr + p->sq_off.array);
+    ud->sq_local_tail = *ud->sq_tail;
+
+    ud->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    ud->sqes = mmap(NULL, ud->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ud->ring_fd, IORING_OFF_SQES);
+    if (ud->sqes == MAP_FAILED)
+        return -errno;
+
+    ud->cq_ring_size = p->cq_off.cqes +
+                       p->cq_entries * sizeof(struct io_uring_cqe);
+    ud->cq_ptr = mmap(NULL, ud->cq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ud->ring_fd,
+                      IORING_OFF_CQ_RING);
+    if (ud->cq_ptr == MAP_FAILED)
+        return -errno;
+
+    ud->cq_head = (unsigned int *)((char *)ud->cq_ptr + p->cq_off.head);
+    ud->cq_tail = (unsigned int *)((char *)ud->cq_ptr + p->cq_off.tail);
+    ud->cq_mask = (unsigned int *)((char *)ud->cq_ptr + p->cq_off.ring_mask);
+    ud->cqes = (struct io_uring_cqe *)((char *)ud->cq_ptr + p->cq_off.cqes);
+    return 0;
+}
+
+static void uring_cleanup(struct thread_data *td)
+{
+    struct uring_data *ud = td->engine_data;
+    if (ud == NULL)
+        return;
+
+    if (ud->sqes != NULL && ud->sqes != MAP_FAILED)
+        munmap(ud->sqes, ud->sqes_size);
+    if (ud->sq_ptr != NULL && ud->sq_ptr != MAP_FAILED)
+        munmap(ud->sq_ptr, ud->sq_ring_size);
+    if (ud->cq_ptr != NULL && ud->cq_ptr != MAP_FAILED)
+        munmap(ud->cq_ptr, ud->cq_ring_size);
+    if (ud->ring_fd >= 0)
+        close(ud->ring_fd);
+    free(ud);
+    td->engine_data = NULL;
+}
+
+static int uring_register(struct thread_data *td, struct uring_data *ud)
+{
+    int i;
+
+    if (fixed_bufs > 0) {
+        /* the request buffers, then the write data pool if any */
+        struct iovec *iov = calloc(2 * td->job->iodepth + 1,
+                                   sizeof(struct iovec));
+        int nr = td->job->iodepth;
+        if (iov == NULL)
+            return -ENOMEM;
+        for (i = 0; i < td->job->iodepth; i++) {
+            iov[i].iov_base = td->io_us[i].buf;
+            iov[i].iov_len = td->io_us[i].size;
+        }
+        nr += payload_iovecs(td, iov + nr);
+        int ret = sys_io_uring_register(ud->ring_fd, IORING_REGISTER_BUFFERS,
+                                        iov, nr);
+        free(iov);
+        if (ret < 0) {
+            perror("io_uring:register buffers");
+            return -errno;
+        }
+    }
+
+    if (register_files > 0) {
+        if (sys_io_uring_register(ud->ring_fd, IORING_REGISTER_FILES,
+                                  td->fds, td->nr_fds) < 0) {
+            perror("io_uring:register files");
+            return -errno;
+        }
+    }
+    return 0;
+}
+
+static int uring_init(struct thread_data *td)
+{
+    struct io_uring_params p;
+    struct uring_data *ud = calloc(1, sizeof(struct uring_data));
+    if (ud == NULL)
+        return -ENOMEM;
+    ud->ring_fd = -1;
+    td->engine_data = ud;
+
+    memset(&p, 0, sizeof(p));
+    if (sqpoll > 0) {
+        p.flags |= IORING_SETUP_SQPOLL;
+        p.sq_thread_idle = sqpoll_idle;
+    }
+
+    ud->ring_fd = sys_io_uring_setup(td->job->iodepth, &p);
+    if (ud->ring_fd < 0) {
+        int err = errno;
+        perror("io_uring:io_uring_setup");
+        if (err == EPERM && sqpoll > 0)
+            fprintf(stderr, "SQPOLL may need root on this kernel.\n");
+        return -err;
+    }
+    ud->flags = p.flags;
+
+    int ret = uring_map_rings(ud, &p);
+    if (ret < 0) {
+        perror("io_uring:mmap");
+        return ret;
+    }
+    return uring_register(td, ud);
+}
+
+static int uring_queue(struct thread_data *td, struct io_u *io_u)
+{
+    struct uring_data *ud = td->engine_data;
+    unsigned int head = __atomic_load_n(ud->sq_head, __ATOMIC_ACQUIRE);
+    unsigned int index;
+    struct io_uring_sqe *sqe;
+
+    /* the ring has iodepth entries and we never have more io_us than that */
+    if (ud->sq_local_tail - head > *ud->sq_mask)
+        return -EBUSY;
+
+    index = ud->sq_local_tail & *ud->sq_mask;
+    sqe = &ud->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+
+    if (fixed_bufs > 0) {
+        sqe->opcode = io_u->is_write > 0 ? IORING_OP_WRITE_FIXED
+                                         : IORING_OP_READ_FIXED;
+        sqe->buf_index = io_u->buf_index;
+    } else {
+        sqe->opcode = io_u->is_write > 0 ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    if (register_files > 0) {
+        sqe->fd = io_u->file;
+        sqe->flags |= IOSQE_FIXED_FILE;
+    } else {
+        sqe->fd = td->fds[io_u->file];
+    }
+    sqe->addr = (unsigned long)io_u->buf;
+    sqe->len = io_u->size;
+    sqe->off = io_u->offset;
+    sqe->user_data = (unsigned long)io_u;
+
+    ud->sq_array[index] = index;
+    ud->sq_local_tail++;
+    return IO_Q_QUEUED;
+}
+
+static int uring_commit(struct thread_data *td)
+{
+    struct uring_data *ud = td->engine_data;
+    unsigned int to_submit;
+
+    /* publish the new tail, the kernel (or the SQ thread) reads it */
+    __atomic_store_n(ud->sq_tail, ud->sq_local_tail, __ATOMIC_RELEASE);
+
+    if (ud->flags & IORING_SETUP_SQPOLL) {
+        if (__atomic_load_n(ud->sq_flags, __ATOMIC_ACQUIRE) &
+            IORING_SQ_NEED_WAKEUP) {
+            if (sys_io_uring_enter(ud->ring_fd, 0, 0,
+                                   IORING_ENTER_SQ_WAKEUP) < 0)
+                return -errno;
+        }
+        return 0;
+    }
+
+    to_submit = ud->sq_local_tail - *ud->sq_head;
+    while (to_submit > 0) {
+        int ret = sys_io_uring_enter(ud->ring_fd, to_submit, 0, 0);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            /* out of completion space, reap first and resubmit later */
+            if (errno == EAGAIN || errno == EBUSY)
+                return 0;
+            return -errno;
+        }
+        to_submit -= ret;
+    }
+    return 0;
+}
+
+static int uring_reap(struct thread_data *td, int n, int max)
+{
+    struct uring_data *ud = td->engine_data;
+    unsigned int head = *ud->cq_head;
+    unsigned int tail = __atomic_load_n(ud->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail && n < max) {
+        struct io_uring_cqe *cqe = &ud->cqes[head & *ud->cq_mask];
+        struct io_u *io_u = (struct io_u *)(uintptr_t)cqe->user_data;
+        io_u->result = cqe->res;
+        td->events[n++] = io_u;
+        head++;
+    }
+    __atomic_store_n(ud->cq_head, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+static int uring_getevents(struct thread_data *td, int min, int max)
+{
+    struct uring_data *ud = td->engine_data;
+    int n = 0;
+
+    for (;;) {
+        n = uring_reap(td, n, max);
+        if (n >= min)
+            break;
+
+        /* also push anything a previous commit could not submit */
+        unsigned int to_submit = 0;
+        unsigned int flags = IORING_ENTER_GETEVENTS;
+        if (!(ud->flags & IORING_SETUP_SQPOLL))
+            to_submit = ud->sq_local_tail - *ud->sq_head;
+        if (sys_io_uring_enter(ud->ring_fd, to_submit, min - n, flags) < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                continue;
+            return -errno;
+        }
+    }
+    return n;
+}
+
+const struct ioengine_ops ioengine_io_uring = {
+    .name = "io_uring",
+    .init = uring_init,
+    .queue = uring_queue,
+    .commit = uring_commit,
+    .getevents = uring_getevents,
+    .cleanup = uring_cleanup,
+};
+
+#endif /* __linux__ */
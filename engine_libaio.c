@@ -0,0 +1,206 @@
+/*
+ *   engine_libaio.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Linux native AIO engine (io_submit/io_getevents). Like the io_uring
+ *   engine it uses the raw syscalls and the uapi header instead of libaio,
+ *   so it builds on hosts without libaio-dev. Native AIO is only truly
+ *   asynchronous with O_DIRECT: with --direct 0 io_submit() does buffered
+ *   IO before it returns, one request at a time, whatever -q is.
+ */
+
+#include "iombench.h"
+#include "ioengine.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/aio_abi.h>
+
+/* io_submit() taking nothing with nothing in flight: retry this many times,
+ * SUBMIT_BACKOFF_US apart, e.g. while fs.aio-max-nr is exhausted */
+#define SUBMIT_RETRIES 1000
+#define SUBMIT_BACKOFF_US 1000
+
+struct libaio_data {
+    aio_context_t ctx;
+    struct iocb *iocbs;         /* one per io_u, indexed by io_u->index */
+    struct iocb **pending;      /* queued but not yet accepted by io_submit */
+    int nr_pending;
+    int nr_submitted;           /* accepted by the kernel, not yet reaped */
+    struct io_event *io_events;
+};
+
+static int sys_io_setup(unsigned int nr_events, aio_context_t *ctx)
+{
+    return (int)syscall(__NR_io_setup, nr_events, ctx);
+}
+
+static int sys_io_destroy(aio_context_t ctx)
+{
+    return (int)syscall(__NR_io_destroy, ctx);
+}
+
+static int sys_io_submit(aio_context_t ctx, long nr, struct iocb **iocbs)
+{
+    return (int)syscall(__NR_io_submit, ctx, nr, iocbs);
+}
+
+static int sys_io_getevents(aio_context_t ctx, long min_nr, long nr,
+                            struct io_event *events)
+{
+    return (int)syscall(__NR_io_getevents, ctx, min_nr, nr, events, NULL);
+}
+
+static void libaio_cleanup(struct thread_data *td)
+{
+    struct libaio_data *ld = td->engine_data;
+    if (ld == NULL)
+        return;
+
+    if (ld->ctx != 0)
+        sys_io_destroy(ld->ctx);
+    free(ld->iocbs);
+    free(ld->pending);
+    free(ld->io_events);
+    free(ld);
+    td->engine_data = NULL;
+}
+
+static int libaio_init(struct thread_data *td)
+{
+    struct libaio_data *ld = calloc(1, sizeof(struct libaio_data));
+    if (ld == NULL)
+        return -ENOMEM;
+    td->engine_data = ld;
+
+    ld->iocbs = calloc(td->job->iodepth, sizeof(struct iocb));
+    ld->pending = calloc(td->job->iodepth, sizeof(struct iocb *));
+    ld->io_events = calloc(td->job->iodepth, sizeof(struct io_event));
+    if (ld->iocbs == NULL || ld->pending == NULL || ld->io_events == NULL)
+        return -ENOMEM;
+
+    if (sys_io_setup(td->job->iodepth, &ld->ctx) < 0) {
+        int err = errno;
+        perror("libaio:io_setup");
+        if (err == EAGAIN)
+            fprintf(stderr, "queue depth exceeds /proc/sys/fs/aio-max-nr.\n");
+        ld->ctx = 0;
+        return -err;
+    }
+    return 0;
+}
+
+static int libaio_queue(struct thread_data *td, struct io_u *io_u)
+{
+    struct libaio_data *ld = td->engine_data;
+    struct iocb *iocb = &ld->iocbs[io_u->index];
+
+    memset(iocb, 0, sizeof(*iocb));
+    iocb->aio_lio_opcode = io_u->is_write > 0 ? IOCB_CMD_PWRITE
+                                              : IOCB_CMD_PREAD;
+    iocb->aio_fildes = td->fds[io_u->file];
+    iocb->aio_buf = (uint64_t)(uintptr_t)io_u->buf;
+    iocb->aio_nbytes = io_u->size;
+    iocb->aio_offset = io_u->offset;
+    iocb->aio_data = (uint64_t)(uintptr_t)io_u;
+
+    ld->pending[ld->nr_pending++] = iocb;
+    return IO_Q_QUEUED;
+}
+
+static int libaio_commit(struct thread_data *td)
+{
+    struct libaio_data *ld = td->engine_data;
+
+    while (ld->nr_pending > 0) {
+        int ret = sys_io_submit(ld->ctx, ld->nr_pending, ld->pending);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            /* kernel queue full, retried from getevents after reaping */
+            if (errno == EAGAIN)
+                return 0;
+            return -errno;
+        }
+        if (ret == 0)
+            return 0;
+        ld->nr_submitted += ret;
+        ld->nr_pending -= ret;
+        memmove(ld->pending, ld->pending + ret,
+                ld->nr_pending * sizeof(struct iocb *));
+    }
+    return 0;
+}
+
+static int libaio_getevents(struct thread_data *td, int min, int max)
+{
+    struct libaio_data *ld = td->engine_data;
+    int i, ret, retries = 0;
+
+    for (;;) {
+        if (ld->nr_pending > 0) {
+            ret = libaio_commit(td);
+            if (ret < 0)
+                return ret;
+        }
+        /* never wait for more than the kernel actually has */
+        if (ld->nr_submitted == 0) {
+            if (min == 0)
+                return 0;
+            /* nothing to reap: back off, give up if it stays that way */
+            if (ld->nr_pending == 0 || ++retries > SUBMIT_RETRIES)
+                return -EAGAIN;
+            usleep(SUBMIT_BACKOFF_US);
+            continue;
+        }
+        int wait = min < ld->nr_submitted ? min : ld->nr_submitted;
+
+        ret = sys_io_getevents(ld->ctx, wait, max, ld->io_events);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        if (ret > 0 || min == 0)
+            break;
+    }
+
+    for (i = 0; i < ret; i++) {
+        struct io_u *io_u = (struct io_u *)(uintptr_t)ld->io_events[i].data;
+        io_u->result = (ssize_t)ld->io_events[i].res;
+        td->events[i] = io_u;
+    }
+    ld->nr_submitted -= ret;
+    return ret;
+}
+
+const struct ioengine_ops ioengine_libaio = {
+    .name = "libaio",
+    .init = libaio_init,
+    .queue = libaio_queue,
+    .commit = libaio_commit,
+    .getevents = libaio_getevents,
+    .cleanup = libaio_cleanup,
+};
+
+#endif /* __linux__ */
@@ -0,0 +1,280 @@
+/*
+ *   engine_mmap.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Memory mapped engine: each thread maps [start_addr, seek_span) of the
+ *   target and copies between the mapping and its buffers, which measures
+ *   the load/store path of the page cache or of a DAX (pmem) file system
+ *   instead of read()/write(). Copies use non-temporal SSE stores (and
+ *   streaming loads where the CPU has SSE4.1) so they do not pollute the
+ *   cache, like a pmem aware application would.
+ *
+ *   --mmap_sync selects when a write is durable:
+ *     msync     msync(MS_SYNC) of the written pages after every write, the
+ *               counterpart of O_SYNC for the other engines. Default.
+ *     map_sync  MAP_SHARED_VALIDATE | MAP_SYNC: the file system keeps its
+ *               metadata synchronous and the stores followed by a fence
+ *               are durable. DAX file systems only.
+ *     none      no flush, the page cache absorbs the writes.
+ *
+ *   Minor and major page faults of each thread are counted over the run.
+ *   The target is opened without O_DIRECT and O_SYNC, which do not apply
+ *   to a mapping and which tmpfs may refuse.
+ */
+
+#include "iombench.h"
+#include "ioengine.h"
+#include "json.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#ifndef MAP_SHARED_VALIDATE
+#define MAP_SHARED_VALIDATE 0x03
+#endif
+#ifndef MAP_SYNC
+#define MAP_SYNC 0x80000
+#endif
+
+struct mmap_data {
+    char *map;
+    size_t map_len;
+    off_t map_start;            /* file offset of map, page aligned */
+    uintptr_t page;
+    struct rusage start;
+};
+
+#if defined(__x86_64__)
+static int have_stream_load;
+
+/* 64 bytes per iteration, non-temporal stores to 16 byte aligned dst */
+static void copy_nt_store(char *dst, const char *src, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i + 64 <= len; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(src + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *)(src + i + 48));
+        _mm_stream_si128((__m128i *)(dst + i), a);
+        _mm_stream_si128((__m128i *)(dst + i + 16), b);
+        _mm_stream_si128((__m128i *)(dst + i + 32), c);
+        _mm_stream_si128((__m128i *)(dst + i + 48), d);
+    }
+    memcpy(dst + i, src + i, len - i);
+    _mm_sfence();
+}
+
+/* streaming loads from 16 byte aligned src */
+__attribute__((target("sse4.1")))
+static void copy_nt_load(char *dst, const char *src, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i + 64 <= len; i += 64) {
+        __m128i a = _mm_stream_load_si128((__m128i *)(src + i));
+        __m128i b = _mm_stream_load_si128((__m128i *)(src + i + 16));
+        __m128i c = _mm_stream_load_si128((__m128i *)(src + i + 32));
+        __m128i d = _mm_stream_load_si128((__m128i *)(src + i + 48));
+        _mm_storeu_si128((__m128i *)(dst + i), a);
+        _mm_storeu_si128((__m128i *)(dst + i + 16), b);
+        _mm_storeu_si128((__m128i *)(dst + i + 32), c);
+        _mm_storeu_si128((__m128i *)(dst + i + 48), d);
+    }
+    memcpy(dst + i, src + i, len - i);
+}
+#endif
+
+static void copy_to_map(char *dst, const char *src, size_t len)
+{
+#if defined(__x86_64__)
+    if (((uintptr_t)dst & 15) == 0) {
+        copy_nt_store(dst, src, len);
+        return;
+    }
+#endif
+    memcpy(dst, src, len);
+    __sync_synchronize();
+}
+
+static void copy_from_map(char *dst, const char *src, size_t len)
+{
+#if defined(__x86_64__)
+    if (have_stream_load && ((uintptr_t)src & 15) == 0) {
+        copy_nt_load(dst, src, len);
+        return;
+    }
+#endif
+    memcpy(dst, src, len);
+}
+
+static void mmap_cleanup(struct thread_data *td)
+{
+    struct mmap_data *md = td->engine_data;
+    struct rusage end;
+
+    if (md == NULL)
+        return;
+    if (getrusage(RUSAGE_THREAD, &end) == 0) {
+        td->minor_faults = end.ru_minflt - md->start.ru_minflt;
+        td->major_faults = end.ru_majflt - md->start.ru_majflt;
+    }
+    if (md->map != NULL && md->map != MAP_FAILED)
+        munmap(md->map, md->map_len);
+    free(md);
+    td->engine_data = NULL;
+}
+
+static int mmap_init(struct thread_data *td)
+{
+    const struct job *job = td->job;
+    struct mmap_data *md = calloc(1, sizeof(struct mmap_data));
+    int flags = MAP_SHARED;
+    struct stat st;
+    off_t end;
+
+    if (md == NULL)
+        return -ENOMEM;
+    td->engine_data = md;
+    md->page = (uintptr_t)sysconf(_SC_PAGESIZE);
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    have_stream_load = __builtin_cpu_supports("sse4.1");
+#endif
+
+    /* a regular file is grown to the range, a device must cover it */
+    if (fstat(td->fd, &st) != 0)
+        return -errno;
+    end = S_ISREG(st.st_mode) ? st.st_size : lseek(td->fd, 0, SEEK_END);
+    if (end < job->seek_span) {
+        if (!S_ISREG(st.st_mode)) {
+            fprintf(stderr, "mmap: %s has %lld bytes, less than -S\n",
+                    job->filename, (long long)end);
+            return -EINVAL;
+        }
+        if (ftruncate(td->fd, job->seek_span) != 0)
+            return -errno;
+    }
+
+    if (job->mmap_sync == MMAP_SYNC_MAP_SYNC)
+        flags = MAP_SHARED_VALIDATE | MAP_SYNC;
+    md->map_start = job->start_addr / (off_t)md->page * (off_t)md->page;
+    md->map_len = (size_t)(job->seek_span - md->map_start);
+    md->map = mmap(NULL, md->map_len, PROT_READ | PROT_WRITE, flags, td->fd,
+                   md->map_start);
+    if (md->map == MAP_FAILED) {
+        int err = errno;
+        if (job->mmap_sync == MMAP_SYNC_MAP_SYNC && err == EOPNOTSUPP)
+            fprintf(stderr, "mmap: MAP_SYNC needs a DAX file system\n");
+        return -err;
+    }
+    if (getrusage(RUSAGE_THREAD, &md->start) != 0)
+        return -errno;
+    return 0;
+}
+
+static int mmap_queue(struct thread_data *td, struct io_u *io_u)
+{
+    struct mmap_data *md = td->engine_data;
+    char *addr;
+
+    /* the mapping only covers [-s, -S) */
+    if (io_u->offset < md->map_start ||
+        io_u->offset + io_u->size > md->map_start + (off_t)md->map_len) {
+        io_u->result = -EINVAL;
+        return IO_Q_COMPLETED;
+    }
+    addr = md->map + (io_u->offset - md->map_start);
+    if (io_u->is_write > 0) {
+        copy_to_map(addr, io_u->buf, io_u->size);
+        if (td->job->mmap_sync == MMAP_SYNC_MSYNC) {
+            uintptr_t begin = (uintptr_t)addr / md->page * md->page;
+            if (msync((void *)begin, (uintptr_t)addr + io_u->size - begin,
+                      MS_SYNC) != 0) {
+                io_u->result = -errno;
+                return IO_Q_COMPLETED;
+            }
+        }
+    } else {
+        copy_from_map(io_u->buf, addr, io_u->size);
+    }
+    io_u->result = io_u->size;
+    return IO_Q_COMPLETED;
+}
+
+const struct ioengine_ops ioengine_mmap = {
+    .name = "mmap",
+    .sync = 1,
+    .mapped = 1,
+    .init = mmap_init,
+    .queue = mmap_queue,
+    .cleanup = mmap_cleanup,
+};
+
+#endif /* __linux__ */
+
+static void sum_faults(const struct job *job, uint64_t *minor,
+                       uint64_t *major, uint64_t *ios)
+{
+    int i;
+
+    *minor = *major = 0;
+    *ios = job->total_hist[DDIR_TOTAL].count;
+    for (i = 0; i < job->thread_count; i++) {
+        *minor += job->threads[i].minor_faults;
+        *major += job->threads[i].major_faults;
+    }
+}
+
+void print_mmap_line(const struct job *job, const char *sep)
+{
+    uint64_t minor, major, ios;
+
+    sum_faults(job, &minor, &major, &ios);
+    fprintf(GET_OUTPUT(output_file), "mmap: sync %s , minor_faults %llu , "
+            "major_faults %llu , %sfaults_per_io %.3f\n",
+            mmap_sync_names[job->mmap_sync], (unsigned long long)minor,
+            (unsigned long long)major, sep,
+            ios > 0 ? (double)(minor + major) / ios : 0.0);
+}
+
+void mmap_json(struct json_writer *w, const struct job *job)
+{
+    uint64_t minor, major, ios;
+
+    sum_faults(job, &minor, &major, &ios);
+    json_object_begin(w, "mmap");
+    json_string(w, "sync", mmap_sync_names[job->mmap_sync]);
+    json_uint(w, "minor_faults", minor);
+    json_uint(w, "major_faults", major);
+    json_double(w, "faults_per_io",
+                ios > 0 ? (double)(minor + major) / ios : 0.0);
+    json_object_end(w);
+}
@@ -0,0 +1,167 @@
+/*
+ *   gettime.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Clock source selection, TSC calibration and clock cost measurement.
+ */
+
+#include "iombench.h"
+#include "gettime.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define CALIBRATE_NS (50 * 1000 * 1000ULL)
+#define SPIN_NS (100 * 1000ULL)
+#define CLOCK_COST_LOOPS 100000
+
+int clocksource = CS_CLOCK_GETTIME;
+
+#ifdef ARCH_HAVE_TSC
+uint64_t tsc_base;
+uint64_t tsc_base_ns;
+uint64_t tsc_mult;
+#endif
+
+/* offset from the monotonic clock to the epoch, for the -P records */
+static int64_t epoch_offset_ns;
+static uint64_t clock_cost_ns;
+
+int parse_clocksource(const char *name)
+{
+    if (strcmp(name, "clock_gettime") == 0) {
+        clocksource = CS_CLOCK_GETTIME;
+        return 0;
+    }
+#ifdef ARCH_HAVE_TSC
+    if (strcmp(name, "tsc") == 0) {
+        clocksource = CS_TSC;
+        return 0;
+    }
+#endif
+    return -1;
+}
+
+const char *clocksource_name(void)
+{
+    return clocksource == CS_TSC ? "tsc" : "clock_gettime";
+}
+
+#ifdef ARCH_HAVE_TSC
+static int tsc_invariant(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+
+    __asm__ __volatile__("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx),
+                         "=d" (edx) : "a" (0x80000000));
+    if (eax < 0x80000007)
+        return 0;
+    __asm__ __volatile__("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx),
+                         "=d" (edx) : "a" (0x80000007));
+    return (edx >> 8) & 1;
+}
+
+/*
+ * Spin for CALIBRATE_NS on the monotonic clock and derive the cycles to ns
+ * factor as a 32.32 fixed point multiplier.
+ */
+static int tsc_calibrate(void)
+{
+    uint64_t c0, c1, t0, t1;
+
+    if (!tsc_invariant()) {
+        fprintf(stderr, "TSC is not invariant on this CPU, "
+                "use --clocksource clock_gettime.\n");
+        return -1;
+    }
+
+    t0 = clock_now_ns();
+    c0 = get_cycles();
+    do {
+        t1 = clock_now_ns();
+    } while (t1 - t0 < CALIBRATE_NS);
+    c1 = get_cycles();
+
+    if (c1 <= c0)
+        return -1;
+    tsc_mult = (uint64_t)((((unsigned __int128)(t1 - t0)) << TSC_SHIFT) /
+                          (c1 - c0));
+    tsc_base = c1;
+    tsc_base_ns = t1;
+    return 0;
+}
+#endif
+
+/*
+ * Set up the selected clock source and measure what one clock read costs,
+ * which is reported next to the per-IO overhead. Return 0 on success.
+ */
+int clock_init(void)
+{
+    struct timeval tv;
+    uint64_t t0, t1;
+    int i;
+
+#ifdef ARCH_HAVE_TSC
+    if (clocksource == CS_TSC && tsc_calibrate() != 0)
+        return -1;
+#endif
+
+    gettimeofday(&tv, NULL);
+    t0 = now_ns();
+    epoch_offset_ns = (int64_t)tv.tv_sec * NSEC_PER_SEC +
+                      tv.tv_usec * NSEC_PER_USEC - (int64_t)t0;
+
+    t0 = now_ns();
+    for (i = 0; i < CLOCK_COST_LOOPS; i++)
+        t1 = now_ns();
+    t1 = now_ns();
+    clock_cost_ns = (t1 - t0) / CLOCK_COST_LOOPS;
+    return 0;
+}
+
+uint64_t clock_read_cost(void)
+{
+    return clock_cost_ns;
+}
+
+/* wall clock time of a now_ns() timestamp, for the trace records */
+uint64_t ns_to_epoch_ns(uint64_t ns)
+{
+    return (uint64_t)((int64_t)ns + epoch_offset_ns);
+}
+
+/*
+ * Wait until now_ns() reaches target. Sleep for all but the last SPIN_NS,
+ * then spin, because a timer wakeup alone can be late by tens of us.
+ */
+void sleep_until_ns(uint64_t target)
+{
+    uint64_t now = now_ns();
+
+    if (target > now + SPIN_NS) {
+        struct timespec ts, rem;
+        uint64_t delta = target - now - SPIN_NS;
+        ts.tv_sec = (time_t)(delta / NSEC_PER_SEC);
+        ts.tv_nsec = (long)(delta % NSEC_PER_SEC);
+        while (nanosleep(&ts, &rem) == -1 && errno == EINTR)
+            ts = rem;
+    }
+    while (now_ns() < target)
+        ;
+}
@@ -0,0 +1,95 @@
+/*
+ *   gettime.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Nanosecond monotonic clock for the IO path.
+ *
+ *   The default source is clock_gettime(CLOCK_MONOTONIC_RAW), which is not
+ *   stepped or slewed by NTP and is served from the vDSO on Linux. On x86
+ *   with an invariant TSC, --clocksource tsc reads the time stamp counter
+ *   directly and converts cycles to ns with a factor calibrated against
+ *   CLOCK_MONOTONIC_RAW at startup.
+ */
+
+#ifndef GETTIME_H
+#define GETTIME_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define NSEC_PER_USEC 1000ULL
+#define NSEC_PER_SEC 1000000000ULL
+
+#ifdef CLOCK_MONOTONIC_RAW
+#define IOMB_CLOCK CLOCK_MONOTONIC_RAW
+#else
+#define IOMB_CLOCK CLOCK_MONOTONIC
+#endif
+
+#if defined(__x86_64__)
+#define ARCH_HAVE_TSC
+#endif
+
+#define CS_CLOCK_GETTIME 0
+#define CS_TSC 1
+
+extern int clocksource;
+
+#ifdef ARCH_HAVE_TSC
+extern uint64_t tsc_base;
+extern uint64_t tsc_base_ns;
+extern uint64_t tsc_mult;
+#define TSC_SHIFT 32
+
+static inline uint64_t get_cycles(void)
+{
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint64_t tsc_now_ns(void)
+{
+    unsigned __int128 delta = get_cycles() - tsc_base;
+    return tsc_base_ns + (uint64_t)((delta * tsc_mult) >> TSC_SHIFT);
+}
+#endif
+
+static inline uint64_t clock_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(IOMB_CLOCK, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static inline uint64_t now_ns(void)
+{
+#ifdef ARCH_HAVE_TSC
+    if (clocksource == CS_TSC)
+        return tsc_now_ns();
+#endif
+    return clock_now_ns();
+}
+
+int parse_clocksource(const char *name);
+const char *clocksource_name(void);
+int clock_init(void);
+uint64_t clock_read_cost(void);
+uint64_t ns_to_epoch_ns(uint64_t ns);
+void sleep_until_ns(uint64_t target);
+
+#endif /* GETTIME_H */
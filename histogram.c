@@ -0,0 +1,180 @@
+/*
+ *   histogram.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Latency histogram merging, percentiles and raw dump.
+ */
+
+#include "histogram.h"
+
+#include <math.h>
+#include <string.h>
+
+void hist_init(struct histogram *h)
+{
+    memset(h, 0, sizeof(struct histogram));
+    h->min = UINT64_MAX;
+}
+
+void hist_merge(struct histogram *dst, const struct histogram *src)
+{
+    int i;
+    for (i = 0; i < HIST_NR_BUCKETS; i++)
+        dst->buckets[i] += src->buckets[i];
+    dst->count += src->count;
+    dst->sum += src->sum;
+    dst->sum_sq += src->sum_sq;
+    if (src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+/*
+ * Add what a live histogram recorded since the last call to dst, and
+ * remember its current state in prev. Safe while the owner keeps adding.
+ * min and max of dst are bucket edges, sum_sq is not tracked.
+ */
+void hist_delta(struct histogram *dst, struct histogram *prev,
+                const struct histogram *live)
+{
+    uint64_t sum;
+    int i;
+
+    for (i = 0; i < HIST_NR_BUCKETS; i++) {
+        uint64_t now = __atomic_load_n(&live->buckets[i], __ATOMIC_RELAXED);
+        uint64_t n = now - prev->buckets[i];
+
+        if (n == 0)
+            continue;
+        prev->buckets[i] = now;
+        dst->buckets[i] += n;
+        dst->count += n;
+        if (hist_bucket_low(i) < dst->min)
+            dst->min = hist_bucket_low(i);
+        if (hist_bucket_high(i) > dst->max)
+            dst->max = hist_bucket_high(i);
+    }
+    /* sum is read after the buckets and may be a few IOs ahead of them */
+    sum = __atomic_load_n(&live->sum, __ATOMIC_RELAXED);
+    dst->sum += sum - prev->sum;
+    prev->sum = sum;
+}
+
+/* smallest value that falls into bucket idx */
+uint64_t hist_bucket_low(int idx)
+{
+    int group, shift;
+
+    if (idx < (1 << HIST_SUB_BITS))
+        return idx;
+
+    group = idx / HIST_HALF;
+    shift = group - 1;
+    return (uint64_t)(idx - (group - 1) * HIST_HALF) << shift;
+}
+
+/* largest value that falls into bucket idx */
+uint64_t hist_bucket_high(int idx)
+{
+    if (idx == HIST_NR_BUCKETS - 1)
+        return UINT64_MAX;
+    return hist_bucket_low(idx + 1) - 1;
+}
+
+/*
+ * Value at the given percentile (0-100]. Reports the upper edge of the
+ * bucket holding that rank, clipped to the recorded max, so a percentile is
+ * never reported lower than the latency that was actually seen.
+ */
+uint64_t hist_percentile(const struct histogram *h, double percent)
+{
+    if (h->count == 0)
+        return 0;
+    return hist_rank_value(h, (uint64_t)ceil(percent / 100.0 * h->count));
+}
+
+/* value of the rank-th smallest sample, rank clipped to [1, count] */
+uint64_t hist_rank_value(const struct histogram *h, uint64_t rank)
+{
+    uint64_t seen = 0;
+    int i;
+
+    if (h->count == 0)
+        return 0;
+    if (rank < 1)
+        rank = 1;
+    if (rank > h->count)
+        rank = h->count;
+
+    for (i = 0; i < HIST_NR_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t value = hist_bucket_high(i);
+            if (value > h->max)
+                value = h->max;
+            if (value < h->min)
+                value = h->min;
+            return value;
+        }
+    }
+    return h->max;
+}
+
+double hist_mean(const struct histogram *h)
+{
+    return h->count == 0 ? 0.0 : (double)h->sum / h->count;
+}
+
+double hist_stddev(const struct histogram *h)
+{
+    double mean, var;
+
+    if (h->count < 2)
+        return 0.0;
+    mean = hist_mean(h);
+    var = (h->sum_sq - mean * mean * h->count) / (h->count - 1);
+    return var > 0.0 ? sqrt(var) : 0.0;
+}
+
+/*
+ * One line per non-empty bucket:
+ *   hist,<name>,<index>,<low_ns>,<high_ns>,<count>
+ * preceded by a hist_summary line. The bucket layout only depends on
+ * HIST_SUB_BITS/HIST_MAX_BITS (printed in the summary), so dumps from
+ * several runs can be merged offline by summing counts per index.
+ */
+void hist_dump(FILE *out, const char *name, const struct histogram *h)
+{
+    int i;
+
+    fprintf(out, "hist_summary,%s,sub_bits,%d,max_bits,%d,count,%llu,"
+            "sum_ns,%llu,min_ns,%llu,max_ns,%llu\n",
+            name, HIST_SUB_BITS, HIST_MAX_BITS,
+            (unsigned long long)h->count, (unsigned long long)h->sum,
+            (unsigned long long)(h->count == 0 ? 0 : h->min),
+            (unsigned long long)h->max);
+
+    for (i = 0; i < HIST_NR_BUCKETS; i++) {
+        if (h->buckets[i] == 0)
+            continue;
+        fprintf(out, "hist,%s,%d,%llu,%llu,%llu\n", name, i,
+                (unsigned long long)hist_bucket_low(i),
+                (unsigned long long)hist_bucket_high(i),
+                (unsigned long long)h->buckets[i]);
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ *   histogram.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Log-bucketed latency histogram in nanoseconds, in the spirit of
+ *   HdrHistogram. Values below 2^HIST_SUB_BITS ns get one bucket each,
+ *   every power of two above that is split into 2^(HIST_SUB_BITS-1) linear
+ *   buckets, so the relative error is below 1/64 from 1 ns up to
+ *   2^HIST_MAX_BITS ns (about 18 minutes). Larger values land in the last
+ *   bucket but still count for min/max/mean.
+ *
+ *   A histogram has a single writer (its IO thread), so recording needs no
+ *   lock. Per-thread histograms are merged after the threads are joined.
+ *   The bucket, count and sum stores are relaxed atomics, which compile to
+ *   plain stores, so the interval reporter may read them during the run
+ *   with hist_delta().
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define HIST_SUB_BITS 7
+#define HIST_MAX_BITS 40
+#define HIST_HALF (1 << (HIST_SUB_BITS - 1))
+#define HIST_NR_BUCKETS ((1 << HIST_SUB_BITS) + \
+                         (HIST_MAX_BITS - HIST_SUB_BITS) * HIST_HALF)
+
+#define MAX_PERCENTILES 16
+
+struct histogram {
+    uint64_t count;
+    uint64_t sum;           /* ns */
+    double sum_sq;          /* ns^2, for stddev */
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[HIST_NR_BUCKETS];
+};
+
+static inline int hist_bucket(uint64_t value)
+{
+    int msb, idx;
+
+    if (value < (1 << HIST_SUB_BITS))
+        return (int)value;
+
+    msb = 63 - __builtin_clzll(value);
+    idx = (msb - HIST_SUB_BITS + 1) * HIST_HALF +
+          (int)(value >> (msb - HIST_SUB_BITS + 1));
+    return idx < HIST_NR_BUCKETS ? idx : HIST_NR_BUCKETS - 1;
+}
+
+static inline void hist_add(struct histogram *h, uint64_t value)
+{
+    int idx = hist_bucket(value);
+
+    __atomic_store_n(&h->buckets[idx], h->buckets[idx] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->count, h->count + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->sum, h->sum + value, __ATOMIC_RELAXED);
+    h->sum_sq += (double)value * value;
+    if (value < h->min)
+        h->min = value;
+    if (value > h->max)
+        h->max = value;
+}
+
+void hist_init(struct histogram *h);
+void hist_merge(struct histogram *dst, const struct histogram *src);
+void hist_delta(struct histogram *dst, struct histogram *prev,
+                const struct histogram *live);
+uint64_t hist_bucket_low(int idx);
+uint64_t hist_bucket_high(int idx);
+uint64_t hist_percentile(const struct histogram *h, double percent);
+uint64_t hist_rank_value(const struct histogram *h, uint64_t rank);
+double hist_mean(const struct histogram *h);
+double hist_stddev(const struct histogram *h);
+void hist_dump(FILE *out, const char *name, const struct histogram *h);
+
+#endif /* HISTOGRAM_H */
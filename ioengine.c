@@ -0,0 +1,75 @@
+/*
+ *   ioengine.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   IO engine registry and the psync engine, which is the original
+ *   blocking read/write loop of iombench: one request in flight per thread.
+ */
+
+#include "iombench.h"
+#include "ioengine.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+static const struct ioengine_ops *ioengines[] = {
+    &ioengine_psync,
+#ifdef __linux__
+    &ioengine_io_uring,
+    &ioengine_libaio,
+    &ioengine_mmap,
+#endif
+    NULL
+};
+
+const struct ioengine_ops *find_ioengine(const char *name)
+{
+    int i;
+    for (i = 0; ioengines[i] != NULL; i++) {
+        if (strcmp(ioengines[i]->name, name) == 0)
+            return ioengines[i];
+    }
+    return NULL;
+}
+
+void list_ioengines(FILE *out)
+{
+    int i;
+    for (i = 0; ioengines[i] != NULL; i++)
+        fprintf(out, "%s%s", i == 0 ? "" : ", ", ioengines[i]->name);
+}
+
+static int psync_queue(struct thread_data *td, struct io_u *io_u)
+{
+    if (io_u->is_write > 0)
+        io_u->result = pwrite(td->fds[io_u->file], io_u->buf, io_u->size,
+                              io_u->offset);
+    else
+        io_u->result = pread(td->fds[io_u->file], io_u->buf, io_u->size,
+                             io_u->offset);
+
+    if (io_u->result < 0)
+        io_u->result = -errno;
+    return IO_Q_COMPLETED;
+}
+
+const struct ioengine_ops ioengine_psync = {
+    .name = "psync",
+    .sync = 1,
+    .queue = psync_queue,
+};
@@ -0,0 +1,66 @@
+/*
+ *   ioengine.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   IO engine interface. do_io() drives every engine the same way:
+ *
+ *     queue()      hand one prepared io_u to the engine. Synchronous
+ *                  engines do the IO right away and return IO_Q_COMPLETED,
+ *                  asynchronous engines stage it and return IO_Q_QUEUED.
+ *     commit()     submit everything staged since the last commit.
+ *     getevents()  wait for at least <min> and reap at most <max>
+ *                  completions into td->events, return the number reaped.
+ *
+ *   All callbacks return negative errno on failure.
+ */
+
+#ifndef IOENGINE_H
+#define IOENGINE_H
+
+#include "iombench.h"
+
+#define IO_Q_COMPLETED 0
+#define IO_Q_QUEUED 1
+
+struct ioengine_ops {
+    const char *name;
+    int sync;               /* 1 if the engine completes IO inside queue() */
+    int mapped;             /* IO through a mapping, not the fd, see open_target() */
+    int (*init)(struct thread_data *td);
+    int (*queue)(struct thread_data *td, struct io_u *io_u);
+    int (*commit)(struct thread_data *td);
+    int (*getevents)(struct thread_data *td, int min, int max);
+    void (*cleanup)(struct thread_data *td);
+};
+
+extern const struct ioengine_ops ioengine_psync;
+#ifdef __linux__
+extern const struct ioengine_ops ioengine_io_uring;
+extern const struct ioengine_ops ioengine_libaio;
+extern const struct ioengine_ops ioengine_mmap;
+#endif
+
+const struct ioengine_ops *find_ioengine(const char *name);
+void list_ioengines(FILE *out);
+
+struct json_writer;
+
+/* page fault results of the mmap engine */
+void print_mmap_line(const struct job *job, const char *sep);
+void mmap_json(struct json_writer *w, const struct job *job);
+
+#endif /* IOENGINE_H */
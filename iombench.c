@@ -21,20 +21,20 @@
  *   Written by Yongkun Wang (yongkun@gmail.com)
  */
 
-#define _GNU_SOURCE
-#define _LARGEFILE64_SOURCE
-
-#ifdef __APPLE__
-#define lseek64 lseek
-#define open64 open
-#endif
-
-#define SECTOR_SIZE 512
-#define ASCII_PRINTABLE_LOW 32
-#define ASCII_PRINTABLE_HIGH 126
-#define MAX_FILE_NAME_LENGTH 1024
-
-#define GET_OUTPUT(fd) ((fd) != NULL ? (fd) : stdout)
+#include "iombench.h"
+#include "ioengine.h"
+#include "gettime.h"
+#include "rand.h"
+#include "dist.h"
+#include "blocksize.h"
+#include "trace.h"
+#include "report.h"
+#include "precond.h"
+#include "jobfile.h"
+#include "json.h"
+#include "compare.h"
+#include "verify.h"
+#include "sweep.h"
 
 #include <fcntl.h>
 #include <errno.h>
@@ -48,6 +48,8 @@
 #include <pthread.h>
 #include <libgen.h>
 #include <limits.h>
+#include <math.h>
+#include <sys/utsname.h>
 
 void usage(void)
 {
@@ -57,10 +59,10 @@ void usage(void)
         "       iombench - microbenchmark for storage devices/systems\n"
         "\n"
         "SYNOPSIS\n"
-        "       iombench  [ -d time ] [ -f filename ] [ -n count ] [ -H ]\n"
-        "                [ -p size ] [ -o filename ] [ -P ] [ -r percent ]\n"
-        "                [ -R time ] [ -s addr ] [ -S addr ] [ -t count ]\n"
-        "                [ -w percent ]\n"
+        "       iombench  [ -d time ] [ -e engine ] [ -f filename ] [ -n count ]\n"
+        "                [ -H ] [ -p size ] [ -o filename ] [ -P ] [ -q depth ]\n"
+        "                [ -r percent ] [ -R time ] [ -s addr ] [ -S addr ]\n"
+        "                [ -t count ] [ -w percent ] [ long options ]\n"
         "       iombench  -h\n"
         "\n"
         "DESCRIPTION\n"
@@ -70,6 +72,8 @@ void usage(void)
         "           - Various IO sequences including sequential/random\n"
         "             reads/writes, and mixed IOs with any R/W ratio.\n"
         "           - Multi-threading to simulate multiple outstanding IOs.\n"
+        "           - Asynchronous IO engines (io_uring, libaio) with\n"
+        "             configurable queue depth per thread.\n"
         "           - Using O_SYNC and O_DIRECT to try to bypass OS or file\n"
         "             system buffer. Support raw IO on device file.\n"
         "       It is recommended to tune your devices/systems for prefetching\n"
@@ -79,12 +83,31 @@ void usage(void)
         "   -d <time>       Duration of test of each thread in seconds. \n"
         "                   The longer the better, especially for SSDs.\n"
         "\n"
+        "   -e <engine>     IO engine. Default psync.\n"
+        "                   psync     one blocking pread/pwrite per thread,\n"
+        "                             the original iombench behaviour.\n"
+        "                   io_uring  Linux io_uring, keeps up to -q requests\n"
+        "                             in flight per thread.\n"
+        "                   libaio    Linux native AIO (io_submit and\n"
+        "                             io_getevents), keeps up to -q requests\n"
+        "                             in flight per thread. Fallback where\n"
+        "                             io_uring is not permitted.\n"
+        "                   mmap      loads and stores on a shared mapping of\n"
+        "                             [-s, -S), with non-temporal copies, for\n"
+        "                             the page cache and DAX/pmem. Reports\n"
+        "                             page faults, see --mmap_sync.\n"
+        "\n"
         "   -f <filename>   Filename for test. Can be device file like /dev/sda."
         "\n"
         "                   This is a recommended way to test new drives.\n"
         "                   Make sure you have correct permissions.\n"
         "                   WARNING! All data include partition table will be\n"
         "                   overwritten! Cannot be recovered!\n"
+        "                   A comma separated list of paths and glob patterns\n"
+        "                   runs the job on several targets, e.g.\n"
+        "                   /dev/nvme[0-9]n1 or a.dat@0-1g,b.dat@2g-3g, where\n"
+        "                   @<start>-<end> is a target's own range instead of\n"
+        "                   [-s, -S). See --target_mode.\n"
         "\n"
         "   -n <count>      Send <number> of requests per thread. Program will\n"
         "                   terminate by -n or -d which happens first.\n"
@@ -95,9 +118,16 @@ void usage(void)
         "\n"
         "   -p <size>       Page size in sector (512B) for IO. This number\n"
         "                   is multiplied by 512. For example, -p 8 uses 4096\n"
-        "                   as page size.\n"
+        "                   as page size. At most 131072 (64MB).\n"
+        "\n"
+        "   -P              Output the execution details of each request as\n"
+        "                   io,<sec>,<r|w>,<size>,<offset>,<latency_us>\n"
+        "                   records. They are written by a separate thread,\n"
+        "                   off the IO path.\n"
         "\n"
-        "   -P              Output the execution details of each request.\n"
+        "   -q <depth>      Number of outstanding requests per thread (queue\n"
+        "                   depth) for asynchronous engines. Default 1.\n"
+        "                   Always 1 for psync.\n"
         "\n"
         "   -r              Use random addresses. Random IO.\n"
         "\n"
@@ -131,24 +161,412 @@ void usage(void)
         "   -t <count>      Number of threads.\n"
         "\n"
         "   -w <percent>    Percent of write requests. 0-100. Default 50.\n"
+        "\n"
+        "LONG OPTIONS\n"
+        "   --ioengine <engine>     Same as -e.\n"
+        "\n"
+        "   --iodepth <depth>       Same as -q.\n"
+        "\n"
+        "   --iodepth_batch <count> Number of requests to queue before they are\n"
+        "                           submitted to the kernel in one call.\n"
+        "                           Default 1, 0 means the full queue depth.\n"
+        "\n"
+        "   --iodepth_batch_complete <count>\n"
+        "                           Minimum number of completions to wait for\n"
+        "                           in one call while the queue is refilled.\n"
+        "                           Default 1.\n"
+        "\n"
+        "   --iodepth_batch_complete_max <count>\n"
+        "                           Maximum number of completions to reap in\n"
+        "                           one call. Default 0, the full queue depth.\n"
+        "\n"
+        "   --fixedbufs             io_uring: register IO buffers with the\n"
+        "                           kernel and use READ/WRITE_FIXED.\n"
+        "\n"
+        "   --registerfiles         io_uring: register the file descriptor\n"
+        "                           with the kernel.\n"
+        "\n"
+        "   --sqpoll                io_uring: let a kernel thread poll the\n"
+        "                           submission queue, which saves the submit\n"
+        "                           syscall. May need root on older kernels.\n"
+        "\n"
+        "   --sqpoll_idle <ms>      io_uring: idle time before the SQ poll\n"
+        "                           thread sleeps. Default 2000.\n"
+        "\n"
+        "   --direct <0|1>          Open the target with O_DIRECT. Default 1.\n"
+        "                           libaio is synchronous without it.\n"
+        "\n"
+        "   --sync <mode>           Synchronous writes:\n"
+        "                           osync   O_SYNC, data and metadata. Default.\n"
+        "                           odsync  O_DSYNC, data and the metadata\n"
+        "                                   needed to read it back.\n"
+        "                           none    durable only after a flush.\n"
+        "\n"
+        "   --flush <call>          Flush the file after --flush_every writes or\n"
+        "                           --flush_bytes written, like a write-ahead\n"
+        "                           log's group commit: fsync, fdatasync or\n"
+        "                           sync_file_range (write out and wait, no\n"
+        "                           metadata). Flushes are timed on their own\n"
+        "                           on a \"flush:\" line, not as requests.\n"
+        "\n"
+        "   --flush_every <n>       Flush after every <n> completed writes.\n"
+        "                           Default 1 with --flush. Implies --flush\n"
+        "                           fdatasync.\n"
+        "\n"
+        "   --flush_bytes <size>    Flush once <size> bytes were written since\n"
+        "                           the last flush. Implies --flush fdatasync.\n"
+        "\n"
+        "   --mmap_sync <mode>      mmap: when a write is durable.\n"
+        "                           msync     msync() of the written pages\n"
+        "                                     after each write. Default.\n"
+        "                           map_sync  MAP_SYNC mapping, stores are\n"
+        "                                     durable once fenced. DAX only.\n"
+        "                           none      left in the page cache.\n"
+        "\n"
+        "   --percentiles <list>    Comma separated latency percentiles to\n"
+        "                           report, e.g. 50,90,99,99.9. At most 16.\n"
+        "                           Default 50,99,99.9,99.99.\n"
+        "\n"
+        "   --hist_dump             Append the raw latency histogram buckets\n"
+        "                           (hist,<r|w|t>,<index>,<low_ns>,<high_ns>,\n"
+        "                           <count>) to the output. Buckets with the\n"
+        "                           same index can be summed across runs.\n"
+        "\n"
+        "   --seed <number>         Seed of the per-thread random generators\n"
+        "                           for offsets and read/write decisions.\n"
+        "                           Runs with the same seed and options issue\n"
+        "                           the same requests. Default is taken from\n"
+        "                           the time and printed in the configuration.\n"
+        "\n"
+        "   --random_distribution <spec>\n"
+        "                           Offset distribution for random IO, implies\n"
+        "                           -r. Non-uniform distributions pick\n"
+        "                           page size blocks of [-s, -S).\n"
+        "                           random         uniform. Default.\n"
+        "                           zipf:<theta>   zipf, e.g. zipf:1.2\n"
+        "                           pareto:<h>     pareto, 0 < h < 1,\n"
+        "                                          e.g. pareto:0.9\n"
+        "                           normal:<dev>   gaussian around the middle\n"
+        "                                          of the span, stddev in\n"
+        "                                          percent of the span\n"
+        "                           hotset:<x>/<y> x percent of the IOs to\n"
+        "                                          y percent of the span,\n"
+        "                                          e.g. hotset:90/10\n"
+        "                           Hot blocks of zipf and pareto are spread\n"
+        "                           over the span.\n"
+        "\n"
+        "   --full_coverage         Random IO without replacement. Every page\n"
+        "                           size block of [-s, -S) is accessed exactly\n"
+        "                           once per pass, in a different random order\n"
+        "                           each pass. Threads take disjoint slices of\n"
+        "                           each pass. Implies -r. Uses a keyed\n"
+        "                           Feistel permutation, no per-block memory.\n"
+        "\n"
+        "   --seq_layout <layout>   How threads share [-s, -S) in sequential\n"
+        "                           mode. Each thread rewinds to the start of\n"
+        "                           its own range.\n"
+        "                           shared  every thread walks the whole\n"
+        "                                   range from -s. Default.\n"
+        "                           split   disjoint contiguous region per\n"
+        "                                   thread.\n"
+        "                           stride  threads interleave with a stride\n"
+        "                                   of threads * page size.\n"
+        "\n"
+        "   --bssplit <spec>        Mix of block sizes with their percent of\n"
+        "                           requests, e.g. 4k:70,64k:20,1m:10. Sizes\n"
+        "                           are multiples of 512 up to 64m. Statistics\n"
+        "                           are also reported per size.\n"
+        "\n"
+        "   --bsrange <min>-<max>   Block sizes uniformly from <min> to <max>\n"
+        "                           in steps of --bs_align, e.g. 4k-128k.\n"
+        "                           Statistics are also reported per power of\n"
+        "                           two size class.\n"
+        "\n"
+        "   --bs_align <size>       Alignment of random offsets and step of\n"
+        "                           --bsrange. Default the smallest block size,\n"
+        "                           or 512 with a fixed -p size.\n"
+        "\n"
+        "   --rate_iops <iops>      Open loop: issue requests on a schedule of\n"
+        "                           <iops> per second instead of as soon as\n"
+        "                           the previous one returns. Latency is\n"
+        "                           measured from the intended start, so\n"
+        "                           device stalls are not hidden.\n"
+        "\n"
+        "   --rate_bw <bytes>       Like --rate_iops with a bandwidth target in\n"
+        "                           bytes per second, e.g. 200m.\n"
+        "\n"
+        "   --rate_scope <scope>    thread: every thread gets the full rate.\n"
+        "                           Default. global: the rate is shared by\n"
+        "                           all threads.\n"
+        "\n"
+        "   --rate_process <type>   constant: evenly spaced arrivals. Default.\n"
+        "                           poisson: exponential gaps, same mean.\n"
+        "\n"
+        "   --trace <file>          Write a binary record of each request (start\n"
+        "                           time, op, size, offset, latency, thread,\n"
+        "                           queue depth) to <file>. Replaces the text\n"
+        "                           records of -P and is cheaper to write.\n"
+        "\n"
+        "   --trace_convert <file>  Print the binary trace <file> as -P text\n"
+        "                           records, to -o or stdout, and exit.\n"
+        "\n"
+        "   --report_interval <ms>  Print IOPS, bandwidth and p50/p99/max\n"
+        "                           latency per direction every <ms> during\n"
+        "                           the run, as \"interval:\" lines.\n"
+        "\n"
+        "   --report_file <file>    Also write the interval reports to <file>.\n"
+        "\n"
+        "   --report_format <fmt>   csv (default) or json, one line per\n"
+        "                           interval, for --report_file.\n"
+        "\n"
+        "   --precondition <n>      Before the run, write the range [-s, -S)\n"
+        "                           once sequentially and then <n> times in\n"
+        "                           random order, to get an SSD out of its\n"
+        "                           fresh-out-of-box state.\n"
+        "\n"
+        "   --steady_state <w>      Run unmeasured until the device is steady,\n"
+        "                           then measure for -d seconds. Steady means\n"
+        "                           IOPS and latency of the last <w> samples\n"
+        "                           stay within a range of --ss_tolerance\n"
+        "                           percent of their mean, and their best fit\n"
+        "                           line moves less than half of that.\n"
+        "                           Not with stonewall groups.\n"
+        "\n"
+        "   --ss_interval <ms>      Sample interval for --steady_state.\n"
+        "                           Default 1000.\n"
+        "\n"
+        "   --ss_tolerance <pct>    Tolerance for --steady_state. Default 20.\n"
+        "\n"
+        "   --ss_max <s>            Start measuring after <s> seconds even if\n"
+        "                           the device is not steady. Default 600.\n"
+        "\n"
+        "   --jobfile <file>        Run the jobs of an ini style job file. Each\n"
+        "                           [name] section is a job, keys are the long\n"
+        "                           option names (duration, filename, count,\n"
+        "                           page_size, random, start_addr, seek_span,\n"
+        "                           threads, write_percent, ioengine, iodepth,\n"
+        "                           bssplit, rate_iops, ...) as key=value, or\n"
+        "                           a bare key, key=1 or key=0 for a switch.\n"
+        "                           Jobs start from the command line values\n"
+        "                           and the [global] sections before them.\n"
+        "                           Jobs run concurrently; a job with the\n"
+        "                           stonewall key waits until all jobs before\n"
+        "                           it have finished. Results are reported per\n"
+        "                           job.\n"
+        "\n"
+        "   --output-format <fmt>   text (default) or json. json prints one\n"
+        "                           JSON document instead of the text lines:\n"
+        "                           host, configuration, per job and per\n"
+        "                           thread stats with latency histograms, and\n"
+        "                           throughput samples for --compare.\n"
+        "\n"
+        "   --compare <file>        After the run, compare each job with the\n"
+        "                           job of the same name in <file>, a result\n"
+        "                           of --output-format json. IOPS and\n"
+        "                           bandwidth samples are compared with\n"
+        "                           Welch's t-test, tail percentiles by\n"
+        "                           their confidence intervals. Exits with 1\n"
+        "                           if a metric got significantly worse.\n"
+        "\n"
+        "   --compare_threshold <pct>\n"
+        "                           Smallest change in percent that counts as\n"
+        "                           a regression. Default 5.\n"
+        "\n"
+        "   --cpus_allowed <list>   Run the IO threads on the CPUs of <list>,\n"
+        "                           e.g. 0-3,8. Buffers are allocated by the\n"
+        "                           pinned thread, so they are local to it.\n"
+        "\n"
+        "   --cpus_allowed_policy <policy>\n"
+        "                           shared: every thread may run on all CPUs of\n"
+        "                           the list. Default. split: thread t is pinned\n"
+        "                           to the t-th CPU of the list, round robin.\n"
+        "\n"
+        "   --numa_node <n|local>   Bind the IO buffers to NUMA node <n> and run\n"
+        "                           the threads on its CPUs unless --cpus_allowed\n"
+        "                           is given. local is the node of the device\n"
+        "                           under test, found in sysfs. The placement of\n"
+        "                           each thread is reported on \"affinity:\" lines.\n"
+        "\n"
+        "   --verify                Write verifiable data: every --verify_interval\n"
+        "                           unit of a write carries a header (offset,\n"
+        "                           sequence number, time, seed), a payload\n"
+        "                           generated from the seed and a CRC32C. Reads\n"
+        "                           check every unit and report checksum\n"
+        "                           (torn or corrupted), offset (misdirected),\n"
+        "                           stale and lost write errors on\n"
+        "                           \"verify_error:\" lines. Stale and lost writes\n"
+        "                           are found when each block has one writer\n"
+        "                           thread. Exits with 2 on any error.\n"
+        "\n"
+        "   --verify_interval <size>\n"
+        "                           Verify unit. Default --bs_align.\n"
+        "\n"
+        "   --verify_pass           Like --verify, and after the job's IO read\n"
+        "                           back all of [-s, -S) and check it.\n"
+        "\n"
+        "   --compress_ratio <r>    Write data that compresses by about <r>:1,\n"
+        "                           1 for incompressible. Writes point into a\n"
+        "                           pool of buffers filled at startup instead of\n"
+        "                           a memset per request; each write only stamps\n"
+        "                           8 unique bytes per 512 so no two blocks are\n"
+        "                           the same. At most 64. Default: the original\n"
+        "                           one character pattern.\n"
+        "\n"
+        "   --dedupe_percent <n>    Make <n> percent of the writes copies of one\n"
+        "                           block, the rest unique. Implies\n"
+        "                           --compress_ratio 1 unless it is given.\n"
+        "\n"
+        "   --replay <file>         Issue the requests of a recorded trace, with\n"
+        "                           their offset, size and direction, instead of\n"
+        "                           generated ones: an iombench --trace file,\n"
+        "                           -P \"io,\" records (1 s timestamps) or blkparse\n"
+        "                           output (Q events). The trace is streamed, not\n"
+        "                           loaded. Offsets outside [-s, -S) are folded\n"
+        "                           into it, requests larger than -p clipped.\n"
+        "                           Runs to the end of the trace unless -d or -n\n"
+        "                           is given. Reported on a \"replay:\" line.\n"
+        "\n"
+        "   --replay_speed <x>      Issue requests at their trace time divided by\n"
+        "                           <x>. Default 1, the original timing. 0 is as\n"
+        "                           fast as possible with at most -t x -q\n"
+        "                           requests in flight.\n"
+        "\n"
+        "   --meta_mix <mix>        File system metadata workload instead of\n"
+        "                           block IO, -f is the root directory. <mix>\n"
+        "                           is op:percent,... of create, read, stat,\n"
+        "                           rename and unlink, adding up to 100, e.g.\n"
+        "                           create:30,stat:40,read:20,unlink:10. Ops per\n"
+        "                           second and latency per op are reported on\n"
+        "                           \"metadata:\" and \"meta_latency:\" lines.\n"
+        "\n"
+        "   --meta_fanout <n>       Subdirectories per directory. Default 16.\n"
+        "\n"
+        "   --meta_depth <n>        Levels of subdirectories. Default 2.\n"
+        "\n"
+        "   --meta_files <n>        File names per thread, half of them created\n"
+        "                           before the run. Default 4096.\n"
+        "\n"
+        "   --meta_file_size <size> Bytes written by create. Default 4k.\n"
+        "\n"
+        "   --meta_fsync <0|1>      fsync each created file. Default 1.\n"
+        "\n"
+        "   --sweep_bs <list>       Sweep: run the job once per block size of\n"
+        "                           <list>, e.g. 4k,16k,64k, in one process.\n"
+        "                           Combines with the other --sweep options,\n"
+        "                           unlisted parameters keep their value. Each\n"
+        "                           point prints one record\n"
+        "                           sweep,<bs>,<threads>,<iodepth>,<read_pct>,\n"
+        "                           <iops>,<bw_bytes>,<mean_us>,<p50_us>,\n"
+        "                           <p99_us>,<max_us>,<saturated>,<slo_iops>\n"
+        "                           instead of the results. saturated is 1 when\n"
+        "                           more load (queue depth, or threads with one\n"
+        "                           depth) gained less than 10 percent IOPS;\n"
+        "                           two saturated points end that axis.\n"
+        "\n"
+        "   --sweep_threads <list>  Sweep the thread count, e.g. 1,2,4,8.\n"
+        "\n"
+        "   --sweep_iodepth <list>  Sweep the queue depth, e.g. 1,4,16,64.\n"
+        "\n"
+        "   --sweep_read <list>     Sweep the read percent, e.g. 100,70,0.\n"
+        "\n"
+        "   --slo_p99 <us>          For every point, also find the most IOPS\n"
+        "                           whose p99 latency stays within <us>: open\n"
+        "                           loop runs at rising global --rate_iops,\n"
+        "                           then a bisection. Reported as slo_iops.\n"
+        "                           Implies a sweep.\n"
+        "\n"
+        "   --target_mode <mode>    How the threads of a -f list share the\n"
+        "                           targets.\n"
+        "                           thread  each thread on one target, round\n"
+        "                                   robin. Default.\n"
+        "                           stripe  every thread on all targets, RAID-0\n"
+        "                                   style in --stripe_size chunks.\n"
+        "                           Each target reports a \"target:\" line and\n"
+        "                           the spread between them a \"targets:\" line.\n"
+        "\n"
+        "   --stripe_size <size>    Chunk of --target_mode stripe, at least the\n"
+        "                           largest block size. Default 128k.\n"
+        "\n"
+        "   --target_threads <n>    Threads per target in --target_mode thread,\n"
+        "                           instead of -t in all.\n"
+        "\n"
+        "   --clocksource <source>  Clock for latency measurement.\n"
+        "                           clock_gettime  CLOCK_MONOTONIC_RAW, ns\n"
+        "                                          resolution, not stepped\n"
+        "                                          by NTP. Default.\n"
+        "                           tsc            x86 time stamp counter,\n"
+        "                                          calibrated at startup.\n"
+        "                                          Needs an invariant TSC.\n"
         "\n");
 }
 
 /* for options */
-int duration = 10;
-char filename[MAX_FILE_NAME_LENGTH] = "testfile.tmp";
-int request_count = 100;
 char human_readable[2];
 char output_filename[MAX_FILE_NAME_LENGTH];
 FILE *output_file;
-int page_size = 4096;
 int print_detail = 0;
-int random_addr = 0;
 int rampup_interval = 0; /* in us (microsecond) */
-off_t start_addr = 0;
-off_t seek_span = 16*1024*1024;
-int thread_count = 1;
-int write_percent = 50;
+int fixed_bufs = 0;
+int register_files = 0;
+int sqpoll = 0;
+int sqpoll_idle = 2000;
+double percentiles[MAX_PERCENTILES] = { 50, 99, 99.9, 99.99 };
+int nr_percentiles = 4;
+int hist_dump_enabled = 0;
+uint64_t rand_seed = 0;
+int rand_seed_set = 0;
+char job_filename[MAX_FILE_NAME_LENGTH];
+char trace_filename[MAX_FILE_NAME_LENGTH];
+char trace_convert_filename[MAX_FILE_NAME_LENGTH];
+int report_interval = 0;        /* ms */
+char report_filename[MAX_FILE_NAME_LENGTH];
+int report_format = REPORT_CSV;
+int precondition_passes = -1;   /* off */
+int ss_window = 0;              /* samples, 0 is off */
+int ss_interval = 1000;         /* ms */
+int ss_tolerance = 20;          /* percent */
+int ss_max = 600;               /* s */
+int output_format = OUTPUT_TEXT;
+char compare_filename[MAX_FILE_NAME_LENGTH];
+double compare_threshold = 5.0; /* percent */
+struct sweep_spec sweep_spec;
+const char *seq_layout_names[] = { "shared", "split", "stride" };
+const char *mmap_sync_names[] = { "none", "msync", "map_sync" };
+const char *sync_mode_names[] = { "none", "odsync", "osync" };
+const char *flush_names[] = { "none", "fsync", "fdatasync", "sync_file_range" };
+
+/* the command line job, and the jobs that run */
+struct job cmdline_job = {
+    .name = "default",
+    .filename = "testfile.tmp",
+    .target_fd = -1,
+    .duration = 10,
+    .request_count = 100,
+    .page_size = 4096,
+    .write_percent = 50,
+    .seek_span = 16*1024*1024,
+    .thread_count = 1,
+    .ioengine_name = "psync",
+    .iodepth = 1,
+    .iodepth_batch = 1,
+    .iodepth_batch_complete = 1,
+    .mmap_sync = MMAP_SYNC_MSYNC,
+    .direct = 1,
+    .sync_mode = SYNC_OSYNC,
+    .replay_speed = 1.0,
+    .meta_fanout = 16,
+    .meta_depth = 2,
+    .meta_files = 4096,
+    .meta_file_size = 4096,
+    .meta_fsync = 1,
+    .target_mode = TARGET_MODE_THREAD,
+    .stripe_size = DEFAULT_STRIPE_SIZE,
+    .seq_layout = SEQ_LAYOUT_SHARED,
+    .rate_process = RATE_CONSTANT,
+    .numa_node = NUMA_NODE_NONE,
+};
+struct job *jobs;
+int nr_jobs;
 
 void close_file(void)
 {
@@ -156,32 +574,68 @@ void close_file(void)
         fclose(output_file);
 }
 
-void print_option_values(void)
+void print_option_values(const struct job *job)
 {
+    if (nr_jobs > 1)
+        fprintf(GET_OUTPUT(output_file), "job: name %s , stonewall %d\n",
+                job->name, job->stonewall);
     fprintf(GET_OUTPUT(output_file), "configuration: %s"
            "request_count %d , filename %s , %s"
            "page_size %d , write_percent %d , random_addr %d , duration %d , %s"
            "start_addr %lld , seek_span %lld , thread_count %d , %s"
-           "rampup_interval %d , print_detail %d , output_filename %s\n",
+           "rampup_interval %d , print_detail %d , output_filename %s , %s"
+           "ioengine %s , iodepth %d , iodepth_batch %d , "
+           "iodepth_batch_complete %d , iodepth_batch_complete_max %d , "
+           "fixedbufs %d , registerfiles %d , sqpoll %d , percentiles ",
            human_readable, 
-           request_count, filename, human_readable,
-           page_size, write_percent, random_addr, duration, human_readable,
-           (long long int)start_addr, (long long int)seek_span, thread_count,
-            human_readable,
-           rampup_interval, print_detail, output_filename);
+           job->request_count, job->filename, human_readable,
+           job->page_size, job->write_percent, job->random_addr,
+           job->duration, human_readable,
+           (long long int)job->start_addr, (long long int)job->seek_span,
+           job->thread_count, human_readable,
+           rampup_interval, print_detail, output_filename, human_readable,
+           job->ioengine_name, job->iodepth, job->iodepth_batch,
+           job->iodepth_batch_complete, job->iodepth_batch_complete_max,
+           fixed_bufs, register_files, sqpoll);
+    int i;
+    for (i = 0; i < nr_percentiles; i++)
+        fprintf(GET_OUTPUT(output_file), "%s%g", i == 0 ? "" : ",",
+                percentiles[i]);
+    fprintf(GET_OUTPUT(output_file), " , hist_dump %d , "
+            "clocksource %s , seed %llu , random_distribution %s",
+            hist_dump_enabled, clocksource_name(),
+            (unsigned long long)rand_seed,
+            job->offset_dist.type == DIST_UNIFORM ? "random"
+                                                  : job->offset_dist.spec);
+    fprintf(GET_OUTPUT(output_file), " , full_coverage %d , seq_layout %s , "
+            "bs %s , bs_align %d , rate_iops %lld , rate_bw %lld , "
+            "rate_scope %s , rate_process %s , cpus_allowed %s , "
+            "cpus_allowed_policy %s , numa_node %d , verify %d , "
+            "verify_interval %d , verify_pass %d , compress_ratio %.2f , "
+            "dedupe_percent %d , mmap_sync %s , replay %s , "
+            "replay_speed %g , direct %d , sync %s , flush %s , "
+            "flush_every %d , flush_bytes %lld , meta_mix %s , "
+            "meta_fanout %d , meta_depth %d , meta_files %d , "
+            "meta_file_size %d , meta_fsync %d , target_mode %s , "
+            "stripe_size %lld , target_threads %d\n", job->full_coverage,
+            seq_layout_names[job->seq_layout],
+            job->bs_spec.mode == BS_FIXED ? "fixed" : job->bs_spec.spec,
+            job->bs_spec.align, job->rate_iops, job->rate_bw,
+            job->rate_global > 0 ? "global" : "thread",
+            job->rate_process == RATE_POISSON ? "poisson" : "constant",
+            job->cpus_allowed.nr > 0 ? job->cpus_allowed_spec : "all",
+            job->cpus_split ? "split" : "shared", job->numa_node,
+            job->verify, job->verify_interval, job->verify_pass,
+            job->compress_ratio, job->dedupe_percent,
+            mmap_sync_names[job->mmap_sync], job->replay_filename,
+            job->replay_speed, job->direct, sync_mode_names[job->sync_mode],
+            flush_names[job->flush], job->flush_every, job->flush_bytes,
+            job->meta ? job->meta_mix_spec : "none", job->meta_fanout,
+            job->meta_depth, job->meta_files, job->meta_file_size,
+            job->meta_fsync, target_mode_names[job->target_mode],
+            job->stripe_size, job->target_threads);
 }
 
-/* for stats */
-time_t sum_time = 0;
-long total_count = 0;
-time_t w_sum_time = 0;
-long w_total_count = 0;
-time_t r_sum_time = 0;
-long r_total_count = 0;
-
-/* pthread init */
-pthread_mutex_t mutex_mix_sum = PTHREAD_MUTEX_INITIALIZER;
-
 inline off_t align_address(off_t addr)
 {
     if (addr < SECTOR_SIZE)
@@ -242,36 +696,888 @@ int check_path(const char *filename, int create)
     return 0;
 }
 
+/*
+ * parse a comma separated percentile list such as "50,99,99.9" into
+ * percentiles[]. Return 0 on success, -1 on malformed input.
+ */
+int parse_percentiles(const char *list)
+{
+    char *copy = strdup(list);
+    char *save = NULL;
+    char *tok;
+    int n = 0;
+
+    for (tok = strtok_r(copy, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        char *end;
+        double p = strtod(tok, &end);
+        if (*end != '\0' || p <= 0 || p > 100 || n == MAX_PERCENTILES) {
+            free(copy);
+            return -1;
+        }
+        percentiles[n++] = p;
+    }
+    free(copy);
+    if (n == 0)
+        return -1;
+    nr_percentiles = n;
+    return 0;
+}
+
+/* long options without a short equivalent */
+enum {
+    OPT_IODEPTH_BATCH = 256,
+    OPT_IODEPTH_BATCH_COMPLETE,
+    OPT_IODEPTH_BATCH_COMPLETE_MAX,
+    OPT_MMAP_SYNC,
+    OPT_DIRECT,
+    OPT_SYNC,
+    OPT_FLUSH,
+    OPT_FLUSH_EVERY,
+    OPT_FLUSH_BYTES,
+    OPT_FIXEDBUFS,
+    OPT_REGISTERFILES,
+    OPT_SQPOLL,
+    OPT_SQPOLL_IDLE,
+    OPT_PERCENTILES,
+    OPT_HIST_DUMP,
+    OPT_CLOCKSOURCE,
+    OPT_SEED,
+    OPT_RANDOM_DISTRIBUTION,
+    OPT_FULL_COVERAGE,
+    OPT_SEQ_LAYOUT,
+    OPT_BSSPLIT,
+    OPT_BSRANGE,
+    OPT_BS_ALIGN,
+    OPT_RATE_IOPS,
+    OPT_RATE_BW,
+    OPT_RATE_SCOPE,
+    OPT_RATE_PROCESS,
+    OPT_TRACE,
+    OPT_TRACE_CONVERT,
+    OPT_REPORT_INTERVAL,
+    OPT_REPORT_FILE,
+    OPT_REPORT_FORMAT,
+    OPT_PRECONDITION,
+    OPT_STEADY_STATE,
+    OPT_SS_INTERVAL,
+    OPT_SS_TOLERANCE,
+    OPT_SS_MAX,
+    OPT_JOBFILE,
+    OPT_OUTPUT_FORMAT,
+    OPT_COMPARE,
+    OPT_COMPARE_THRESHOLD,
+    OPT_CPUS_ALLOWED,
+    OPT_CPUS_ALLOWED_POLICY,
+    OPT_NUMA_NODE,
+    OPT_VERIFY,
+    OPT_VERIFY_INTERVAL,
+    OPT_VERIFY_PASS,
+    OPT_COMPRESS_RATIO,
+    OPT_DEDUPE_PERCENT,
+    OPT_REPLAY,
+    OPT_REPLAY_SPEED,
+    OPT_META_MIX,
+    OPT_META_FANOUT,
+    OPT_META_DEPTH,
+    OPT_META_FILES,
+    OPT_META_FILE_SIZE,
+    OPT_META_FSYNC,
+    OPT_SWEEP_BS,
+    OPT_SWEEP_THREADS,
+    OPT_SWEEP_IODEPTH,
+    OPT_SWEEP_READ,
+    OPT_SLO_P99,
+    OPT_TARGET_MODE,
+    OPT_STRIPE_SIZE,
+    OPT_TARGET_THREADS,
+};
+
+static const struct option long_options[] = {
+    { "ioengine",               required_argument, NULL, 'e' },
+    { "iodepth",                required_argument, NULL, 'q' },
+    { "iodepth_batch",          required_argument, NULL, OPT_IODEPTH_BATCH },
+    { "iodepth_batch_complete", required_argument, NULL,
+                                                OPT_IODEPTH_BATCH_COMPLETE },
+    { "iodepth_batch_complete_max", required_argument, NULL,
+                                            OPT_IODEPTH_BATCH_COMPLETE_MAX },
+    { "mmap_sync",              required_argument, NULL, OPT_MMAP_SYNC },
+    { "direct",                 required_argument, NULL, OPT_DIRECT },
+    { "sync",                   required_argument, NULL, OPT_SYNC },
+    { "flush",                  required_argument, NULL, OPT_FLUSH },
+    { "flush_every",            required_argument, NULL, OPT_FLUSH_EVERY },
+    { "flush_bytes",            required_argument, NULL, OPT_FLUSH_BYTES },
+    { "fixedbufs",              no_argument,       NULL, OPT_FIXEDBUFS },
+    { "registerfiles",          no_argument,       NULL, OPT_REGISTERFILES },
+    { "sqpoll",                 no_argument,       NULL, OPT_SQPOLL },
+    { "sqpoll_idle",            required_argument, NULL, OPT_SQPOLL_IDLE },
+    { "percentiles",            required_argument, NULL, OPT_PERCENTILES },
+    { "hist_dump",              no_argument,       NULL, OPT_HIST_DUMP },
+    { "clocksource",            required_argument, NULL, OPT_CLOCKSOURCE },
+    { "seed",                   required_argument, NULL, OPT_SEED },
+    { "random_distribution",    required_argument, NULL,
+                                                OPT_RANDOM_DISTRIBUTION },
+    { "full_coverage",          no_argument,       NULL, OPT_FULL_COVERAGE },
+    { "seq_layout",             required_argument, NULL, OPT_SEQ_LAYOUT },
+    { "bssplit",                required_argument, NULL, OPT_BSSPLIT },
+    { "bsrange",                required_argument, NULL, OPT_BSRANGE },
+    { "bs_align",               required_argument, NULL, OPT_BS_ALIGN },
+    { "rate_iops",              required_argument, NULL, OPT_RATE_IOPS },
+    { "rate_bw",                required_argument, NULL, OPT_RATE_BW },
+    { "rate_scope",             required_argument, NULL, OPT_RATE_SCOPE },
+    { "rate_process",           required_argument, NULL, OPT_RATE_PROCESS },
+    { "trace",                  required_argument, NULL, OPT_TRACE },
+    { "trace_convert",          required_argument, NULL, OPT_TRACE_CONVERT },
+    { "report_interval",        required_argument, NULL, OPT_REPORT_INTERVAL },
+    { "report_file",            required_argument, NULL, OPT_REPORT_FILE },
+    { "report_format",          required_argument, NULL, OPT_REPORT_FORMAT },
+    { "precondition",           required_argument, NULL, OPT_PRECONDITION },
+    { "steady_state",           required_argument, NULL, OPT_STEADY_STATE },
+    { "ss_interval",            required_argument, NULL, OPT_SS_INTERVAL },
+    { "ss_tolerance",           required_argument, NULL, OPT_SS_TOLERANCE },
+    { "ss_max",                 required_argument, NULL, OPT_SS_MAX },
+    { "jobfile",                required_argument, NULL, OPT_JOBFILE },
+    { "output-format",          required_argument, NULL, OPT_OUTPUT_FORMAT },
+    { "output_format",          required_argument, NULL, OPT_OUTPUT_FORMAT },
+    { "compare",                required_argument, NULL, OPT_COMPARE },
+    { "compare_threshold",      required_argument, NULL,
+                                                OPT_COMPARE_THRESHOLD },
+    { "cpus_allowed",           required_argument, NULL, OPT_CPUS_ALLOWED },
+    { "cpus_allowed_policy",    required_argument, NULL,
+                                                OPT_CPUS_ALLOWED_POLICY },
+    { "numa_node",              required_argument, NULL, OPT_NUMA_NODE },
+    { "verify",                 no_argument,       NULL, OPT_VERIFY },
+    { "verify_interval",        required_argument, NULL, OPT_VERIFY_INTERVAL },
+    { "verify_pass",            no_argument,       NULL, OPT_VERIFY_PASS },
+    { "compress_ratio",         required_argument, NULL, OPT_COMPRESS_RATIO },
+    { "dedupe_percent",         required_argument, NULL, OPT_DEDUPE_PERCENT },
+    { "replay",                 required_argument, NULL, OPT_REPLAY },
+    { "replay_speed",           required_argument, NULL, OPT_REPLAY_SPEED },
+    { "meta_mix",               required_argument, NULL, OPT_META_MIX },
+    { "meta_fanout",            required_argument, NULL, OPT_META_FANOUT },
+    { "meta_depth",             required_argument, NULL, OPT_META_DEPTH },
+    { "meta_files",             required_argument, NULL, OPT_META_FILES },
+    { "meta_file_size",         required_argument, NULL, OPT_META_FILE_SIZE },
+    { "meta_fsync",             required_argument, NULL, OPT_META_FSYNC },
+    { "sweep_bs",               required_argument, NULL, OPT_SWEEP_BS },
+    { "sweep_threads",          required_argument, NULL, OPT_SWEEP_THREADS },
+    { "sweep_iodepth",          required_argument, NULL, OPT_SWEEP_IODEPTH },
+    { "sweep_read",             required_argument, NULL, OPT_SWEEP_READ },
+    { "slo_p99",                required_argument, NULL, OPT_SLO_P99 },
+    { "target_mode",            required_argument, NULL, OPT_TARGET_MODE },
+    { "stripe_size",            required_argument, NULL, OPT_STRIPE_SIZE },
+    { "target_threads",         required_argument, NULL, OPT_TARGET_THREADS },
+    /* long names of the short job options, for job files */
+    { "duration",               required_argument, NULL, 'd' },
+    { "filename",               required_argument, NULL, 'f' },
+    { "count",                  required_argument, NULL, 'n' },
+    { "page_size",              required_argument, NULL, 'p' },
+    { "random",                 no_argument,       NULL, 'r' },
+    { "start_addr",             required_argument, NULL, 's' },
+    { "seek_span",              required_argument, NULL, 'S' },
+    { "threads",                required_argument, NULL, 't' },
+    { "write_percent",          required_argument, NULL, 'w' },
+    { NULL, 0, NULL, 0 }
+};
+
+/*
+ * Apply an option that describes a workload to <job>. Return 0, or -1 if
+ * <opt> is not a job option. Bad values exit like any option error.
+ */
+static int set_job_option(struct job *job, int opt, const char *arg)
+{
+    switch (opt) {
+    case 'd':
+        job->duration = atoi(arg);
+        if (job->duration <= 0) {
+            printf("incorrect value %s for -d <duration>.\n", arg);
+            exit(-1);
+        }
+        job->duration_set = 1;
+        break;
+    case 'e':
+        strncpy(job->ioengine_name, arg, MAX_ENGINE_NAME_LENGTH - 1);
+        job->ioengine = find_ioengine(job->ioengine_name);
+        if (job->ioengine == NULL) {
+            printf("unknown engine %s for -e <engine>, available: ", arg);
+            list_ioengines(stdout);
+            printf(".\n");
+            exit(-12);
+        }
+        break;
+    case 'f':
+        if (strlen(arg) >= MAX_FILE_NAME_LENGTH) {
+            printf("-f %s is too long.\n", arg);
+            exit(-91);
+        }
+        strcpy(job->filename, arg);
+        /* the targets of a list are checked once the job is finalized */
+        if (!target_is_list(arg) && check_path(job->filename, 1) != 0) {
+            printf("Failed to validate/create path for %s\n", job->filename);
+            exit(-2);
+        }
+        break;
+    case 'n':
+        job->request_count = atoi(arg);
+        if (job->request_count <= 0) {
+            printf("incorrect value %s for -n <count>.\n", arg);
+            exit(-3);
+        }
+        job->request_count_set = 1;
+        break;
+    case 'p':
+        job->page_size = atoi(arg);
+        if (job->page_size < 1 ||
+            job->page_size > MAX_BLOCK_SIZE / SECTOR_SIZE) {
+            printf("incorrect value %s for -p <size>.\n", arg);
+            exit(-5);
+        }
+        job->page_size *= SECTOR_SIZE;
+        break;
+    case 'q':
+        job->iodepth = atoi(arg);
+        if (job->iodepth < 1 || job->iodepth > MAX_IODEPTH) {
+            printf("incorrect value %s for -q <depth>, "
+                   "should be [1, %d].\n", arg, MAX_IODEPTH);
+            exit(-13);
+        }
+        break;
+    case 'r':
+        job->random_addr = 1;
+        break;
+    case 's':
+        job->start_addr = atoll(arg);
+        if (job->start_addr < 0) {
+            printf("incorrect value %s for -s <addr>.\n", arg);
+            exit(-7);
+        }
+        job->start_addr = align_address(job->start_addr);
+        break;
+    case 'S':
+        /* checked once aligned, below 512 would leave an empty range */
+        job->seek_span = align_address(atoll(arg));
+        if (job->seek_span <= 0) {
+            printf("incorrect value %s for -S <addr>, should be at least "
+                   "%d.\n", arg, SECTOR_SIZE);
+            exit(-8);
+        }
+        break;
+    case 't':
+        job->thread_count = atoi(arg);
+        if (job->thread_count < 1) {
+            printf("incorrect value %s for -t <count>.\n", arg);
+            exit(-9);
+        }
+        break;
+    case 'w':
+        job->write_percent = atoi(arg);
+        if (job->write_percent > 100 || job->write_percent < 0) {
+            printf("incorrect value %s for -w <percent>, "
+                   "should be [0, 100].\n", arg);
+            exit(-10);
+        }
+        break;
+    case OPT_IODEPTH_BATCH:
+        job->iodepth_batch = atoi(arg);
+        if (job->iodepth_batch < 0) {
+            printf("incorrect value %s for --iodepth_batch.\n", arg);
+            exit(-14);
+        }
+        break;
+    case OPT_IODEPTH_BATCH_COMPLETE:
+        job->iodepth_batch_complete = atoi(arg);
+        if (job->iodepth_batch_complete < 1) {
+            printf("incorrect value %s for --iodepth_batch_complete.\n",
+                   arg);
+            exit(-15);
+        }
+        break;
+    case OPT_IODEPTH_BATCH_COMPLETE_MAX:
+        job->iodepth_batch_complete_max = atoi(arg);
+        if (job->iodepth_batch_complete_max < 0) {
+            printf("incorrect value %s for "
+                   "--iodepth_batch_complete_max.\n", arg);
+            exit(-17);
+        }
+        break;
+    case OPT_MMAP_SYNC:
+        for (job->mmap_sync = MMAP_SYNC_MAP_SYNC; job->mmap_sync >= 0;
+             job->mmap_sync--)
+            if (strcmp(arg, mmap_sync_names[job->mmap_sync]) == 0)
+                break;
+        if (job->mmap_sync < 0) {
+            printf("incorrect value %s for --mmap_sync, should be msync, "
+                   "map_sync or none.\n", arg);
+            exit(-67);
+        }
+        break;
+    case OPT_DIRECT:
+        if (strcmp(arg, "0") != 0 && strcmp(arg, "1") != 0) {
+            printf("incorrect value %s for --direct, should be 0 or 1.\n",
+                   arg);
+            exit(-71);
+        }
+        job->direct = atoi(arg);
+        break;
+    case OPT_SYNC:
+        for (job->sync_mode = SYNC_OSYNC; job->sync_mode >= 0;
+             job->sync_mode--)
+            if (strcmp(arg, sync_mode_names[job->sync_mode]) == 0)
+                break;
+        if (job->sync_mode < 0) {
+            printf("incorrect value %s for --sync, should be osync, odsync "
+                   "or none.\n", arg);
+            exit(-72);
+        }
+        break;
+    case OPT_FLUSH:
+        for (job->flush = FLUSH_SYNC_FILE_RANGE; job->flush > FLUSH_NONE;
+             job->flush--)
+            if (strcmp(arg, flush_names[job->flush]) == 0)
+                break;
+        if (job->flush == FLUSH_NONE) {
+            printf("incorrect value %s for --flush, should be fsync, "
+                   "fdatasync or sync_file_range.\n", arg);
+            exit(-73);
+        }
+#ifndef __linux__
+        if (job->flush == FLUSH_SYNC_FILE_RANGE) {
+            printf("--flush sync_file_range is only available on Linux.\n");
+            exit(-73);
+        }
+#endif
+        break;
+    case OPT_FLUSH_EVERY:
+        job->flush_every = atoi(arg);
+        if (job->flush_every < 1) {
+            printf("incorrect value %s for --flush_every.\n", arg);
+            exit(-74);
+        }
+        break;
+    case OPT_FLUSH_BYTES:
+        job->flush_bytes = parse_size(arg);
+        if (job->flush_bytes < 1) {
+            printf("incorrect value %s for --flush_bytes.\n", arg);
+            exit(-75);
+        }
+        break;
+    case OPT_RANDOM_DISTRIBUTION:
+        if (dist_parse(&job->offset_dist, arg) != 0) {
+            printf("incorrect value %s for --random_distribution.\n", arg);
+            exit(-22);
+        }
+        break;
+    case OPT_FULL_COVERAGE:
+        job->full_coverage = 1;
+        job->random_addr = 1;
+        break;
+    case OPT_SEQ_LAYOUT:
+        for (job->seq_layout = SEQ_LAYOUT_STRIDE; job->seq_layout >= 0;
+             job->seq_layout--)
+            if (strcmp(arg, seq_layout_names[job->seq_layout]) == 0)
+                break;
+        if (job->seq_layout < 0) {
+            printf("incorrect value %s for --seq_layout, should be "
+                   "shared, split or stride.\n", arg);
+            exit(-26);
+        }
+        break;
+    case OPT_BSSPLIT:
+        if (bs_parse_split(&job->bs_spec, arg) != 0) {
+            printf("incorrect value %s for --bssplit, should be like "
+                   "4k:70,64k:20,1m:10 with percents adding up to 100.\n",
+                   arg);
+            exit(-28);
+        }
+        break;
+    case OPT_BSRANGE:
+        if (bs_parse_range(&job->bs_spec, arg) != 0) {
+            printf("incorrect value %s for --bsrange, should be like "
+                   "4k-128k.\n", arg);
+            exit(-29);
+        }
+        break;
+    case OPT_BS_ALIGN: {
+        long long align = parse_size(arg);
+        if (align < SECTOR_SIZE || align % SECTOR_SIZE != 0 ||
+            align > MAX_BLOCK_SIZE) {
+            printf("incorrect value %s for --bs_align.\n", arg);
+            exit(-30);
+        }
+        job->bs_align = (int)align;
+        break;
+    }
+    case OPT_RATE_IOPS:
+        job->rate_iops = atoll(arg);
+        if (job->rate_iops <= 0) {
+            printf("incorrect value %s for --rate_iops.\n", arg);
+            exit(-32);
+        }
+        break;
+    case OPT_RATE_BW:
+        job->rate_bw = parse_size(arg);
+        if (job->rate_bw <= 0) {
+            printf("incorrect value %s for --rate_bw.\n", arg);
+            exit(-33);
+        }
+        break;
+    case OPT_RATE_SCOPE:
+        if (strcmp(arg, "thread") == 0) {
+            job->rate_global = 0;
+        } else if (strcmp(arg, "global") == 0) {
+            job->rate_global = 1;
+        } else {
+            printf("incorrect value %s for --rate_scope, should be "
+                   "thread or global.\n", arg);
+            exit(-34);
+        }
+        break;
+    case OPT_RATE_PROCESS:
+        if (strcmp(arg, "constant") == 0) {
+            job->rate_process = RATE_CONSTANT;
+        } else if (strcmp(arg, "poisson") == 0) {
+            job->rate_process = RATE_POISSON;
+        } else {
+            printf("incorrect value %s for --rate_process, should be "
+                   "constant or poisson.\n", arg);
+            exit(-35);
+        }
+        break;
+    case OPT_CPUS_ALLOWED:
+        if (cpu_list_parse(&job->cpus_allowed, arg) != 0) {
+            printf("incorrect value %s for --cpus_allowed, should be a CPU "
+                   "list like 0-3,8 of CPUs below %d.\n", arg, MAX_CPUS);
+            exit(-58);
+        }
+        strncpy(job->cpus_allowed_spec, arg, MAX_CPU_LIST_LENGTH - 1);
+        break;
+    case OPT_CPUS_ALLOWED_POLICY:
+        if (strcmp(arg, "shared") == 0) {
+            job->cpus_split = 0;
+        } else if (strcmp(arg, "split") == 0) {
+            job->cpus_split = 1;
+        } else {
+            printf("incorrect value %s for --cpus_allowed_policy, should be "
+                   "shared or split.\n", arg);
+            exit(-59);
+        }
+        break;
+    case OPT_NUMA_NODE: {
+        char *end;
+        if (strcmp(arg, "local") == 0) {
+            job->numa_node = NUMA_NODE_LOCAL;
+            break;
+        }
+        job->numa_node = (int)strtol(arg, &end, 10);
+        if (end == arg || *end != '\0' || job->numa_node < 0) {
+            printf("incorrect value %s for --numa_node, should be a node "
+                   "number or local.\n", arg);
+            exit(-60);
+        }
+        break;
+    }
+    case OPT_VERIFY:
+        job->verify = 1;
+        break;
+    case OPT_VERIFY_INTERVAL: {
+        long long size = parse_size(arg);
+        if (size < SECTOR_SIZE || size % SECTOR_SIZE != 0 ||
+            size > MAX_BLOCK_SIZE) {
+            printf("incorrect value %s for --verify_interval.\n", arg);
+            exit(-62);
+        }
+        job->verify_interval = (int)size;
+        break;
+    }
+    case OPT_VERIFY_PASS:
+        job->verify = 1;
+        job->verify_pass = 1;
+        break;
+    case OPT_COMPRESS_RATIO: {
+        char *end;
+        job->compress_ratio = strtod(arg, &end);
+        if (end == arg || *end != '\0' || job->compress_ratio < 1 ||
+            job->compress_ratio > PAYLOAD_MAX_RATIO) {
+            printf("incorrect value %s for --compress_ratio, should be "
+                   "between 1 and %g.\n", arg, PAYLOAD_MAX_RATIO);
+            exit(-64);
+        }
+        break;
+    }
+    case OPT_DEDUPE_PERCENT: {
+        char *end;
+        job->dedupe_percent = (int)strtol(arg, &end, 10);
+        if (end == arg || *end != '\0' || job->dedupe_percent < 0 ||
+            job->dedupe_percent > 100) {
+            printf("incorrect value %s for --dedupe_percent.\n", arg);
+            exit(-65);
+        }
+        break;
+    }
+    case OPT_REPLAY:
+        strncpy(job->replay_filename, arg, MAX_FILE_NAME_LENGTH - 1);
+        break;
+    case OPT_REPLAY_SPEED: {
+        char *end;
+        job->replay_speed = strtod(arg, &end);
+        if (end == arg || *end != '\0' || job->replay_speed < 0) {
+            printf("incorrect value %s for --replay_speed.\n", arg);
+            exit(-68);
+        }
+        break;
+    }
+    case OPT_META_MIX:
+        if (meta_parse_mix(job->meta_mix, arg) != 0) {
+            printf("incorrect value %s for --meta_mix, should be op:percent,"
+                   "... of create, read, stat, rename and unlink adding up "
+                   "to 100.\n", arg);
+            exit(-76);
+        }
+        strncpy(job->meta_mix_spec, arg, MAX_FILE_NAME_LENGTH - 1);
+        job->meta = 1;
+        break;
+    case OPT_META_FANOUT:
+        job->meta_fanout = atoi(arg);
+        if (job->meta_fanout < 1) {
+            printf("incorrect value %s for --meta_fanout.\n", arg);
+            exit(-77);
+        }
+        break;
+    case OPT_META_DEPTH:
+        job->meta_depth = atoi(arg);
+        if (job->meta_depth < 0 || job->meta_depth > 16) {
+            printf("incorrect value %s for --meta_depth, should be 0 to "
+                   "16.\n", arg);
+            exit(-78);
+        }
+        break;
+    case OPT_META_FILES:
+        job->meta_files = atoi(arg);
+        if (job->meta_files < 1 || job->meta_files > META_MAX_FILES) {
+            printf("incorrect value %s for --meta_files.\n", arg);
+            exit(-79);
+        }
+        break;
+    case OPT_META_FILE_SIZE: {
+        long long size = parse_size(arg);
+        if (size < 0 || size > INT_MAX) {
+            printf("incorrect value %s for --meta_file_size.\n", arg);
+            exit(-80);
+        }
+        job->meta_file_size = (int)size;
+        break;
+    }
+    case OPT_META_FSYNC:
+        if (strcmp(arg, "0") != 0 && strcmp(arg, "1") != 0) {
+            printf("incorrect value %s for --meta_fsync, should be 0 or "
+                   "1.\n", arg);
+            exit(-81);
+        }
+        job->meta_fsync = atoi(arg);
+        break;
+    case OPT_TARGET_MODE:
+        if (strcmp(arg, "thread") == 0) {
+            job->target_mode = TARGET_MODE_THREAD;
+        } else if (strcmp(arg, "stripe") == 0) {
+            job->target_mode = TARGET_MODE_STRIPE;
+        } else {
+            printf("incorrect value %s for --target_mode, should be thread "
+                   "or stripe.\n", arg);
+            exit(-92);
+        }
+        break;
+    case OPT_STRIPE_SIZE:
+        job->stripe_size = parse_size(arg);
+        if (job->stripe_size < SECTOR_SIZE ||
+            job->stripe_size % SECTOR_SIZE != 0) {
+            printf("incorrect value %s for --stripe_size, should be a "
+                   "multiple of 512.\n", arg);
+            exit(-93);
+        }
+        break;
+    case OPT_TARGET_THREADS:
+        job->target_threads = atoi(arg);
+        if (job->target_threads < 1) {
+            printf("incorrect value %s for --target_threads.\n", arg);
+            exit(-94);
+        }
+        break;
+    default:
+        return -1;
+    }
+    return 0;
+}
+
+/* turn a job switch off again, return -1 if <opt> is not one */
+static int clear_job_switch(struct job *job, int opt)
+{
+    switch (opt) {
+    case 'r':
+        job->random_addr = 0;
+        job->full_coverage = 0;
+        break;
+    case OPT_FULL_COVERAGE:
+        job->full_coverage = 0;
+        break;
+    case OPT_VERIFY:
+        job->verify = 0;
+        job->verify_pass = 0;
+        break;
+    case OPT_VERIFY_PASS:
+        job->verify_pass = 0;
+        break;
+    default:
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Apply a job file line, <name> is a long option name and <value> its
+ * argument or NULL. A switch takes no value, or 0 or 1 so that a job can
+ * turn off what [global] turned on. Return 0, -1 if <name> is not a job
+ * option, -2 if the value is missing or not expected.
+ */
+int set_job_option_by_name(struct job *job, const char *name,
+                           const char *value)
+{
+    const struct option *o;
+
+    for (o = long_options; o->name != NULL; o++) {
+        if (strcmp(o->name, name) != 0)
+            continue;
+        if (o->has_arg == no_argument && value != NULL) {
+            if (strcmp(value, "1") == 0)
+                return set_job_option(job, o->val, NULL);
+            if (strcmp(value, "0") == 0)
+                return clear_job_switch(job, o->val);
+            return -2;
+        }
+        if (o->has_arg == required_argument && value == NULL)
+            return -2;
+        return set_job_option(job, o->val, value);
+    }
+    return -1;
+}
+
+/*
+ * Check a job and derive what its threads need once all of its options
+ * are known.
+ */
+static void finalize_job(struct job *job)
+{
+    /* disable another stop timer if only one timer specified */
+    if (job->duration_set && !job->request_count_set)
+        job->request_count = INT_MAX;
+    if (!job->duration_set && job->request_count_set)
+        job->duration = INT_MAX;
+    if (job->replay_filename[0] != '\0' && !job->duration_set &&
+        !job->request_count_set) {
+        job->request_count = INT_MAX;
+        job->duration = INT_MAX;
+    }
+
+    if (job->ioengine == NULL)
+        job->ioengine = find_ioengine(job->ioengine_name);
+
+    /* with mixed sizes buffers are sized for, and blocks are, the largest */
+    if (bs_finalize(&job->bs_spec, job->page_size, job->bs_align) != 0) {
+        printf("--bs_align %d does not fit block sizes %s.\n", job->bs_align,
+               job->bs_spec.spec);
+        exit(-31);
+    }
+    job->page_size = job->bs_spec.max_bs;
+
+    /* a -f list: requests are generated on one logical range, then mapped
+     * onto the targets */
+    if (target_is_list(job->filename)) {
+        if (job->verify > 0 || job->replay_filename[0] != '\0' ||
+            job->meta > 0 || job->ioengine->mapped ||
+            precondition_passes >= 0) {
+            printf("several targets cannot be combined with --verify, "
+                   "--replay, --meta_mix, -e mmap or --precondition.\n");
+            exit(-95);
+        }
+        if (job->target_mode == TARGET_MODE_STRIPE &&
+            (job->stripe_size < job->page_size ||
+             job->stripe_size % job->bs_spec.align != 0)) {
+            printf("--stripe_size %lld should be a multiple of --bs_align "
+                   "and at least the largest block size %d.\n",
+                   job->stripe_size, job->page_size);
+            exit(-96);
+        }
+        if (target_setup_job(job) != 0)
+            exit(-91);
+    }
+
+    /* a skewed distribution implies random IO, on page_size blocks of
+     * [start_addr, seek_span) */
+    if (job->offset_dist.type != DIST_UNIFORM) {
+        job->random_addr = 1;
+        if (job->seek_span <= job->start_addr ||
+            dist_init(&job->offset_dist, (uint64_t)(job->seek_span -
+                      job->start_addr) / job->page_size) != 0) {
+            printf("address range [%lld, %lld) is too small for "
+                   "--random_distribution %s.\n",
+                   (long long int)job->start_addr,
+                   (long long int)job->seek_span, job->offset_dist.spec);
+            exit(-23);
+        }
+    }
+
+    if (job->full_coverage > 0) {
+        if (job->offset_dist.type != DIST_UNIFORM) {
+            printf("--full_coverage cannot be combined with "
+                   "--random_distribution %s.\n", job->offset_dist.spec);
+            exit(-24);
+        }
+        uint64_t nblocks = job->seek_span > job->start_addr ?
+                           (uint64_t)(job->seek_span - job->start_addr) /
+                           job->page_size : 0;
+        if (nblocks < (uint64_t)job->thread_count) {
+            printf("address range [%lld, %lld) has fewer page size blocks "
+                   "than threads for --full_coverage.\n",
+                   (long long int)job->start_addr,
+                   (long long int)job->seek_span);
+            exit(-25);
+        }
+        perm_init(&job->block_perm, nblocks);
+    }
+
+    if (job->seq_layout != SEQ_LAYOUT_SHARED &&
+        (job->seek_span <= job->start_addr ||
+         (job->seek_span - job->start_addr) / job->page_size <
+         job->thread_count)) {
+        printf("address range [%lld, %lld) has fewer page size blocks "
+               "than threads for --seq_layout %s.\n",
+               (long long int)job->start_addr, (long long int)job->seek_span,
+               seq_layout_names[job->seq_layout]);
+        exit(-27);
+    }
+
+    if (precondition_passes >= 0 &&
+        job->seek_span - job->start_addr < job->page_size) {
+        printf("address range [%lld, %lld) is too small to precondition.\n",
+               (long long int)job->start_addr, (long long int)job->seek_span);
+        exit(-46);
+    }
+    if (job->rate_iops > 0 && job->rate_bw > 0) {
+        printf("use either --rate_iops or --rate_bw, not both.\n");
+        exit(-36);
+    }
+    /* per thread spacing, a global rate is shared evenly by the threads */
+    if (job->rate_iops > 0)
+        job->rate_ns_per_io = (double)NSEC_PER_SEC / job->rate_iops *
+                              (job->rate_global > 0 ? job->thread_count : 1);
+    if (job->rate_bw > 0)
+        job->rate_ns_per_byte = (double)NSEC_PER_SEC / job->rate_bw *
+                                (job->rate_global > 0 ? job->thread_count : 1);
+
+    /* threads run on the CPUs of the memory node unless told otherwise */
+    if (job->numa_node == NUMA_NODE_LOCAL) {
+        const char *path = job->nr_targets > 0 ? job->targets[0].name
+                                               : job->filename;
+        job->numa_node = numa_node_of_path(path);
+        if (job->numa_node < 0)
+            fprintf(stderr, "warning: the NUMA node of %s is unknown, "
+                    "--numa_node local is ignored.\n", path);
+    }
+    if (job->numa_node >= 0 && job->cpus_allowed.nr == 0) {
+        if (numa_node_cpus(job->numa_node, &job->cpus_allowed) != 0) {
+            printf("NUMA node %d has no CPUs for --numa_node.\n",
+                   job->numa_node);
+            exit(-61);
+        }
+        cpu_list_format(&job->cpus_allowed, job->cpus_allowed_spec,
+                        MAX_CPU_LIST_LENGTH);
+    }
+
+    /* every request and random offset must cover whole verify units */
+    if (job->verify > 0) {
+        const struct bs_spec *bs = &job->bs_spec;
+        int c, fits;
+        if (job->verify_interval == 0)
+            job->verify_interval = bs->align;
+        fits = bs->align % job->verify_interval == 0 &&
+               job->start_addr % job->verify_interval == 0 &&
+               bs->min_bs % job->verify_interval == 0;
+        for (c = 0; c < bs->nr_classes && bs->mode == BS_SPLIT; c++)
+            if (bs->class_size[c] % job->verify_interval != 0)
+                fits = 0;
+        if (!fits) {
+            printf("--verify_interval %d does not divide the block sizes, "
+                   "--bs_align and -s.\n", job->verify_interval);
+            exit(-63);
+        }
+    }
+
+    if (job->replay_filename[0] != '\0' &&
+        (job->verify > 0 || job->seek_span - job->start_addr <
+                            job->page_size)) {
+        printf("--replay needs an address range of at least -p and cannot "
+               "be combined with --verify.\n");
+        exit(-70);
+    }
+
+    /* a flush call without a cadence flushes after every write */
+    if (job->flush == FLUSH_NONE && (job->flush_every > 0 ||
+                                     job->flush_bytes > 0))
+        job->flush = FLUSH_FDATASYNC;
+    if (job->flush != FLUSH_NONE && job->flush_every == 0 &&
+        job->flush_bytes == 0)
+        job->flush_every = 1;
+
+    if (job->meta > 0 && (job->verify > 0 ||
+                          job->replay_filename[0] != '\0')) {
+        printf("--meta_mix cannot be combined with --verify or --replay.\n");
+        exit(-82);
+    }
+    /* the metadata loop has its own IO, without engine, queue or schedule */
+    if (job->meta > 0 && (ss_window > 0 || job->rate_iops > 0 ||
+                          job->rate_bw > 0 || job->flush != FLUSH_NONE ||
+                          job->ioengine != &ioengine_psync ||
+                          job->iodepth > 1 || fixed_bufs > 0 ||
+                          register_files > 0 || sqpoll > 0)) {
+        printf("--meta_mix cannot be combined with --steady_state, "
+               "--rate_iops, --rate_bw, --flush, -e other than psync, -q, "
+               "--fixedbufs, --registerfiles or --sqpoll.\n");
+        exit(-97);
+    }
+    if (job->meta > 0 && meta_leaf_dirs(job) == 0) {
+        printf("--meta_fanout %d and --meta_depth %d make more than %d leaf "
+               "directories.\n", job->meta_fanout, job->meta_depth,
+               META_MAX_DIRS);
+        exit(-83);
+    }
+
+    if (job->dedupe_percent > 0 && job->compress_ratio == 0)
+        job->compress_ratio = 1;
+    if (job->compress_ratio > 0 && job->verify > 0) {
+        printf("--verify writes its own data, it cannot be combined with "
+               "--compress_ratio or --dedupe_percent.\n");
+        exit(-66);
+    }
+
+    /* a synchronous engine can only have one request in flight */
+    if (job->ioengine->sync)
+        job->iodepth = 1;
+    if (job->iodepth_batch == 0 || job->iodepth_batch > job->iodepth)
+        job->iodepth_batch = job->iodepth;
+    if (job->iodepth_batch_complete_max == 0 ||
+        job->iodepth_batch_complete_max > job->iodepth)
+        job->iodepth_batch_complete_max = job->iodepth;
+    if (job->iodepth_batch_complete > job->iodepth_batch_complete_max)
+        job->iodepth_batch_complete = job->iodepth_batch_complete_max;
+}
+
 void get_options(int argc, char **argv)
 {
-    int duration_enabled = 0;
-    int req_count_enabled = 0;
-    int opt;
-    while ((opt = getopt(argc, argv, "d:f:hHn:o:Pp:rR:s:S:t:w:")) != -1) {
+    int opt, i;
+    while ((opt = getopt_long(argc, argv, "d:e:f:hHn:o:Pp:q:rR:s:S:t:w:",
+                              long_options, NULL)) != -1) {
+        if (set_job_option(&cmdline_job, opt, optarg) == 0)
+            continue;
         switch (opt) {
-        case 'd':
-            duration = atoi(optarg);
-            if (duration <= 0) {
-                printf("incorrect value %s for -d <duration>.\n", optarg);
-                exit(-1);
-            }
-            duration_enabled = 1;
-            break;
-        case 'f':
-            strncpy(filename, optarg, MAX_FILE_NAME_LENGTH - 1);
-            if (check_path(filename, 1) != 0) {
-                printf("Failed to validate/create path for %s\n", filename);
-                exit(-2);
-            }
-            break;
-        case 'n':
-            request_count = atoi(optarg);
-            if (request_count <= 0) {
-                printf("incorrect value %s for -n <count>.\n", optarg);
-                exit(-3);
-            }
-            req_count_enabled = 1;
-            break;
         case 'h':
             usage();
             exit(0);
@@ -292,20 +1598,9 @@ void get_options(int argc, char **argv)
                 exit(errno);
             }
             break;
-        case 'p':
-            page_size= atoi(optarg);
-            if (page_size < 1 ||  page_size > 2048) {
-                printf("incorrect value %s for -p <size>.\n", optarg);
-                exit(-5);
-            }
-            page_size *= SECTOR_SIZE;
-            break;
         case 'P':
             print_detail = 1;
             break;
-        case 'r':
-            random_addr = 1;
-            break;
         case 'R':
             rampup_interval = atoi(optarg);
             if (rampup_interval < 1) {
@@ -313,107 +1608,358 @@ void get_options(int argc, char **argv)
                 exit(-6);
             }
             break;
-        case 's':
-            start_addr = atoll(optarg);
-            if (start_addr < 0) {
-                printf("incorrect value %s for -s <addr>.\n", optarg);
-                exit(-7);
+        case OPT_FIXEDBUFS:
+            fixed_bufs = 1;
+            break;
+        case OPT_REGISTERFILES:
+            register_files = 1;
+            break;
+        case OPT_SQPOLL:
+            sqpoll = 1;
+            break;
+        case OPT_SQPOLL_IDLE:
+            sqpoll_idle = atoi(optarg);
+            if (sqpoll_idle < 0) {
+                printf("incorrect value %s for --sqpoll_idle.\n", optarg);
+                exit(-16);
+            }
+            break;
+        case OPT_PERCENTILES:
+            if (parse_percentiles(optarg) != 0) {
+                printf("incorrect value %s for --percentiles, should be a "
+                       "comma separated list of (0, 100].\n", optarg);
+                exit(-18);
             }
-            align_address(start_addr);
             break;
-        case 'S':
-            seek_span = atoll(optarg);
-            if (seek_span <= 0) {
-                printf("incorrect value %s for -S <addr>.\n", optarg);
-                exit(-8);
+        case OPT_HIST_DUMP:
+            hist_dump_enabled = 1;
+            break;
+        case OPT_CLOCKSOURCE:
+            if (parse_clocksource(optarg) != 0) {
+                printf("incorrect value %s for --clocksource, should be "
+                       "clock_gettime or tsc.\n", optarg);
+                exit(-20);
             }
-            align_address(seek_span);
             break;
-        case 't':
-            thread_count = atoi(optarg);
-            if (thread_count < 1) {
-                printf("incorrect value %s for -t <count>.\n", optarg);
-                exit(-9);
+        case OPT_SEED: {
+            char *end;
+            errno = 0;
+            rand_seed = strtoull(optarg, &end, 0);
+            if (errno != 0 || *end != '\0' || optarg[0] == '-') {
+                printf("incorrect value %s for --seed.\n", optarg);
+                exit(-21);
             }
+            rand_seed_set = 1;
             break;
-        case 'w':
-            write_percent = atoi(optarg);
-            if (write_percent > 100 || write_percent < 0) {
-                printf("incorrect value %s for -w <percent>, "
-                       "should be [0, 100].\n", optarg);
-                exit(-10);
+        }
+        case OPT_TRACE:
+            strncpy(trace_filename, optarg, MAX_FILE_NAME_LENGTH - 1);
+            break;
+        case OPT_TRACE_CONVERT:
+            strncpy(trace_convert_filename, optarg, MAX_FILE_NAME_LENGTH - 1);
+            break;
+        case OPT_REPORT_INTERVAL:
+            report_interval = atoi(optarg);
+            if (report_interval <= 0) {
+                printf("incorrect value %s for --report_interval.\n", optarg);
+                exit(-38);
             }
             break;
-        case ':':
-            printf("%s takes an argument which is missing.\n", optarg);
+        case OPT_REPORT_FILE:
+            strncpy(report_filename, optarg, MAX_FILE_NAME_LENGTH - 1);
             break;
-        case '?':
-            usage();
-            exit(0);
+        case OPT_REPORT_FORMAT:
+            if (strcmp(optarg, "csv") == 0) {
+                report_format = REPORT_CSV;
+            } else if (strcmp(optarg, "json") == 0) {
+                report_format = REPORT_JSON;
+            } else {
+                printf("incorrect value %s for --report_format, should be "
+                       "csv or json.\n", optarg);
+                exit(-39);
+            }
+            break;
+        case OPT_PRECONDITION:
+            precondition_passes = atoi(optarg);
+            if (precondition_passes < 0) {
+                printf("incorrect value %s for --precondition.\n", optarg);
+                exit(-41);
+            }
+            break;
+        case OPT_STEADY_STATE:
+            ss_window = atoi(optarg);
+            if (ss_window < 2) {
+                printf("incorrect value %s for --steady_state, the window "
+                       "needs at least 2 samples.\n", optarg);
+                exit(-42);
+            }
+            break;
+        case OPT_SS_INTERVAL:
+            ss_interval = atoi(optarg);
+            if (ss_interval <= 0) {
+                printf("incorrect value %s for --ss_interval.\n", optarg);
+                exit(-43);
+            }
+            break;
+        case OPT_SS_TOLERANCE:
+            ss_tolerance = atoi(optarg);
+            if (ss_tolerance <= 0 || ss_tolerance > 100) {
+                printf("incorrect value %s for --ss_tolerance.\n", optarg);
+                exit(-44);
+            }
+            break;
+        case OPT_SS_MAX:
+            ss_max = atoi(optarg);
+            if (ss_max <= 0) {
+                printf("incorrect value %s for --ss_max.\n", optarg);
+                exit(-45);
+            }
+            break;
+        case OPT_JOBFILE:
+            strncpy(job_filename, optarg, MAX_FILE_NAME_LENGTH - 1);
+            break;
+        case OPT_OUTPUT_FORMAT:
+            if (strcmp(optarg, "text") == 0) {
+                output_format = OUTPUT_TEXT;
+            } else if (strcmp(optarg, "json") == 0) {
+                output_format = OUTPUT_JSON;
+            } else {
+                printf("incorrect value %s for --output-format, should be "
+                       "text or json.\n", optarg);
+                exit(-54);
+            }
+            break;
+        case OPT_COMPARE:
+            strncpy(compare_filename, optarg, MAX_FILE_NAME_LENGTH - 1);
+            break;
+        case OPT_COMPARE_THRESHOLD: {
+            char *end;
+            compare_threshold = strtod(optarg, &end);
+            if (*end != '\0' || compare_threshold < 0) {
+                printf("incorrect value %s for --compare_threshold.\n",
+                       optarg);
+                exit(-55);
+            }
             break;
         }
-    }
-    if (optind < argc) {
-        printf("There are invalid options.\n");
+        case OPT_SWEEP_BS: {
+            int k, bad = sweep_parse_axis(&sweep_spec.bs, optarg, 1);
+            for (k = 0; k < sweep_spec.bs.nr; k++)
+                if (sweep_spec.bs.v[k] < SECTOR_SIZE ||
+                    sweep_spec.bs.v[k] % SECTOR_SIZE != 0 ||
+                    sweep_spec.bs.v[k] > MAX_BLOCK_SIZE)
+                    bad = 1;
+            if (bad) {
+                printf("incorrect value %s for --sweep_bs, should be a "
+                       "comma separated list of multiples of 512 up to "
+                       "64m.\n", optarg);
+                exit(-85);
+            }
+            break;
+        }
+        case OPT_SWEEP_THREADS: {
+            int k, bad = sweep_parse_axis(&sweep_spec.threads, optarg, 0);
+            for (k = 0; k < sweep_spec.threads.nr; k++)
+                if (sweep_spec.threads.v[k] < 1)
+                    bad = 1;
+            if (bad) {
+                printf("incorrect value %s for --sweep_threads.\n", optarg);
+                exit(-86);
+            }
+            break;
+        }
+        case OPT_SWEEP_IODEPTH: {
+            int k, bad = sweep_parse_axis(&sweep_spec.iodepth, optarg, 0);
+            for (k = 0; k < sweep_spec.iodepth.nr; k++)
+                if (sweep_spec.iodepth.v[k] < 1 ||
+                    sweep_spec.iodepth.v[k] > MAX_IODEPTH)
+                    bad = 1;
+            if (bad) {
+                printf("incorrect value %s for --sweep_iodepth.\n", optarg);
+                exit(-87);
+            }
+            break;
+        }
+        case OPT_SWEEP_READ: {
+            int k, bad = sweep_parse_axis(&sweep_spec.read, optarg, 0);
+            for (k = 0; k < sweep_spec.read.nr; k++)
+                if (sweep_spec.read.v[k] > 100)
+                    bad = 1;
+            if (bad) {
+                printf("incorrect value %s for --sweep_read, should be "
+                       "percents of 0-100.\n", optarg);
+                exit(-88);
+            }
+            break;
+        }
+        case OPT_SLO_P99: {
+            char *end;
+            sweep_spec.slo_p99_us = strtod(optarg, &end);
+            if (end == optarg || *end != '\0' || sweep_spec.slo_p99_us <= 0) {
+                printf("incorrect value %s for --slo_p99.\n", optarg);
+                exit(-89);
+            }
+            break;
+        }
+        case ':':
+            printf("%s takes an argument which is missing.\n", optarg);
+            break;
+        case '?':
+            usage();
+            exit(0);
+            break;
+        }
+    }
+    if (optind < argc) {
+        printf("There are invalid options.\n");
         usage();
         exit(-11);
     }
     
-    /* disable another stop timer if only one timer specified */
-    if (duration_enabled && !req_count_enabled)
-        request_count = INT_MAX;
-    if (!duration_enabled && req_count_enabled)
-        duration = INT_MAX;
+    /* the command line job, or the job file's jobs on top of it */
+    jobs = calloc(MAX_JOBS, sizeof(struct job));
+    if (jobs == NULL) {
+        perror("get_options:calloc()");
+        exit(errno);
+    }
+    if (job_filename[0] != '\0') {
+        nr_jobs = parse_job_file(job_filename, &cmdline_job, jobs, MAX_JOBS);
+    } else {
+        jobs[0] = cmdline_job;
+        nr_jobs = 1;
+    }
+    for (i = 0; i < nr_jobs; i++) {
+        jobs[i].index = i;
+        finalize_job(&jobs[i]);
+    }
+    for (i = 0; i < nr_jobs; i++)
+        if (strcmp(jobs[i].ioengine->name, "libaio") == 0 &&
+            jobs[i].direct == 0)
+            fprintf(stderr, "warning: -e libaio with --direct 0 of job %s "
+                    "submits buffered IO synchronously, -q has no "
+                    "effect.\n", jobs[i].name);
+    for (i = 0; i < nr_jobs; i++)
+        if (jobs[i].verify > 0 && verify_setup_job(&jobs[i]) != 0)
+            fprintf(stderr, "warning: no memory for the --verify table of "
+                    "job %s, stale data is not detected.\n", jobs[i].name);
+
+    for (i = 0; i < nr_jobs; i++) {
+        if (jobs[i].replay_filename[0] == '\0')
+            continue;
+        jobs[i].replay = replay_open(&jobs[i]);
+        if (jobs[i].replay == NULL) {
+            printf("cannot read trace %s for --replay.\n",
+                   jobs[i].replay_filename);
+            exit(-69);
+        }
+    }
+
+    for (i = 0; i < nr_jobs; i++) {
+        if (jobs[i].meta > 0 && meta_setup_job(&jobs[i]) != 0) {
+            printf("cannot create the directory tree under %s for "
+                   "--meta_mix.\n", jobs[i].filename);
+            exit(-84);
+        }
+    }
+
+    if (compare_filename[0] != '\0' && access(compare_filename, R_OK) != 0) {
+        printf("cannot read baseline %s for --compare.\n", compare_filename);
+        exit(-56);
+    }
+    if (report_filename[0] != '\0' && report_interval == 0) {
+        printf("--report_file needs --report_interval.\n");
+        exit(-40);
+    }
+    /* the detector runs once, a later group would start out measured */
+    for (i = 1; i < nr_jobs && ss_window > 0; i++) {
+        if (jobs[i].stonewall) {
+            printf("--steady_state cannot be combined with stonewall, job "
+                   "%s starts a second group.\n", jobs[i].name);
+            exit(-98);
+        }
+    }
+    if (sweep_enabled(&sweep_spec) &&
+        (job_filename[0] != '\0' || ss_window > 0 ||
+         output_format != OUTPUT_TEXT || compare_filename[0] != '\0' ||
+         report_filename[0] != '\0' || print_detail > 0 ||
+         trace_filename[0] != '\0' || jobs[0].verify > 0 ||
+         jobs[0].replay != NULL || jobs[0].meta > 0 ||
+         jobs[0].nr_targets > 0 ||
+         (sweep_spec.bs.nr > 0 && jobs[0].bs_spec.mode != BS_FIXED) ||
+         (sweep_spec.slo_p99_us > 0 && (jobs[0].rate_iops > 0 ||
+                                        jobs[0].rate_bw > 0)))) {
+        printf("a sweep runs the command line job with text output; it "
+               "cannot be combined with --jobfile, --steady_state, "
+               "--output-format json, --compare, --report_file, -P, "
+               "--trace, --verify, --replay, --meta_mix or a -f list, "
+               "--sweep_bs not "
+               "with --bssplit or --bsrange and --slo_p99 not with a "
+               "rate.\n");
+        exit(-90);
+    }
+
+    /* pick a seed for this run, it is printed so the run can be repeated */
+    if (!rand_seed_set) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        uint64_t x = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+        rand_seed = splitmix64(&x);
+    }
 }
 
-inline off_t reposition_offset(int fd, long req_count)
+static inline off_t reposition_offset(struct thread_data *td, int size)
 {    
+    struct job *job = td->job;
     off_t offset = 0;
     off_t cursor = 0;
     
-    if (random_addr > 0) {
+    if (job->full_coverage > 0) {
+        
+        /* next block of this thread's slice, new order on every pass */
+        if (td->perm_pos == td->perm_end) {
+            td->perm_pos = td->perm_begin;
+            td->perm_pass++;
+            perm_keys(td->perm_keys, rand_seed + job->index, td->perm_pass);
+        }
+        return job->start_addr +
+               (off_t)perm_index(&job->block_perm, td->perm_keys,
+                                 td->perm_pos++) * job->page_size;
+    } else if (job->random_addr > 0) {
         
         /* get random address */
-        struct timeval tv_rand;
-        if (gettimeofday(&tv_rand, NULL) < 0) {
-            perror("reposition_offset:gettimeofday()");
-            exit(errno);
+        if (job->offset_dist.type != DIST_UNIFORM) {
+            return job->start_addr + (off_t)dist_next(&job->offset_dist,
+                                                      &td->rand) *
+                   job->page_size;
         }
-        srand((unsigned int)(tv_rand.tv_usec * tv_rand.tv_sec * seek_span));
-        cursor = (double)rand() / RAND_MAX * seek_span;
-        cursor = align_address(cursor);
+        off_t span = job->seek_span - job->start_addr;
+        cursor = span > 0 ? rand_below(&td->rand, span) : 0;
         
-        /* reposition the offset of open file.
-         * For hard disk, lseek dosen't move the disk arm to specified address,
-         * the overhead of lseek is usually very small, should be less than 2us.
-         * the overhead of disk arm moving is included in read/write function.
+        /* the offset is handed to the engine with the request (pread/pwrite
+         * or the async equivalent), the file offset of fd is not used.
+         * For hard disk the disk arm movement is included in the IO time.
+         * Offsets are aligned from -s, like those of the other paths.
          */
-        offset = lseek64(fd, cursor, SEEK_SET);
-        if (offset == -1) {
-            fprintf(stderr, "The end offset %lld specified by -S may be larger "
-                    "than the file length.\n", (long long int)seek_span);
-            perror("reposition_offset:lseek:");
-            exit(errno);
-        }
+        int align = job->bs_spec.align;
+        offset = cursor - cursor % align;
+        if (offset + size > span && span >= size)
+            offset = (span - size) - (span - size) % align;
+        offset += job->start_addr;
     } else {
         
-        /* rewind to file start when advancing beyond the file size. */
-        if ((off_t)((req_count + 1) * page_size) > seek_span) {
-            offset = lseek64(fd, start_addr, SEEK_SET);
-            if (offset == -1) {
-                perror("lseek(): init start_addr error.\n");
-                exit(errno);
-            }
-        } else {
-            /* do nothing, file offset automatically advances sequentially. */
-            offset = req_count * page_size;      
-        }
+        /* rewind to the start of this thread's range when advancing beyond
+         * its end, see setup_seq_layout(). */
+        if (td->seq_cursor + size > td->seq_end)
+            td->seq_cursor = td->seq_begin;
+        offset = td->seq_cursor;
+        td->seq_cursor += td->seq_step > 0 ? td->seq_step : size;
     }
     return offset;
 }
 
-inline int should_write(void)
+static inline int should_write(struct thread_data *td)
 {    
+    int write_percent = td->job->write_percent;
     int is_write = 1;
     if (write_percent == 0) {
         is_write = 0;
@@ -422,13 +1968,7 @@ inline int should_write(void)
     } else {
         
         /* flip the coin to decide read or write */
-        struct timeval tv_rand;
-        if (gettimeofday(&tv_rand, NULL) < 0) {
-            perror("should_write:gettimeofday()");
-            exit(errno);
-        }
-        srand((unsigned int)(tv_rand.tv_usec * tv_rand.tv_sec));
-        int perc = (double)rand() / RAND_MAX * 100;
+        int perc = (int)rand_below(&td->rand, 100);
         if (perc < write_percent) {
             is_write = 1;
         } else {
@@ -438,196 +1978,1496 @@ inline int should_write(void)
     return is_write;
 }
 
-void *do_io()
-{    
-    int iData = 33;
-    char *buffer;
-    ssize_t retval = 0;
-    struct timeval tv_before;
-    struct timeval tv_after;
-    off_t offset;
-    
-    long local_count = 0;
-    long local_sum_time = 0;
-    long time_elapsed = 0;
-    long r_count = 0;
-    long w_count = 0;
-    long r_time = 0;
-    long w_time = 0;
-        
-    int flags = O_CREAT | O_RDWR | O_SYNC;
+/*
+ * "summary:" and "thread:" lines. Times are in us as before, the scripts
+ * take the average latency from the second last field.
+ */
+static void print_count_line(const char *tag, int size,
+                             const struct histogram *rw,
+                             const struct histogram *total, const char *sep)
+{
+    const struct histogram *h[3] = { &rw[DDIR_READ], &rw[DDIR_WRITE], total };
+    long count[3], time_us[3];
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        count[i] = (long)h[i]->count;
+        time_us[i] = (long)(h[i]->sum / 1000);
+    }
+    fprintf(GET_OUTPUT(output_file), "%s: page_size %d , %s"
+           "[ read_count %ld , read_time(us) %ld , avg_latency(us) %ld ], %s"
+           "[ write_count %ld , write_time(us) %ld , avg_latency(us) %ld ], %s"
+           "[ total_count %ld , time(us) %ld , avg_latency(us) %ld ]\n",
+           tag, size, sep,
+           count[0], time_us[0], count[0] == 0 ? 0 : time_us[0] / count[0], sep,
+           count[1], time_us[1], count[1] == 0 ? 0 : time_us[1] / count[1], sep,
+           count[2], time_us[2], count[2] == 0 ? 0 : time_us[2] / count[2]);
+}
+
+/*
+ * "overhead:" line. per_io is the time the IO threads spent outside of
+ * waiting for the device, divided by the number of requests: request
+ * generation, accounting, clock reads and submit syscalls. When it gets
+ * close to the average latency the benchmark, not the device, is the
+ * bottleneck.
+ */
+static void print_overhead_line(const struct job *job, const char *sep)
+{
+    uint64_t ios = job->total_hist[DDIR_TOTAL].count;
+    uint64_t per_io = ios == 0 ? 0 : job->total_overhead_ns / ios;
+    double busy = job->total_run_ns == 0 ? 0.0 :
+                  100.0 * job->total_overhead_ns / job->total_run_ns;
+
+    fprintf(GET_OUTPUT(output_file), "overhead: clocksource %s , %s"
+            "clock_read(ns) %llu , per_io(ns) %llu , busy_percent %.1f , "
+            "max_iops_per_thread %llu\n", clocksource_name(), sep,
+            (unsigned long long)clock_read_cost(),
+            (unsigned long long)per_io, busy,
+            (unsigned long long)(per_io == 0 ? 0 : NSEC_PER_SEC / per_io));
+
+    if (busy > 50.0 && ios > 0)
+        fprintf(stderr, "warning: iombench itself used %.0f%% of the run "
+                "time, results may be limited by the benchmark rather than "
+                "the device.\n", busy);
+}
+
+/* "[ <name> min(us) .. , p99(us) .. ]" of one histogram */
+static void print_latency_group(FILE *out, const char *name,
+                                const struct histogram *h)
+{
+    int j;
+
+    fprintf(out, "[ %s min(us) %.3f , max(us) %.3f , mean(us) %.3f , "
+            "stddev(us) %.3f", name, h->count == 0 ? 0.0 : h->min / 1000.0,
+            h->max / 1000.0, hist_mean(h) / 1000.0, hist_stddev(h) / 1000.0);
+    for (j = 0; j < nr_percentiles; j++)
+        fprintf(out, " , p%g(us) %.3f", percentiles[j],
+                hist_percentile(h, percentiles[j]) / 1000.0);
+    fprintf(out, " ]");
+}
+
+/*
+ * "latency:" line with min/max/mean/stddev and percentiles in us, from the
+ * read, write and total histograms in h[].
+ */
+static void print_latency_line(const char *tag, const struct histogram *h,
+                               const char *sep)
+{
+    static const char *names[3] = { "read", "write", "total" };
+    FILE *out = GET_OUTPUT(output_file);
+    int i;
+
+    fprintf(out, "%s", tag);
+    for (i = 0; i <= DDIR_TOTAL; i++) {
+        fprintf(out, "%s %s", i == 0 ? "" : ",", sep);
+        print_latency_group(out, names[i], &h[i]);
+    }
+    fprintf(out, "\n");
+}
+
+/* "flush:" line, the flush calls of --flush as their own op class */
+static void print_flush_line(const struct job *job, const char *sep)
+{
+    FILE *out = GET_OUTPUT(output_file);
+    uint64_t writes = job->total_hist[DDIR_WRITE].count;
+
+    fprintf(out, "flush: call %s , every %d , bytes %lld , count %llu , "
+            "writes_per_flush %.1f , %s", flush_names[job->flush],
+            job->flush_every, job->flush_bytes,
+            (unsigned long long)job->flush_hist.count,
+            job->flush_hist.count == 0 ? 0.0
+                : (double)writes / job->flush_hist.count, sep);
+    print_latency_group(out, flush_names[job->flush], &job->flush_hist);
+    fprintf(out, "\n");
+}
+
+/*
+ * "metadata:" and "meta_latency:" lines of --meta_mix, ops per second of
+ * the job and latency per operation in the mix.
+ */
+static void print_meta_lines(const struct job *job, const char *sep)
+{
+    FILE *out = GET_OUTPUT(output_file);
+    uint64_t ops = job->total_hist[DDIR_TOTAL].count;
+    double secs = job->wall_ns / (double)NSEC_PER_SEC;
+    int op, first = 1;
+
+    fprintf(out, "metadata: root %s , leaf_dirs %u , files_per_thread %d , "
+            "file_size %d , fsync %d , %sops %llu , ops_per_sec %.1f",
+            job->filename, meta_leaf_dirs(job), job->meta_files,
+            job->meta_file_size, job->meta_fsync, sep,
+            (unsigned long long)ops, secs > 0 ? ops / secs : 0.0);
+    for (op = 0; op < META_NR_OPS; op++)
+        fprintf(out, " , %s %llu", meta_op_names[op],
+                (unsigned long long)job->meta_hist[op].count);
+    fprintf(out, "\nmeta_latency:");
+    for (op = 0; op < META_NR_OPS; op++) {
+        if (job->meta_mix[op] == 0 && job->meta_hist[op].count == 0)
+            continue;
+        fprintf(out, "%s %s", first ? "" : ",", sep);
+        print_latency_group(out, meta_op_names[op], &job->meta_hist[op]);
+        first = 0;
+    }
+    fprintf(out, "\n");
+}
+
+/*
+ * "rate:" line, offered versus achieved load. lag is how late requests
+ * were issued after their intended start, for lack of a free slot or CPU.
+ * Latencies already include it.
+ */
+static void print_rate_line(const struct job *job, const char *sep)
+{
+    uint64_t ios = job->total_hist[DDIR_TOTAL].count;
+    double secs = job->wall_ns / (double)NSEC_PER_SEC;
+    int scale = job->rate_global > 0 ? 1 : job->thread_count;
+
+    fprintf(GET_OUTPUT(output_file), "rate: process %s , scope %s , %s"
+            "target_iops %lld , target_bw(B/s) %lld , %s"
+            "achieved_iops %.1f , achieved_bw(B/s) %.0f , %s"
+            "avg_lag(us) %.3f , max_lag(us) %.3f\n",
+            job->rate_process == RATE_POISSON ? "poisson" : "constant",
+            job->rate_global > 0 ? "global" : "thread", sep,
+            job->rate_iops * scale, job->rate_bw * scale, sep,
+            secs > 0 ? ios / secs : 0.0,
+            secs > 0 ? job->total_bytes / secs : 0.0, sep,
+            ios == 0 ? 0.0 : job->total_lag_ns / 1000.0 / ios,
+            job->max_lag_ns / 1000.0);
+}
+
+/* histogram dump names are prefixed with the job name when there are jobs */
+static const char *hist_prefix(const struct job *job)
+{
+    static char prefix[MAX_JOB_NAME_LENGTH + 1];
+
+    if (nr_jobs < 2)
+        return "";
+    snprintf(prefix, sizeof(prefix), "%s.", job->name);
+    return prefix;
+}
+
+/*
+ * "bs:" and "bs_latency:" lines, one pair per block size class with
+ * --bssplit or --bsrange. For --bsrange a class holds the sizes from its
+ * label up to the next power of two.
+ */
+static void print_bs_stats(const struct job *job)
+{
+    const struct bs_spec *bs = &job->bs_spec;
+    char tag[MAX_JOB_NAME_LENGTH + 64];
+    int c;
+
+    if (bs->nr_classes < 2)
+        return;
+    for (c = 0; c < bs->nr_classes; c++) {
+        struct histogram *h = &job->total_bs_hist[c * (DDIR_TOTAL + 1)];
+        if (h[DDIR_TOTAL].count == 0)
+            continue;
+        print_count_line("bs", bs->class_size[c], h, &h[DDIR_TOTAL],
+                         human_readable);
+        snprintf(tag, sizeof(tag), "bs_latency: size %d ,",
+                 bs->class_size[c]);
+        print_latency_line(tag, h, human_readable);
+        if (hist_dump_enabled > 0) {
+            snprintf(tag, sizeof(tag), "%sr%d", hist_prefix(job),
+                     bs->class_size[c]);
+            hist_dump(GET_OUTPUT(output_file), tag, &h[DDIR_READ]);
+            snprintf(tag, sizeof(tag), "%sw%d", hist_prefix(job),
+                     bs->class_size[c]);
+            hist_dump(GET_OUTPUT(output_file), tag, &h[DDIR_WRITE]);
+        }
+    }
+}
+
+static inline int affinity_enabled(const struct job *job)
+{
+    return job->cpus_allowed.nr > 0 || job->numa_node >= 0;
+}
+
+/* the CPUs thread <thread_id> of <job> may run on */
+static void thread_cpus(const struct job *job, int thread_id,
+                        struct cpu_list *l)
+{
+    if (!job->cpus_split) {
+        *l = job->cpus_allowed;
+        return;
+    }
+    l->nr = 1;
+    l->cpu[0] = job->cpus_allowed.cpu[thread_id % job->cpus_allowed.nr];
+}
+
+/*
+ * IO buffers. With a placement they are page aligned, bound to the memory
+ * node if there is one, and touched here by the already pinned thread so
+ * that they are local to it before the first request.
+ */
+static void setup_io_us(struct thread_data *td)
+{
+    const struct job *job = td->job;
+    int page_size = job->page_size;
+    int iodepth = job->iodepth;
+    size_t len = (size_t)page_size * iodepth + payload_pool_size(job);
+    size_t align = SECTOR_SIZE;
+    int i;
+
+    if (affinity_enabled(job)) {
+        align = (size_t)sysconf(_SC_PAGESIZE);
+        len = (len + align - 1) / align * align;
+    }
+    if (posix_memalign((void **)&td->buffers, align, len)) {
+        perror("do_io:posix_memalign()");
+        exit(errno);
+    }
+    if (job->numa_node >= 0) {
+        int ret = bind_memory(td->buffers, len, job->numa_node);
+        if (ret < 0)
+            fprintf(stderr, "warning: cannot bind buffers to NUMA node %d: "
+                    "%s\n", job->numa_node, strerror(-ret));
+    }
+    if (affinity_enabled(job))
+        memset(td->buffers, 0, len);
+    td->io_us = calloc(iodepth, sizeof(struct io_u));
+    td->free_list = calloc(iodepth, sizeof(struct io_u *));
+    td->events = calloc(iodepth, sizeof(struct io_u *));
+    td->queued_io_us = calloc(iodepth, sizeof(struct io_u *));
+    if (td->io_us == NULL || td->free_list == NULL || td->events == NULL ||
+        td->queued_io_us == NULL) {
+        perror("do_io:calloc()");
+        exit(errno);
+    }
+    for (i = 0; i < iodepth; i++) {
+        td->io_us[i].buf = td->buffers + (size_t)i * page_size;
+        td->io_us[i].size = page_size;
+        td->io_us[i].index = i;
+        td->io_us[i].buf_index = i;
+        td->free_list[i] = &td->io_us[i];
+    }
+    td->nr_free = iodepth;
+    if (payload_enabled(job))
+        payload_setup(td, td->buffers + (size_t)page_size * iodepth);
+}
+
+static void free_io_us(struct thread_data *td)
+{
+    free(td->io_us);
+    free(td->free_list);
+    free(td->events);
+    free(td->queued_io_us);
+    free(td->buffers);
+}
+
+static void prep_io_u(struct thread_data *td, struct io_u *io_u)
+{
+    if (td->job->replay != NULL) {
+        io_u->size = (int)td->replay_rec.size;
+        io_u->offset = (off_t)td->replay_rec.offset;
+        io_u->is_write = td->replay_rec.is_write;
+        io_u->bs_class = 0;
+        td->replay_pending = 0;
+    } else {
+        io_u->size = bs_next(&td->job->bs_spec, &td->rand, &io_u->bs_class);
+        io_u->offset = reposition_offset(td, io_u->size);
+        io_u->is_write = should_write(td);
+        if (td->job->nr_targets > 0)
+            target_map(td, io_u);
+    }
+    io_u->result = 0;
+
+    /* prepare human readable data for write, verifiable data, or point
+     * into the write data pool. Reads always use the slot's own buffer. */
+    if (io_u->is_write > 0 && td->job->verify > 0) {
+        verify_fill(td, io_u);
+    } else if (io_u->is_write > 0 && td->pool != NULL) {
+        payload_fill(td, io_u);
+    } else if (td->pool != NULL) {
+        io_u->buf = td->buffers + (size_t)io_u->index * td->job->page_size;
+        io_u->buf_index = io_u->index;
+    } else if (io_u->is_write > 0) {
+        td->iData++;
+        if (td->iData > ASCII_PRINTABLE_HIGH) td->iData = 33;
+        memset(io_u->buf, td->iData, io_u->size);
+    }
+}
+
+/* account one finished request, <now> is the completion timestamp */
+static void complete_io_u(struct thread_data *td, struct io_u *io_u,
+                          uint64_t now)
+{
+    uint64_t time_elapsed = now - io_u->issue_ns;
+
+    if (io_u->result < 0) {
+        errno = (int)-io_u->result;
+        perror(io_u->is_write > 0 ? "write() error.\n" : "read() error.\n");
+        exit(errno);
+    }
+    if (td->job->verify > 0)
+        verify_complete(td, io_u);
+    if (td->job->flush != FLUSH_NONE && io_u->is_write > 0) {
+        td->flush_writes++;
+        td->flush_written += io_u->size;
+        if ((td->job->flush_every > 0 &&
+             td->flush_writes >= (uint64_t)td->job->flush_every) ||
+            (td->job->flush_bytes > 0 &&
+             td->flush_written >= (uint64_t)td->job->flush_bytes))
+            td->flush_due = 1;
+    }
+    
+    if (io_u->issue_ns < td->measure_ns) {
+        __atomic_store_n(&td->warmup_ios, td->warmup_ios + 1,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&td->warmup_lat_ns, td->warmup_lat_ns + time_elapsed,
+                         __ATOMIC_RELAXED);
+        td->inflight--;
+        td->free_list[td->nr_free++] = io_u;
+        return;
+    }
+    
+    if (td->trace != NULL) {
+        struct trace_rec rec;
+        rec.issue_ns = ns_to_epoch_ns(io_u->issue_ns);
+        rec.offset = (uint64_t)io_u->offset;
+        rec.lat_ns = time_elapsed;
+        rec.size = (uint32_t)io_u->size;
+        rec.qdepth = (uint32_t)td->inflight;
+        rec.thread_id = (uint16_t)td->thread_id;
+        rec.job = (uint8_t)td->job->index;
+        rec.is_write = io_u->is_write > 0;
+        memset(rec.pad, 0, sizeof(rec.pad));
+        trace_add(td->trace, &rec);
+    }
+    
+    int ddir = io_u->is_write > 0 ? DDIR_WRITE : DDIR_READ;
+    __atomic_store_n(&td->io_bytes[ddir], td->io_bytes[ddir] + io_u->size,
+                     __ATOMIC_RELAXED);
+    hist_add(&td->hist[ddir], time_elapsed);
+    if (td->bs_hist != NULL)
+        hist_add(&td->bs_hist[io_u->bs_class * DDIR_RW + ddir], time_elapsed);
+    if (td->target_hist != NULL) {
+        int t = td->target >= 0 ? td->target : io_u->file;
+        hist_add(&td->target_hist[t * DDIR_RW + ddir], time_elapsed);
+        td->target_bytes[t] += io_u->size;
+    }
+
+    td->inflight--;
+    td->free_list[td->nr_free++] = io_u;
+}
+
+static int flush_fd(int flush, int fd)
+{
+    switch (flush) {
+    case FLUSH_FSYNC:
+        return fsync(fd);
+#ifdef __linux__
+    case FLUSH_SYNC_FILE_RANGE:
+        return sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE |
+                               SYNC_FILE_RANGE_WRITE |
+                               SYNC_FILE_RANGE_WAIT_AFTER);
+#endif
+    default:
+        return fdatasync(fd);
+    }
+}
+
+/*
+ * --flush: make the writes completed so far durable. The call blocks the
+ * thread like a write-ahead log's commit does and is timed on its own;
+ * flushes of the steady state warmup are not counted. Striped targets are
+ * flushed one after the other and timed as one flush.
+ */
+static void flush_file(struct thread_data *td)
+{
+    uint64_t start = now_ns();
+    int i, ret = 0;
+
+    for (i = 0; i < td->nr_fds && ret == 0; i++)
+        ret = flush_fd(td->job->flush, td->fds[i]);
+    if (ret != 0) {
+        perror("do_io:flush");
+        exit(errno);
+    }
+    td->now = now_ns();
+    td->wait_ns += td->now - start;
+    if (start >= td->measure_ns)
+        hist_add(&td->flush_hist, td->now - start);
+    td->flush_writes = 0;
+    td->flush_written = 0;
+    td->flush_due = 0;
+}
+
+static inline int rate_enabled(const struct job *job)
+{
+    return job->rate_iops > 0 || job->rate_bw > 0;
+}
+
+/* requests have an intended start: from a rate, or from a timed replay */
+static inline int scheduled(const struct job *job)
+{
+    return rate_enabled(job) ||
+           (job->replay != NULL && job->replay_speed > 0);
+}
+
+/*
+ * Intended start of the request after one of <size> bytes. Constant
+ * arrivals are evenly spaced, poisson arrivals have exponentially
+ * distributed gaps with the same mean.
+ */
+static inline void schedule_next_io(struct thread_data *td, int size)
+{
+    const struct job *job = td->job;
+    double gap = job->rate_iops > 0 ? job->rate_ns_per_io
+                                    : job->rate_ns_per_byte * size;
+
+    if (job->rate_process == RATE_POISSON)
+        gap *= -log(1.0 - rand_double(&td->rate_rand));
+    td->next_issue_ns += (uint64_t)gap;
+}
+
+static void commit_io_us(struct thread_data *td)
+{
+    int i;
+
+    /* latency is measured from submit, not from when the request was
+     * staged while waiting for the rest of its batch. With a rate the
+     * intended start set in do_io() is kept instead. */
+    td->now = now_ns();
+    if (!scheduled(td->job))
+        for (i = 0; i < td->queued; i++)
+            td->queued_io_us[i]->issue_ns = td->now;
+
+    if (td->engine->commit != NULL) {
+        int ret = td->engine->commit(td);
+        if (ret < 0) {
+            errno = -ret;
+            perror("do_io:commit");
+            exit(errno);
+        }
+    }
+    td->queued = 0;
+}
+
+/*
+ * Sequential range of a thread:
+ *   shared  every thread walks all of [start_addr, seek_span) from the start,
+ *           the original behaviour.
+ *   split   thread t walks the t-th of thread_count contiguous regions.
+ *   stride  threads interleave, thread t does blocks t, t + n, t + 2n, ...
+ * With mixed block sizes a block is the largest size (page_size), requests
+ * start at the beginning of their block.
+ */
+static void setup_seq_layout(struct thread_data *td)
+{
+    const struct job *job = td->job;
+    off_t page_size = job->page_size;
+    off_t nblocks = (job->seek_span - job->start_addr) / page_size;
+
+    td->seq_begin = job->start_addr;
+    td->seq_end = job->seek_span;
+    td->seq_step = 0;       /* advance by the size of each request */
+
+    if (job->seq_layout == SEQ_LAYOUT_SPLIT) {
+        off_t per_thread = nblocks / job->thread_count;
+        td->seq_begin = job->start_addr +
+                        td->thread_id * per_thread * page_size;
+        if (td->thread_id < job->thread_count - 1)
+            td->seq_end = td->seq_begin + per_thread * page_size;
+    } else if (job->seq_layout == SEQ_LAYOUT_STRIDE) {
+        td->seq_begin = job->start_addr + td->thread_id * page_size;
+        td->seq_step = job->thread_count * page_size;
+    }
+    td->seq_cursor = td->seq_begin;
+}
+
+/* open the file under test the way all IO on it is done */
+int open_target(const struct job *job)
+{
+    return open_target_path(job, job->filename);
+}
+
+/* open <path>, one of the targets of the job */
+int open_target_path(const struct job *job, const char *path)
+{
+    int flags = O_CREAT | O_RDWR;
+    if (job->sync_mode == SYNC_OSYNC)
+        flags |= O_SYNC;
+    else if (job->sync_mode == SYNC_ODSYNC)
+        flags |= O_DSYNC;
 #ifdef __linux__
-    flags |= O_DIRECT;
+    if (job->direct > 0)
+        flags |= O_DIRECT;
     flags |= O_LARGEFILE;
+    /* the mmap engine does not go through the fd */
+    if (job->ioengine->mapped)
+        flags &= ~(O_SYNC | O_DSYNC | O_DIRECT);
 #endif
     
-    int fd_test = open(filename, flags, 0666);
-    if (fd_test < 0) {
+    int fd = open(path, flags, 0666);
+    if (fd < 0) {
         fprintf(stderr, "error to open file %s, please check permission.\n",
-                filename);
-        perror("do_io:open()");
+                path);
+        perror("open_target:open()");
         exit(errno);
     }
+    return fd;
+}
+
+/*
+ * The steady state detector started the measurement: drop what this thread
+ * counted while warming up and run for -d seconds from here. Jobs started
+ * later, after a stonewall, begin measuring right away.
+ */
+static void begin_measurement(struct thread_data *td, uint64_t *stop_ns)
+{
+    td->measure_ns = td->start_ns = td->now;
+    cpu_stat_begin(&td->cpu_stat);
+    *stop_ns = td->now + (uint64_t)td->job->duration * NSEC_PER_SEC;
+    td->issued = 0;
+    td->wait_ns = 0;
+    td->lag_sum_ns = 0;
+    td->lag_max_ns = 0;
+}
+
+/* "thread:" line of a finished thread, when the job has several */
+static void print_thread_line(const struct thread_data *td)
+{
+    const struct job *job = td->job;
+    struct histogram total;
+
+    if (job->thread_count == 1 || output_format != OUTPUT_TEXT ||
+        sweep_enabled(&sweep_spec))
+        return;
+    hist_init(&total);
+    hist_merge(&total, &td->hist[DDIR_READ]);
+    hist_merge(&total, &td->hist[DDIR_WRITE]);
+    print_count_line("thread", job->page_size, td->hist, &total, "");
+}
+
+/*
+ * Keep up to iodepth requests in flight. For psync the engine completes each
+ * request inside queue(), so this is the original one-request-at-a-time loop.
+ *
+ * The loop reads the clock only where a latency needs it: before a
+ * synchronous request, at submit and once per reaped batch. The stop time is
+ * checked against the latest of these timestamps, so it costs nothing extra.
+ * Time spent waiting on the device is summed in td->wait_ns, the rest of the
+ * thread's run time is the benchmark's own per-IO overhead.
+ *
+ * With --rate_iops/--rate_bw the loop is open: each request has an intended
+ * start on a fixed schedule, is issued at that time if a slot is free, and
+ * its latency is measured from the intended start. A stalled device then
+ * shows up as latency instead of as fewer requests (coordinated omission).
+ */
+void *do_io(void *arg)
+{    
+    struct thread_data *td = arg;
+    struct job *job = td->job;
+    struct io_u *io_u;
+    int ret;
     
-    if (posix_memalign((void **)&buffer, SECTOR_SIZE, page_size)) {
-        perror("do_io:posix_memalign()");
-        exit(errno);
-    }
+    td->fds = &td->fd;
+    td->nr_fds = 1;
+    td->target = -1;
+    if (job->meta > 0)
+        td->fd = -1;
+    else if (job->nr_targets > 0)
+        target_open(td);
+    else
+        td->fd = job->target_fd >= 0 ? job->target_fd : open_target(job);
+    td->engine = job->ioengine;
     
-    struct timeval tv_start;    
-    if (gettimeofday(&tv_start, NULL) < 0) {
-        perror("do_io:gettimeofday()");
-        exit(errno);
+    /* streams of later jobs are keyed by the job index too */
+    uint64_t stream = ((uint64_t)job->index << 32) | td->thread_id;
+    td->iData = 33;
+    if (job->cpus_allowed.nr > 0) {
+        struct cpu_list cpus;
+        thread_cpus(job, td->thread_id, &cpus);
+        ret = pin_thread(&cpus);
+        if (ret < 0) {
+            fprintf(stderr, "failed to pin thread %d of job %s to CPUs "
+                    "%s: %s\n", td->thread_id, job->name,
+                    job->cpus_allowed_spec, strerror(-ret));
+            exit(-ret);
+        }
+    }
+    current_cpu(&td->cpu, &td->node);
+    setup_seq_layout(td);
+    rand_init(&td->rand, rand_seed, stream);
+    rand_init(&td->payload_rand, rand_seed, stream + 0x10000);
+    if (job->meta > 0) {
+        meta_thread(td);
+        print_thread_line(td);
+        return NULL;
+    }
+    if (job->full_coverage > 0) {
+        /* threads own disjoint slices of the same permutation */
+        uint64_t nblocks = job->block_perm.nblocks;
+        td->perm_begin = nblocks * td->thread_id / job->thread_count;
+        td->perm_end = nblocks * (td->thread_id + 1) / job->thread_count;
+        td->perm_pos = td->perm_begin;
+        perm_keys(td->perm_keys, rand_seed + job->index, 0);
+    }
+    if (job->bs_spec.nr_classes > 1) {
+        int i, n = DDIR_RW * job->bs_spec.nr_classes;
+        td->bs_hist = malloc(sizeof(struct histogram) * n);
+        if (td->bs_hist == NULL) {
+            perror("do_io:malloc()");
+            exit(errno);
+        }
+        for (i = 0; i < n; i++)
+            hist_init(&td->bs_hist[i]);
+    }
+    setup_io_us(td);
+
+    if (td->engine->init != NULL) {
+        ret = td->engine->init(td);
+        if (ret < 0) {
+            fprintf(stderr, "failed to init engine %s: %s\n",
+                    td->engine->name, strerror(-ret));
+            exit(-ret);
+        }
     }
     
-    time_t start_time, stop_time;
-    start_time = time(NULL);
-    stop_time = start_time + duration;
+    uint64_t stop_ns;
+    cpu_stat_open(&td->cpu_stat);
+    cpu_stat_begin(&td->cpu_stat);
+    td->start_ns = td->now = now_ns();
+    stop_ns = td->start_ns + (uint64_t)job->duration * NSEC_PER_SEC;
+    if (ss_window > 0)
+        td->measure_ns = stop_ns = UINT64_MAX;
     
-    long i=0;
-    while (time(NULL) < stop_time && i < request_count) {
-        
-        offset = reposition_offset(fd_test, i);
-        
-        int is_write = should_write();
+    if (rate_enabled(job)) {
+        rand_init(&td->rate_rand, rand_seed, stream + 0x8000);
+        /* spread the threads' schedules over one gap for a global rate */
+        td->next_issue_ns = td->start_ns;
+        if (job->rate_global > 0 && job->rate_iops > 0)
+            td->next_issue_ns += (uint64_t)(job->rate_ns_per_io *
+                                            td->thread_id / job->thread_count);
+    }
+    
+    for (;;) {
+        if (td->measure_ns == UINT64_MAX &&
+            __atomic_load_n(&measure_start_ns, __ATOMIC_ACQUIRE) != 0)
+            begin_measurement(td, &stop_ns);
+        int can_issue = td->issued < job->request_count &&
+                        td->now < stop_ns && !td->replay_done;
+        if (!can_issue && td->inflight == 0)
+            break;
         
-        /* prepare human readable data for write */
-        if (is_write > 0) {
-            iData++;
-            if ( iData > 126 ) iData = 33;
-            memset(buffer, iData, page_size);
+        /* refill the queue, at most the free slots seen on entry so that
+         * the stop time is checked between synchronous requests too. */
+        int to_issue = can_issue ? td->nr_free : 0;
+        while (to_issue-- > 0 && td->issued < job->request_count) {
+            if (job->replay != NULL && !td->replay_pending) {
+                if (replay_next(job->replay, &td->replay_rec,
+                                &td->next_issue_ns) != 0) {
+                    td->replay_done = 1;
+                    break;
+                }
+                td->replay_pending = 1;
+            }
+            if (scheduled(job)) {
+                td->now = now_ns();
+                if (td->now < td->next_issue_ns)
+                    break;
+            }
+            io_u = td->free_list[--td->nr_free];
+            prep_io_u(td, io_u);
+            
+            if (scheduled(job)) {
+                uint64_t lag = td->now - td->next_issue_ns;
+                td->lag_sum_ns += lag;
+                if (lag > td->lag_max_ns)
+                    td->lag_max_ns = lag;
+                io_u->issue_ns = td->next_issue_ns;
+                if (rate_enabled(job))
+                    schedule_next_io(td, io_u->size);
+            } else if (td->engine->sync) {
+                io_u->issue_ns = now_ns();
+            }
+            
+            if (job->verify > 0)
+                verify_issue(td, io_u);
+            ret = td->engine->queue(td, io_u);
+            if (ret < 0) {
+                errno = -ret;
+                perror("do_io:queue");
+                exit(errno);
+            }
+            td->issued++;
+            td->inflight++;
+            
+            if (ret == IO_Q_COMPLETED) {
+                td->now = now_ns();
+                td->wait_ns += td->now - io_u->issue_ns;
+                complete_io_u(td, io_u, td->now);
+                if (td->flush_due)
+                    flush_file(td);
+                continue;
+            }
+            td->queued_io_us[td->queued++] = io_u;
+            if (td->queued >= job->iodepth_batch)
+                commit_io_us(td);
         }
+        if (td->queued > 0)
+            commit_io_us(td);
         
-        time_elapsed = 0;
-        
-        if (gettimeofday(&tv_before, NULL) < 0){
-            perror("do_io:gettimeofday()");
-            exit(errno);
+        if (td->inflight > 0) {
+            int min = can_issue ? job->iodepth_batch_complete : 1;
+            if (min > td->inflight)
+                min = td->inflight;
+            /* with a free slot, never block past the next intended start */
+            if (scheduled(job) && can_issue && td->nr_free > 0)
+                min = 0;
+            int max = td->inflight < job->iodepth_batch_complete_max ?
+                      td->inflight : job->iodepth_batch_complete_max;
+            uint64_t wait_start = now_ns();
+            ret = td->engine->getevents(td, min, max);
+            if (ret < 0) {
+                errno = -ret;
+                perror("do_io:getevents");
+                exit(errno);
+            }
+            td->now = now_ns();
+            td->wait_ns += td->now - wait_start;
+            int i;
+            for (i = 0; i < ret; i++)
+                complete_io_u(td, td->events[i], td->now);
+            if (td->flush_due)
+                flush_file(td);
         }
         
-        if (is_write > 0) {
-            retval = write(fd_test, buffer, page_size);
-        } else {
-            retval = read(fd_test, buffer, page_size);
+        /* idle until the next request is due. With requests in flight on
+         * an async engine keep polling so completions are timed exactly. */
+        if (scheduled(job) && can_issue && td->nr_free > 0 &&
+            td->inflight == 0 && td->now < td->next_issue_ns) {
+            uint64_t idle_start = td->now;
+            sleep_until_ns(td->next_issue_ns < stop_ns ? td->next_issue_ns
+                                                       : stop_ns);
+            td->now = now_ns();
+            td->wait_ns += td->now - idle_start;
         }
-        
-        if (retval < 0) {
-            perror(is_write > 0 ? "write() error.\n" : "read() error.\n");
+    }
+    td->end_ns = now_ns();
+    cpu_stat_end(&td->cpu_stat);
+    cpu_stat_close(&td->cpu_stat);
+    
+    if (job->verify_pass > 0) {
+        ret = verify_pass(td);
+        if (ret < 0) {
+            errno = -ret;
+            perror("do_io:verify_pass()");
             exit(errno);
         }
-        if (gettimeofday(&tv_after, NULL) < 0){
-            perror("do_io:gettimeofday()");
+    }
+    
+    print_thread_line(td);
+    
+    if (td->engine->cleanup != NULL)
+        td->engine->cleanup(td);
+    if (job->nr_targets > 0)
+        target_close(td);
+    else if (job->target_fd < 0)
+        close(td->fd);
+    free_io_us(td);
+    return NULL;
+}
+
+/* fold the per-thread results of one job into the job totals */
+static void merge_job_stats(struct job *job, struct thread_data *threads)
+{
+    int i;
+    
+    job->threads = threads;
+    for (i = 0; i <= DDIR_TOTAL; i++)
+        hist_init(&job->total_hist[i]);
+    hist_init(&job->flush_hist);
+    for (i = 0; i < job->thread_count; i++) {
+        hist_merge(&job->total_hist[DDIR_READ], &threads[i].hist[DDIR_READ]);
+        hist_merge(&job->total_hist[DDIR_WRITE],
+                   &threads[i].hist[DDIR_WRITE]);
+        hist_merge(&job->flush_hist, &threads[i].flush_hist);
+    }
+    
+    if (job->meta > 0) {
+        int op;
+        for (op = 0; op < META_NR_OPS; op++) {
+            hist_init(&job->meta_hist[op]);
+            for (i = 0; i < job->thread_count; i++)
+                hist_merge(&job->meta_hist[op], &threads[i].meta_hist[op]);
+        }
+        for (i = 0; i < job->thread_count; i++)
+            free(threads[i].meta_hist);
+    }
+    hist_merge(&job->total_hist[DDIR_TOTAL], &job->total_hist[DDIR_READ]);
+    hist_merge(&job->total_hist[DDIR_TOTAL], &job->total_hist[DDIR_WRITE]);
+    if (job->nr_targets > 0)
+        target_merge(job, threads);
+    
+    if (job->bs_spec.nr_classes > 1) {
+        int c, n = job->bs_spec.nr_classes;
+        job->total_bs_hist = malloc(sizeof(struct histogram) *
+                                    (DDIR_TOTAL + 1) * n);
+        if (job->total_bs_hist == NULL) {
+            perror("merge_job_stats:malloc()");
             exit(errno);
         }
-        
-        time_elapsed=(tv_after.tv_sec - tv_before.tv_sec) * 1000000 +
-                        tv_after.tv_usec - tv_before.tv_usec;
-        
-        if (print_detail > 0)
-            fprintf(GET_OUTPUT(output_file), "io,%ld,%s,%d,%lld,%ld\n",
-                    tv_before.tv_sec, is_write == 1 ? "w": "r",
-                    page_size, (long long int)offset, time_elapsed);
-        
-        local_count++;
-        local_sum_time += time_elapsed;
-        if (is_write > 0) {
-            w_count++;
-            w_time += time_elapsed;
+        for (c = 0; c < n; c++) {
+            struct histogram *h = &job->total_bs_hist[c * (DDIR_TOTAL + 1)];
+            hist_init(&h[DDIR_READ]);
+            hist_init(&h[DDIR_WRITE]);
+            hist_init(&h[DDIR_TOTAL]);
+            for (i = 0; i < job->thread_count; i++) {
+                hist_merge(&h[DDIR_READ],
+                           &threads[i].bs_hist[c * DDIR_RW + DDIR_READ]);
+                hist_merge(&h[DDIR_WRITE],
+                           &threads[i].bs_hist[c * DDIR_RW + DDIR_WRITE]);
+            }
+            hist_merge(&h[DDIR_TOTAL], &h[DDIR_READ]);
+            hist_merge(&h[DDIR_TOTAL], &h[DDIR_WRITE]);
+        }
+        for (i = 0; i < job->thread_count; i++)
+            free(threads[i].bs_hist);
+    }
+    
+    if (job->full_coverage > 0) {
+        /* passes that every thread completed, i.e. full passes */
+        job->coverage_passes = UINT64_MAX;
+        for (i = 0; i < job->thread_count; i++) {
+            uint64_t slice = threads[i].perm_end - threads[i].perm_begin;
+            uint64_t passes = (uint64_t)threads[i].issued / slice;
+            if (passes < job->coverage_passes)
+                job->coverage_passes = passes;
+        }
+    }
+    
+    uint64_t first_start = UINT64_MAX, last_end = 0;
+    for (i = 0; i < job->thread_count; i++) {
+        job->total_lag_ns += threads[i].lag_sum_ns;
+        if (threads[i].lag_max_ns > job->max_lag_ns)
+            job->max_lag_ns = threads[i].lag_max_ns;
+        job->total_bytes += threads[i].io_bytes[DDIR_READ] +
+                            threads[i].io_bytes[DDIR_WRITE];
+        if (threads[i].start_ns < first_start)
+            first_start = threads[i].start_ns;
+        if (threads[i].end_ns > last_end)
+            last_end = threads[i].end_ns;
+    }
+    job->wall_ns = last_end - first_start;
+    
+    for (i = 0; i < job->thread_count; i++) {
+        uint64_t run = threads[i].end_ns - threads[i].start_ns;
+        job->total_run_ns += run;
+        job->total_overhead_ns += run > threads[i].wait_ns ?
+                                  run - threads[i].wait_ns : 0;
+    }
+}
+
+static void rampup_sleep(void)
+{
+    struct timespec ts, rem;
+    ts.tv_sec = (time_t) (rampup_interval / 1000000);
+    ts.tv_nsec = (long) (rampup_interval % 1000000) * 1000;
+    while (nanosleep(&ts, &rem) == -1) {
+        if (errno == EINTR) {
+            memcpy(&ts, &rem, sizeof(struct timespec));
         } else {
-            r_count++;
-            r_time += time_elapsed;
+            printf("sleep time invalid %ld s %ld ns",
+                                ts.tv_sec, ts.tv_nsec);
+            break;
         }
-        
-        i++;
-    }
-    
-    if (thread_count > 1) {
-        fprintf(GET_OUTPUT(output_file), "thread: page_size %d , "
-               "[ read_count %ld , read_time(us) %ld , avg_latency(us) %ld ], "
-               "[ write_count %ld , write_time(us) %ld , avg_latency(us) %ld ], "
-               "[ total_count %ld , time(us) %ld , avg_latency(us) %ld ]\n",
-               page_size,
-               r_count, r_time, r_count == 0 ? 0 : r_time / r_count,
-               w_count, w_time, w_count == 0 ? 0 : w_time / w_count,
-               local_count, local_sum_time,
-               local_sum_time == 0 ? 0 : local_sum_time / local_count);
-    }
-    
-    pthread_mutex_lock(&mutex_mix_sum);
-    sum_time += local_sum_time;
-    total_count += local_count;
-    w_sum_time += w_time;
-    w_total_count += w_count;
-    r_sum_time += r_time;
-    r_total_count += r_count;
-    pthread_mutex_unlock(&mutex_mix_sum);
-    
-    close(fd_test);
-    free(buffer);
-    return NULL;
+    }
 }
 
+/* the reporter thread also takes the throughput samples for JSON results */
+static int sampling_enabled(void)
+{
+    return report_interval > 0 || output_format == OUTPUT_JSON ||
+           compare_filename[0] != '\0';
+}
+
+/*
+ * Run all jobs. Jobs run concurrently in groups; a job with stonewall set
+ * starts a new group, which waits until every job before it has finished.
+ */
 void start_io_threads(void)
 {
+    int nr_threads = 0;
+    int i, j, n;
+    
+    for (j = 0; j < nr_jobs; j++)
+        nr_threads += jobs[j].thread_count;
+    
     pthread_t *g_tid = NULL;
-    g_tid = (pthread_t *)malloc(sizeof(pthread_t *) * thread_count);
-    int i=0;
-    for (i = 0; i < thread_count; i++) {
-        
-        int ret = pthread_create(&g_tid[i], NULL, do_io, NULL);
-        if (ret != 0) {
-            perror("error creating threads.\n");
-            if (ret == EAGAIN) {
-                perror("not enough system resources.\n");
-            }
+    g_tid = (pthread_t *)malloc(sizeof(pthread_t) * nr_threads);
+    struct thread_data *threads = calloc(nr_threads,
+                                         sizeof(struct thread_data));
+    if (g_tid == NULL || threads == NULL) {
+        perror("start_io_threads:malloc()");
+        exit(errno);
+    }
+    
+    /* before any thread starts, the reporter reads them from the start */
+    for (j = 0, n = 0; j < nr_jobs; j++) {
+        for (i = 0; i < jobs[j].thread_count; i++, n++) {
+            threads[n].job = &jobs[j];
+            threads[n].thread_id = i;
+            hist_init(&threads[n].hist[DDIR_READ]);
+            hist_init(&threads[n].hist[DDIR_WRITE]);
+            hist_init(&threads[n].flush_hist);
+        }
+    }
+    
+    if (print_detail > 0 || trace_filename[0] != '\0') {
+        struct trace_ring *rings = trace_start(nr_threads,
+                trace_filename[0] != '\0' ? trace_filename : NULL,
+                GET_OUTPUT(output_file));
+        if (rings == NULL) {
+            perror("start_io_threads:trace_start()");
             exit(errno);
         }
+        for (i = 0; i < nr_threads; i++)
+            threads[i].trace = &rings[i];
+    }
+    if (sampling_enabled() && report_start(threads, nr_threads) != 0) {
+        perror("start_io_threads:report_start()");
+        exit(errno);
+    }
+    if (ss_window > 0 && steady_start(threads, nr_threads) != 0) {
+        perror("start_io_threads:steady_start()");
+        exit(errno);
+    }
+    
+    for (j = 0, n = 0; j < nr_jobs; ) {
+        int first = n;
         
-        if (rampup_interval > 0) {
-            struct timespec ts, rem;            
-            ts.tv_sec = (time_t) (rampup_interval / 1000000);
-            ts.tv_nsec = (long) (rampup_interval % 1000000) * 1000;
-            while (nanosleep(&ts, &rem) == -1) {
-                if (errno == EINTR) {
-                    memcpy(&ts, &rem, sizeof(struct timespec));
-                } else {
-                    printf("sleep time invalid %ld s %ld ns",
-                                        ts.tv_sec, ts.tv_nsec);
-                    break;
+        /* this group: the jobs up to the next stonewall */
+        do {
+            for (i = 0; i < jobs[j].thread_count; i++, n++) {
+                int ret = pthread_create(&g_tid[n], NULL, do_io, &threads[n]);
+                if (ret != 0) {
+                    perror("error creating threads.\n");
+                    if (ret == EAGAIN) {
+                        perror("not enough system resources.\n");
+                    }
+                    exit(errno);
                 }
+                if (rampup_interval > 0)
+                    rampup_sleep();
             }
-        }        
+            j++;
+        } while (j < nr_jobs && !jobs[j].stonewall);
+        
+        for (i = first; i < n; i++) {
+            if (pthread_join(g_tid[i], NULL) != 0)
+                perror("thread wait error.\n");
+        }
     }
-    for (i = 0; i< thread_count; i++) {
-        if (pthread_join(g_tid[i], NULL) != 0)
-            perror("thread wait error.\n");
+    if (sampling_enabled())
+        report_stop();
+    if (ss_window > 0)
+        steady_stop();
+    if (threads[0].trace != NULL && trace_stop() != 0) {
+        perror("start_io_threads:trace_stop()");
+        exit(errno);
     }
     
+    for (j = 0, n = 0; j < nr_jobs; j++) {
+        merge_job_stats(&jobs[j], &threads[n]);
+        n += jobs[j].thread_count;
+    }
+    
+    /* the jobs keep pointing into threads for the JSON results */
     if (g_tid != NULL)
         free(g_tid);
 }
 
+/*
+ * --sweep: run <job>, not finalized yet, as the only job and merge the
+ * stats of its threads into it. Release them with free_job_stats().
+ */
+void run_single_job(struct job *job)
+{
+    jobs[0] = *job;
+    jobs[0].index = 0;
+    nr_jobs = 1;
+    finalize_job(&jobs[0]);
+    start_io_threads();
+    *job = jobs[0];
+}
+
+void free_job_stats(struct job *job)
+{
+    free(job->threads);
+    free(job->total_bs_hist);
+    free(job->iops_samples);
+    free(job->bw_samples);
+    job->threads = NULL;
+    job->total_bs_hist = NULL;
+    job->iops_samples = job->bw_samples = NULL;
+    job->nr_samples = job->max_samples = 0;
+}
+
+/*
+ * "affinity:" lines, one per thread: the CPUs it was allowed on and the CPU
+ * and node it started its IO on.
+ */
+static void print_affinity_lines(const struct job *job)
+{
+    char list[MAX_CPU_LIST_LENGTH];
+    struct cpu_list cpus;
+    int i;
+
+    for (i = 0; i < job->thread_count; i++) {
+        const struct thread_data *td = &job->threads[i];
+        if (job->cpus_allowed.nr > 0) {
+            thread_cpus(job, i, &cpus);
+            cpu_list_format(&cpus, list, sizeof(list));
+        } else {
+            strcpy(list, "all");
+        }
+        fprintf(GET_OUTPUT(output_file), "affinity: thread %d , "
+                "cpus_allowed %s , cpu %d , node %d , mem_node %d\n",
+                td->thread_id, list, td->cpu, td->node,
+                job->numa_node >= 0 ? job->numa_node : td->node);
+    }
+}
+
+static void print_job_results(struct job *job)
+{
+    if (nr_jobs > 1)
+        fprintf(GET_OUTPUT(output_file), "job: name %s\n", job->name);
+    print_count_line("summary", job->page_size, job->total_hist,
+                     &job->total_hist[DDIR_TOTAL], human_readable);
+    print_latency_line("latency:", job->total_hist, human_readable);
+    if (job->flush != FLUSH_NONE)
+        print_flush_line(job, human_readable);
+    if (job->ioengine->mapped)
+        print_mmap_line(job, human_readable);
+    print_bs_stats(job);
+    print_overhead_line(job, human_readable);
+    print_cpu_line(job, human_readable);
+    if (rate_enabled(job))
+        print_rate_line(job, human_readable);
+    if (job->replay != NULL)
+        print_replay_line(job, human_readable);
+    if (job->meta > 0)
+        print_meta_lines(job, human_readable);
+    if (job->nr_targets > 0)
+        print_target_lines(job, human_readable);
+    if (affinity_enabled(job))
+        print_affinity_lines(job);
+    if (job->verify > 0)
+        print_verify_line(job, human_readable);
+    if (job->full_coverage > 0)
+        fprintf(GET_OUTPUT(output_file), "coverage: blocks %llu , "
+                "full_passes %llu\n",
+                (unsigned long long)job->block_perm.nblocks,
+                (unsigned long long)job->coverage_passes);
+    if (hist_dump_enabled > 0) {
+        char tag[MAX_JOB_NAME_LENGTH + 8];
+        snprintf(tag, sizeof(tag), "%sr", hist_prefix(job));
+        hist_dump(GET_OUTPUT(output_file), tag, &job->total_hist[DDIR_READ]);
+        snprintf(tag, sizeof(tag), "%sw", hist_prefix(job));
+        hist_dump(GET_OUTPUT(output_file), tag, &job->total_hist[DDIR_WRITE]);
+        snprintf(tag, sizeof(tag), "%st", hist_prefix(job));
+        hist_dump(GET_OUTPUT(output_file), tag, &job->total_hist[DDIR_TOTAL]);
+    }
+}
+
+/*
+ * The text results after the run. Return the number of regressions found
+ * by --compare.
+ */
+static int print_text_results(void)
+{
+    int i;
+
+    for (i = 0; i < nr_jobs; i++)
+        print_job_results(&jobs[i]);
+    if (ss_window > 0)
+        print_steady_line(human_readable);
+    if (print_detail > 0 || trace_filename[0] != '\0')
+        fprintf(GET_OUTPUT(output_file), "trace: file %s , records %llu , "
+                "ring_full_stalls %llu\n",
+                trace_filename[0] != '\0' ? trace_filename : "-",
+                (unsigned long long)trace_records(),
+                (unsigned long long)trace_stalls());
+    if (compare_filename[0] != '\0')
+        return compare_baseline(compare_filename, NULL);
+    return 0;
+}
+
+/* latency stats of one histogram, with the buckets for merging and --compare */
+static void json_latency(struct json_writer *w, const char *key,
+                         const struct histogram *h)
+{
+    char name[32];
+    int i;
+
+    json_object_begin(w, key);
+    json_uint(w, "count", h->count);
+    json_double(w, "min_us", h->count == 0 ? 0.0 : h->min / 1000.0);
+    json_double(w, "max_us", h->max / 1000.0);
+    json_double(w, "mean_us", hist_mean(h) / 1000.0);
+    json_double(w, "stddev_us", hist_stddev(h) / 1000.0);
+    json_object_begin(w, "percentiles_us");
+    for (i = 0; i < nr_percentiles; i++) {
+        snprintf(name, sizeof(name), "%g", percentiles[i]);
+        json_double(w, name, hist_percentile(h, percentiles[i]) / 1000.0);
+    }
+    json_object_end(w);
+    json_object_begin(w, "histogram");
+    json_int(w, "sub_bits", HIST_SUB_BITS);
+    json_int(w, "max_bits", HIST_MAX_BITS);
+    json_uint(w, "sum_ns", h->sum);
+    json_uint(w, "min_ns", h->count == 0 ? 0 : h->min);
+    json_uint(w, "max_ns", h->max);
+    json_array_begin(w, "buckets");     /* [index, count] of non-empty ones */
+    for (i = 0; i < HIST_NR_BUCKETS; i++) {
+        if (h->buckets[i] == 0)
+            continue;
+        json_array_begin(w, NULL);
+        json_int(w, NULL, i);
+        json_uint(w, NULL, h->buckets[i]);
+        json_array_end(w);
+    }
+    json_array_end(w);
+    json_object_end(w);
+    json_object_end(w);
+}
+
+/* read, write and total stats of h[] */
+static void json_rw_latency(struct json_writer *w, const struct histogram *h)
+{
+    json_latency(w, "read", &h[DDIR_READ]);
+    json_latency(w, "write", &h[DDIR_WRITE]);
+    json_latency(w, "total", &h[DDIR_TOTAL]);
+}
+
+static void json_host(struct json_writer *w, time_t start)
+{
+    struct utsname u;
+    char date[32];
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&start));
+    json_object_begin(w, "host");
+    if (uname(&u) == 0) {
+        json_string(w, "hostname", u.nodename);
+        json_string(w, "os", u.sysname);
+        json_string(w, "kernel", u.release);
+        json_string(w, "kernel_version", u.version);
+        json_string(w, "machine", u.machine);
+    }
+    json_int(w, "cpus", sysconf(_SC_NPROCESSORS_ONLN));
+    if (pages > 0 && page_size > 0)
+        json_uint(w, "memory_bytes", (uint64_t)pages * page_size);
+    json_string(w, "start_time", date);
+    json_object_end(w);
+}
+
+/* the values of print_option_values() */
+static void json_config(struct json_writer *w, const struct job *job)
+{
+    int i;
+
+    json_object_begin(w, "config");
+    json_int(w, "request_count", job->request_count);
+    json_string(w, "filename", job->filename);
+    json_int(w, "page_size", job->page_size);
+    json_int(w, "write_percent", job->write_percent);
+    json_int(w, "random_addr", job->random_addr);
+    json_int(w, "duration", job->duration);
+    json_int(w, "start_addr", (long long)job->start_addr);
+    json_int(w, "seek_span", (long long)job->seek_span);
+    json_int(w, "thread_count", job->thread_count);
+    json_int(w, "stonewall", job->stonewall);
+    json_int(w, "rampup_interval", rampup_interval);
+    json_int(w, "print_detail", print_detail);
+    json_string(w, "output_filename", output_filename);
+    json_string(w, "ioengine", job->ioengine_name);
+    json_int(w, "iodepth", job->iodepth);
+    json_int(w, "iodepth_batch", job->iodepth_batch);
+    json_int(w, "iodepth_batch_complete", job->iodepth_batch_complete);
+    json_int(w, "iodepth_batch_complete_max",
+             job->iodepth_batch_complete_max);
+    json_string(w, "mmap_sync", mmap_sync_names[job->mmap_sync]);
+    json_int(w, "fixedbufs", fixed_bufs);
+    json_int(w, "registerfiles", register_files);
+    json_int(w, "sqpoll", sqpoll);
+    json_array_begin(w, "percentiles");
+    for (i = 0; i < nr_percentiles; i++)
+        json_double(w, NULL, percentiles[i]);
+    json_array_end(w);
+    json_int(w, "hist_dump", hist_dump_enabled);
+    json_string(w, "clocksource", clocksource_name());
+    json_uint(w, "seed", rand_seed);
+    json_string(w, "random_distribution",
+                job->offset_dist.type == DIST_UNIFORM ? "random"
+                                                      : job->offset_dist.spec);
+    json_int(w, "full_coverage", job->full_coverage);
+    json_string(w, "seq_layout", seq_layout_names[job->seq_layout]);
+    json_string(w, "bs", job->bs_spec.mode == BS_FIXED ? "fixed"
+                                                       : job->bs_spec.spec);
+    json_int(w, "bs_align", job->bs_spec.align);
+    json_int(w, "rate_iops", job->rate_iops);
+    json_int(w, "rate_bw", job->rate_bw);
+    json_string(w, "rate_scope", job->rate_global > 0 ? "global" : "thread");
+    json_string(w, "rate_process",
+                job->rate_process == RATE_POISSON ? "poisson" : "constant");
+    json_string(w, "cpus_allowed",
+                job->cpus_allowed.nr > 0 ? job->cpus_allowed_spec : "all");
+    json_string(w, "cpus_allowed_policy", job->cpus_split ? "split"
+                                                          : "shared");
+    json_int(w, "numa_node", job->numa_node);
+    json_int(w, "verify", job->verify);
+    json_int(w, "verify_interval", job->verify_interval);
+    json_int(w, "verify_pass", job->verify_pass);
+    json_double(w, "compress_ratio", job->compress_ratio);
+    json_int(w, "dedupe_percent", job->dedupe_percent);
+    json_string(w, "replay", job->replay_filename);
+    json_double(w, "replay_speed", job->replay_speed);
+    json_int(w, "direct", job->direct);
+    json_string(w, "sync", sync_mode_names[job->sync_mode]);
+    json_string(w, "flush", flush_names[job->flush]);
+    json_int(w, "flush_every", job->flush_every);
+    json_int(w, "flush_bytes", job->flush_bytes);
+    json_string(w, "meta_mix", job->meta ? job->meta_mix_spec : "none");
+    json_int(w, "meta_fanout", job->meta_fanout);
+    json_int(w, "meta_depth", job->meta_depth);
+    json_int(w, "meta_files", job->meta_files);
+    json_int(w, "meta_file_size", job->meta_file_size);
+    json_int(w, "meta_fsync", job->meta_fsync);
+    json_string(w, "target_mode", target_mode_names[job->target_mode]);
+    json_int(w, "stripe_size", job->stripe_size);
+    json_int(w, "target_threads", job->target_threads);
+    json_object_end(w);
+}
+
+static void json_threads(struct json_writer *w, const struct job *job)
+{
+    int i;
+
+    json_array_begin(w, "threads");
+    for (i = 0; i < job->thread_count; i++) {
+        const struct thread_data *td = &job->threads[i];
+        struct histogram *h = malloc(sizeof(struct histogram) *
+                                     (DDIR_TOTAL + 1));
+        if (h == NULL) {
+            perror("json_threads:malloc()");
+            exit(errno);
+        }
+        h[DDIR_READ] = td->hist[DDIR_READ];
+        h[DDIR_WRITE] = td->hist[DDIR_WRITE];
+        hist_init(&h[DDIR_TOTAL]);
+        hist_merge(&h[DDIR_TOTAL], &h[DDIR_READ]);
+        hist_merge(&h[DDIR_TOTAL], &h[DDIR_WRITE]);
+
+        json_object_begin(w, NULL);
+        json_int(w, "thread_id", td->thread_id);
+        json_int(w, "cpu", td->cpu);
+        json_int(w, "node", td->node);
+        json_double(w, "runtime_s",
+                    (td->end_ns - td->start_ns) / (double)NSEC_PER_SEC);
+        json_double(w, "wait_s", td->wait_ns / (double)NSEC_PER_SEC);
+        json_uint(w, "read_bytes", td->io_bytes[DDIR_READ]);
+        json_uint(w, "write_bytes", td->io_bytes[DDIR_WRITE]);
+        json_rw_latency(w, h);
+        json_object_end(w);
+        free(h);
+    }
+    json_array_end(w);
+}
+
+static void json_job_results(struct json_writer *w, const struct job *job)
+{
+    uint64_t ios = job->total_hist[DDIR_TOTAL].count;
+    uint64_t per_io = ios == 0 ? 0 : job->total_overhead_ns / ios;
+    double secs = job->wall_ns / (double)NSEC_PER_SEC;
+    int i;
+
+    json_object_begin(w, NULL);
+    json_string(w, "name", job->name);
+    json_config(w, job);
+
+    json_object_begin(w, "summary");
+    json_double(w, "runtime_s", secs);
+    json_uint(w, "bytes", job->total_bytes);
+    json_double(w, "iops", secs > 0 ? ios / secs : 0.0);
+    json_double(w, "bw_bytes", secs > 0 ? job->total_bytes / secs : 0.0);
+    json_rw_latency(w, job->total_hist);
+    json_object_end(w);
+
+    if (job->bs_spec.nr_classes > 1) {
+        json_array_begin(w, "bs");
+        for (i = 0; i < job->bs_spec.nr_classes; i++) {
+            json_object_begin(w, NULL);
+            json_int(w, "size", job->bs_spec.class_size[i]);
+            json_rw_latency(w, &job->total_bs_hist[i * (DDIR_TOTAL + 1)]);
+            json_object_end(w);
+        }
+        json_array_end(w);
+    }
+
+    json_object_begin(w, "overhead");
+    json_string(w, "clocksource", clocksource_name());
+    json_uint(w, "clock_read_ns", clock_read_cost());
+    json_uint(w, "per_io_ns", per_io);
+    json_double(w, "busy_percent", job->total_run_ns == 0 ? 0.0 :
+                100.0 * job->total_overhead_ns / job->total_run_ns);
+    json_object_end(w);
+    cpu_json(w, job);
+
+    if (rate_enabled(job)) {
+        int scale = job->rate_global > 0 ? 1 : job->thread_count;
+        json_object_begin(w, "rate");
+        json_int(w, "target_iops", job->rate_iops * scale);
+        json_int(w, "target_bw", job->rate_bw * scale);
+        json_double(w, "avg_lag_us",
+                    ios == 0 ? 0.0 : job->total_lag_ns / 1000.0 / ios);
+        json_double(w, "max_lag_us", job->max_lag_ns / 1000.0);
+        json_object_end(w);
+    }
+    if (job->full_coverage > 0) {
+        json_object_begin(w, "coverage");
+        json_uint(w, "blocks", job->block_perm.nblocks);
+        json_uint(w, "full_passes", job->coverage_passes);
+        json_object_end(w);
+    }
+    if (job->verify > 0)
+        verify_json(w, job);
+    if (job->flush != FLUSH_NONE) {
+        json_object_begin(w, "flush");
+        json_string(w, "call", flush_names[job->flush]);
+        json_int(w, "every", job->flush_every);
+        json_int(w, "bytes", job->flush_bytes);
+        json_latency(w, "latency", &job->flush_hist);
+        json_object_end(w);
+    }
+    if (job->ioengine->mapped)
+        mmap_json(w, job);
+    if (job->replay != NULL)
+        replay_json(w, job);
+    if (job->meta > 0) {
+        json_object_begin(w, "metadata");
+        json_uint(w, "leaf_dirs", meta_leaf_dirs(job));
+        json_uint(w, "ops", ios);
+        json_double(w, "ops_per_sec", secs > 0 ? ios / secs : 0.0);
+        for (i = 0; i < META_NR_OPS; i++)
+            if (job->meta_mix[i] > 0 || job->meta_hist[i].count > 0)
+                json_latency(w, meta_op_names[i], &job->meta_hist[i]);
+        json_object_end(w);
+    }
+    if (job->nr_targets > 0)
+        target_json(w, job);
+    json_threads(w, job);
+
+    /* throughput of each sample interval, the data of --compare */
+    json_object_begin(w, "intervals");
+    json_int(w, "interval_ms", report_sample_interval());
+    json_array_begin(w, "iops");
+    for (i = 0; i < job->nr_samples; i++)
+        json_double(w, NULL, job->iops_samples[i]);
+    json_array_end(w);
+    json_array_begin(w, "bw_bytes");
+    for (i = 0; i < job->nr_samples; i++)
+        json_double(w, NULL, job->bw_samples[i]);
+    json_array_end(w);
+    json_object_end(w);
+
+    json_object_end(w);
+}
+
+/*
+ * --output-format json: everything in one document. Return the number of
+ * regressions found by --compare.
+ */
+static int print_json_results(time_t start)
+{
+    struct json_writer w;
+    int i, regressions = 0;
+
+    json_begin(&w, GET_OUTPUT(output_file));
+    json_object_begin(&w, NULL);
+    json_host(&w, start);
+    json_array_begin(&w, "jobs");
+    for (i = 0; i < nr_jobs; i++)
+        json_job_results(&w, &jobs[i]);
+    json_array_end(&w);
+    if (precondition_passes >= 0)
+        precondition_json(&w);
+    if (ss_window > 0)
+        steady_json(&w);
+    if (print_detail > 0 || trace_filename[0] != '\0') {
+        json_object_begin(&w, "trace");
+        json_string(&w, "file", trace_filename);
+        json_uint(&w, "records", trace_records());
+        json_uint(&w, "ring_full_stalls", trace_stalls());
+        json_object_end(&w);
+    }
+    if (compare_filename[0] != '\0')
+        regressions = compare_baseline(compare_filename, &w);
+    json_object_end(&w);
+    json_end(&w);
+    return regressions;
+}
+
 int main(int argc, char **argv)
 {
+    time_t start = time(NULL);
+    int i, j, regressions = 0;
+    
     atexit(close_file);
     
     get_options(argc, argv);
-    print_option_values();
+    if (trace_convert_filename[0] != '\0') {
+        int ret = trace_convert(trace_convert_filename,
+                                GET_OUTPUT(output_file));
+        if (ret == -1) {
+            perror("trace_convert()");
+            exit(errno);
+        }
+        if (ret == -2) {
+            printf("%s is not an iombench trace file.\n",
+                   trace_convert_filename);
+            exit(-37);
+        }
+        return 0;
+    }
+    if (clock_init() != 0) {
+        fprintf(stderr, "failed to initialize clock source %s.\n",
+                clocksource_name());
+        exit(-19);
+    }
+    verify_init();
+    if (output_format == OUTPUT_TEXT)
+        for (i = 0; i < nr_jobs; i++)
+            print_option_values(&jobs[i]);
     
+    if (precondition_passes >= 0) {
+        /* once per target, with the first job that uses it */
+        for (i = 0; i < nr_jobs; i++) {
+            for (j = 0; j < i; j++)
+                if (strcmp(jobs[j].filename, jobs[i].filename) == 0)
+                    break;
+            if (j == i && jobs[i].meta == 0)
+                precondition(&jobs[i]);
+        }
+    }
+    if (sweep_enabled(&sweep_spec)) {
+        sweep_run(&sweep_spec, &cmdline_job);
+        return 0;
+    }
     start_io_threads();
     
-    fprintf(GET_OUTPUT(output_file), "summary: page_size %d , %s"
-           "[ read_count %ld , read_time(us) %ld , avg_latency(us) %ld ], %s"
-           "[ write_count %ld , write_time(us) %ld , avg_latency(us) %ld ], %s"
-           "[ total_count %ld , time(us) %ld , avg_latency(us) %ld ]\n",
-           page_size, human_readable, 
-           r_total_count, r_sum_time,
-           r_total_count == 0 ? 0 : r_sum_time / r_total_count, human_readable, 
-           w_total_count, w_sum_time,
-           w_total_count == 0 ? 0 : w_sum_time / w_total_count, human_readable, 
-           total_count, sum_time,
-           sum_time == 0 ? 0 : sum_time / total_count);
+    if (output_format == OUTPUT_JSON)
+        regressions = print_json_results(start);
+    else
+        regressions = print_text_results();
     
-    return 0;
+    /* a data integrity failure outranks a performance regression */
+    for (i = 0; i < nr_jobs; i++)
+        if (verify_errors(&jobs[i]) > 0)
+            return 2;
+    return regressions > 0 ? 1 : 0;
 }
-
@@ -0,0 +1,374 @@
+/*
+ *   iombench.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Definitions shared by the benchmark driver and the IO engines.
+ *   Include this header first in every source file.
+ */
+
+#ifndef IOMBENCH_H
+#define IOMBENCH_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#define _LARGEFILE64_SOURCE
+
+#ifdef __APPLE__
+#define lseek64 lseek
+#define open64 open
+#endif
+
+#define SECTOR_SIZE 512
+#define ASCII_PRINTABLE_LOW 32
+#define ASCII_PRINTABLE_HIGH 126
+#define MAX_FILE_NAME_LENGTH 1024
+#define MAX_ENGINE_NAME_LENGTH 32
+#define MAX_IODEPTH 4096
+#define MAX_JOBS 64
+#define MAX_JOB_NAME_LENGTH 64
+
+#define GET_OUTPUT(fd) ((fd) != NULL ? (fd) : stdout)
+
+/* --seq_layout, how threads share the range in sequential mode */
+#define SEQ_LAYOUT_SHARED 0
+#define SEQ_LAYOUT_SPLIT 1
+#define SEQ_LAYOUT_STRIDE 2
+
+/* --output-format */
+#define OUTPUT_TEXT 0
+#define OUTPUT_JSON 1
+
+/* --sync, the synchronous open flag of the target */
+#define SYNC_NONE 0
+#define SYNC_ODSYNC 1
+#define SYNC_OSYNC 2
+
+/* --flush */
+#define FLUSH_NONE 0
+#define FLUSH_FSYNC 1
+#define FLUSH_FDATASYNC 2
+#define FLUSH_SYNC_FILE_RANGE 3
+
+/* --mmap_sync */
+#define MMAP_SYNC_NONE 0
+#define MMAP_SYNC_MSYNC 1
+#define MMAP_SYNC_MAP_SYNC 2
+
+/* --rate_process */
+#define RATE_CONSTANT 0
+#define RATE_POISSON 1
+
+/* index of per-direction stats */
+#define DDIR_READ 0
+#define DDIR_WRITE 1
+#define DDIR_RW 2
+#define DDIR_TOTAL 2
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include "histogram.h"
+#include "rand.h"
+#include "dist.h"
+#include "blocksize.h"
+#include "affinity.h"
+#include "verify.h"
+#include "payload.h"
+#include "replay.h"
+#include "meta.h"
+#include "sweep.h"
+#include "cpustat.h"
+#include "target.h"
+
+/* for options, defined in iombench.c */
+extern char human_readable[2];
+extern char output_filename[MAX_FILE_NAME_LENGTH];
+extern FILE *output_file;
+extern int print_detail;
+extern int rampup_interval;
+extern int fixed_bufs;
+extern int register_files;
+extern int sqpoll;
+extern int sqpoll_idle;
+extern double percentiles[MAX_PERCENTILES];
+extern int nr_percentiles;
+extern int hist_dump_enabled;
+extern uint64_t rand_seed;
+extern char trace_filename[MAX_FILE_NAME_LENGTH];
+extern int report_interval;
+extern char report_filename[MAX_FILE_NAME_LENGTH];
+extern int report_format;
+extern int precondition_passes;
+extern int ss_window;
+extern int ss_interval;
+extern int ss_tolerance;
+extern int ss_max;
+extern int output_format;
+extern char compare_filename[MAX_FILE_NAME_LENGTH];
+extern double compare_threshold;
+extern struct sweep_spec sweep_spec;
+extern const char *seq_layout_names[];
+extern const char *mmap_sync_names[];
+extern const char *sync_mode_names[];
+extern const char *flush_names[];
+
+struct ioengine_ops;
+struct trace_ring;
+
+/*
+ * One workload. Without --jobfile the command line options make up the
+ * only job. A job file defines several named jobs, each starting from the
+ * command line values, that run concurrently or, with stonewall, after
+ * the jobs before them have finished. Stats are kept per job.
+ */
+struct job {
+    char name[MAX_JOB_NAME_LENGTH];
+    int index;
+    int stonewall;
+
+    char filename[MAX_FILE_NAME_LENGTH];    /* or a list, see target.h */
+    int target_fd;          /* opened once for all points of --sweep, or -1 */
+    struct target *targets; /* of a -f list once finalized, else NULL */
+    int nr_targets;
+    int target_mode;
+    long long stripe_size;
+    int target_threads;     /* per target, 0: -t in all */
+    int duration;
+    int duration_set;
+    int request_count;
+    int request_count_set;
+    int page_size;          /* the largest block size once finalized */
+    int write_percent;
+    int random_addr;
+    off_t start_addr;
+    off_t seek_span;        /* end of the address range */
+    int thread_count;
+
+    char ioengine_name[MAX_ENGINE_NAME_LENGTH];
+    const struct ioengine_ops *ioengine;
+    int iodepth;
+    int iodepth_batch;
+    int iodepth_batch_complete;
+    int iodepth_batch_complete_max;
+    int mmap_sync;
+
+    int direct;             /* O_DIRECT */
+    int sync_mode;
+    int flush;              /* call after flush_every writes or flush_bytes */
+    int flush_every;
+    long long flush_bytes;
+
+    struct offset_dist offset_dist;
+    int full_coverage;
+    struct block_perm block_perm;
+    int seq_layout;
+    struct bs_spec bs_spec;
+    int bs_align;
+
+    long long rate_iops;
+    long long rate_bw;      /* bytes per second */
+    int rate_global;
+    int rate_process;
+    double rate_ns_per_io;  /* per thread, from rate_iops */
+    double rate_ns_per_byte;
+
+    struct cpu_list cpus_allowed;
+    char cpus_allowed_spec[MAX_CPU_LIST_LENGTH];
+    int cpus_split;         /* one CPU of the list per thread */
+    int numa_node;          /* memory node of the buffers, or NUMA_NODE_* */
+
+    int verify;
+    int verify_interval;    /* 0 until finalized: the block alignment */
+    int verify_pass;
+    struct verify_state verify_state;
+
+    double compress_ratio;  /* 0 for the original iData pattern */
+    int dedupe_percent;
+
+    char replay_filename[MAX_FILE_NAME_LENGTH];
+    double replay_speed;    /* 0 as fast as possible */
+    struct replay *replay;
+
+    int meta;               /* --meta_mix given: a metadata job, see meta.h */
+    int meta_mix[META_NR_OPS];
+    char meta_mix_spec[MAX_FILE_NAME_LENGTH];
+    int meta_fanout;
+    int meta_depth;
+    int meta_files;         /* per thread */
+    int meta_file_size;
+    int meta_fsync;
+
+    /* stats, merged from the job's threads after they are joined */
+    struct histogram total_hist[DDIR_TOTAL + 1];
+    struct histogram *total_bs_hist;    /* [class][read, write, total] */
+    uint64_t total_run_ns;
+    uint64_t total_overhead_ns;
+    uint64_t coverage_passes;
+    uint64_t total_lag_ns;
+    uint64_t max_lag_ns;
+    uint64_t total_bytes;
+    uint64_t wall_ns;
+    struct histogram flush_hist;
+    struct histogram meta_hist[META_NR_OPS];
+    struct thread_data *threads;        /* kept for the per-thread results */
+
+    /* throughput per sample interval, see report.h */
+    double *iops_samples;
+    double *bw_samples;                 /* B/s */
+    int nr_samples;
+    int max_samples;
+};
+
+extern struct job *jobs;
+extern int nr_jobs;
+
+int open_target(const struct job *job);
+int open_target_path(const struct job *job, const char *path);
+void run_single_job(struct job *job);
+void free_job_stats(struct job *job);
+int set_job_option_by_name(struct job *job, const char *name,
+                           const char *value);
+
+/*
+ * One IO request. Each thread owns iodepth of them, each with its own
+ * buffer, and recycles them through a free list.
+ */
+struct io_u {
+    char *buf;
+    off_t offset;
+    int size;
+    int is_write;
+    int index;              /* slot in td->io_us */
+    int buf_index;          /* registered buffer of buf, see payload_iovecs() */
+    int file;               /* fd of the request in td->fds */
+    int bs_class;           /* block size class for per-size stats */
+    ssize_t result;         /* bytes transferred, or -errno */
+    uint64_t issue_ns;      /* set at submit for async engines */
+
+    /* --verify */
+    int inflight;
+    int verify_overlap;     /* overlapped a request of the thread, see verify.h */
+    uint64_t verify_time;   /* epoch ns in the headers of a write */
+
+    int pool_next;          /* --compress_ratio: next pool block of the slot */
+};
+
+/* per-thread state */
+struct thread_data {
+    struct job *job;
+    int thread_id;          /* within the job */
+    int fd;
+    int *fds;               /* by io_u->file, &fd but for striped targets */
+    int nr_fds;
+    const struct ioengine_ops *engine;
+    void *engine_data;
+
+    char *buffers;
+    struct io_u *io_us;
+    struct io_u **free_list;
+    int nr_free;
+    struct io_u **events;
+    struct io_u **queued_io_us;
+
+    long issued;
+    int inflight;
+    int queued;             /* queued to the engine but not yet committed */
+    off_t seq_cursor;
+    off_t seq_begin;        /* sequential IO wraps from seq_end back here */
+    off_t seq_end;
+    off_t seq_step;
+    int iData;
+    struct rand_state rand;
+    int cpu;                /* where the thread started its IO, -1 unknown */
+    int node;
+
+    /* --verify */
+    uint64_t verify_seq;
+    uint64_t verify_units;
+    uint64_t verify_unwritten;
+    uint64_t verify_pass_ns;
+    uint64_t verify_pass_bytes;
+
+    /* --flush: writes completed since the last flush */
+    uint64_t flush_writes;
+    uint64_t flush_written;
+    int flush_due;
+    struct histogram flush_hist;
+
+    /* CPU cost of the measured run */
+    struct cpu_stat cpu_stat;
+
+    /* -e mmap: page faults during the IO */
+    uint64_t minor_faults;
+    uint64_t major_faults;
+
+    /* --replay: the next request, taken before it is due */
+    struct replay_rec replay_rec;
+    int replay_pending;
+    int replay_done;
+
+    /* --meta_mix: latency per operation */
+    struct histogram *meta_hist;
+
+    /* -f list: the thread's target in thread mode, else -1, and stats */
+    int target;
+    struct histogram *target_hist;  /* [target][read, write] */
+    uint64_t *target_bytes;
+
+    /* --compress_ratio/--dedupe_percent, see payload.h */
+    char *pool;
+    int pool_blocks;        /* per request slot */
+    struct rand_state payload_rand;
+    uint64_t payload_stamp;
+    uint64_t dedupe_writes;
+
+    /* --full_coverage: this thread's slice of each pass */
+    uint64_t perm_keys[PERM_ROUNDS];
+    uint64_t perm_begin;
+    uint64_t perm_end;
+    uint64_t perm_pos;
+    uint64_t perm_pass;
+
+    /* timing, ns on the now_ns() clock */
+    uint64_t now;           /* latest timestamp taken by the IO loop */
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t wait_ns;       /* time blocked waiting for completions */
+
+    /* --steady_state: requests issued before measure_ns are not measured,
+     * only counted for the detector */
+    uint64_t measure_ns;
+    uint64_t warmup_ios;
+    uint64_t warmup_lat_ns;
+
+    /* --rate_iops/--rate_bw: open loop schedule */
+    struct rand_state rate_rand;
+    uint64_t next_issue_ns; /* intended start of the next request */
+    uint64_t lag_sum_ns;    /* actual minus intended start */
+    uint64_t lag_max_ns;
+    uint64_t io_bytes[DDIR_RW];
+
+    /* stats, latency in ns per direction */
+    struct histogram hist[DDIR_RW];
+    struct histogram *bs_hist;  /* [class][read, write], mixed sizes only */
+    struct trace_ring *trace;   /* -P or --trace only */
+};
+
+#endif /* IOMBENCH_H */
@@ -0,0 +1,142 @@
+/*
+ *   jobfile.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Job file parser.
+ */
+
+#include "iombench.h"
+#include "jobfile.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE_LENGTH 1024
+
+static char *trim(char *s)
+{
+    char *end;
+
+    while (isspace((unsigned char)*s))
+        s++;
+    end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1]))
+        end--;
+    *end = '\0';
+    return s;
+}
+
+/*
+ * Parse <path> into <jobs>, each starting from <base> and the [global]
+ * sections before it. Return the number of jobs; errors exit.
+ */
+int parse_job_file(const char *path, const struct job *base,
+                   struct job *jobs, int max_jobs)
+{
+    FILE *fp = fopen(path, "r");
+    struct job defaults = *base;
+    struct job *cur = NULL;     /* NULL outside of a job section */
+    char line[MAX_LINE_LENGTH];
+    int in_global = 0;
+    int lineno = 0;
+    int nr = 0;
+
+    if (fp == NULL) {
+        perror("parse_job_file:fopen()");
+        exit(errno);
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char *s, *value;
+        int ret;
+
+        lineno++;
+        s = trim(line);
+        if (*s == '\0' || *s == '#' || *s == ';')
+            continue;
+
+        if (*s == '[') {
+            char *end = strchr(s, ']');
+            if (end == NULL || end[1] != '\0' || end == s + 1 ||
+                end - s - 1 >= MAX_JOB_NAME_LENGTH) {
+                printf("%s:%d: bad section header %s.\n", path, lineno, s);
+                exit(-47);
+            }
+            *end = '\0';
+            s++;
+            if (strcmp(s, "global") == 0) {
+                in_global = 1;
+                cur = NULL;
+                continue;
+            }
+            if (nr == max_jobs) {
+                printf("%s:%d: more than %d jobs.\n", path, lineno, max_jobs);
+                exit(-48);
+            }
+            in_global = 0;
+            cur = &jobs[nr++];
+            *cur = defaults;
+            strcpy(cur->name, s);
+            cur->stonewall = 0;
+            continue;
+        }
+
+        if (!in_global && cur == NULL) {
+            printf("%s:%d: %s is outside of a section.\n", path, lineno, s);
+            exit(-49);
+        }
+        value = strchr(s, '=');
+        if (value != NULL) {
+            *value = '\0';
+            value = trim(value + 1);
+            s = trim(s);
+        }
+
+        if (strcmp(s, "stonewall") == 0) {
+            if (cur == NULL) {
+                printf("%s:%d: stonewall only applies to a job.\n",
+                       path, lineno);
+                exit(-50);
+            }
+            if (value != NULL && strcmp(value, "0") != 0 &&
+                strcmp(value, "1") != 0) {
+                printf("%s:%d: stonewall takes only 0 or 1.\n", path, lineno);
+                exit(-52);
+            }
+            cur->stonewall = value == NULL || strcmp(value, "1") == 0;
+            continue;
+        }
+        ret = set_job_option_by_name(cur != NULL ? cur : &defaults, s, value);
+        if (ret == -1) {
+            printf("%s:%d: %s is not a job option.\n", path, lineno, s);
+            exit(-51);
+        }
+        if (ret == -2) {
+            printf("%s:%d: %s %s.\n", path, lineno, s,
+                   value == NULL ? "needs a value" : "takes only 0 or 1");
+            exit(-52);
+        }
+    }
+    fclose(fp);
+
+    if (nr == 0) {
+        printf("%s: no jobs defined.\n", path);
+        exit(-53);
+    }
+    return nr;
+}
@@ -0,0 +1,46 @@
+/*
+ *   jobfile.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Job files (--jobfile), an ini style list of workloads:
+ *
+ *     ; comment
+ *     [global]
+ *     threads=4
+ *     [randread]
+ *     random
+ *     write_percent=0
+ *     [seqwrite]
+ *     stonewall
+ *     write_percent=100
+ *
+ *   Keys are the long names of the job options, "key=value" or a bare "key"
+ *   for the switches, which also take "key=1" and "key=0" to turn off one
+ *   set in [global]. [global] changes the defaults of the jobs after it,
+ *   every other section starts a job from them. Jobs run concurrently, a
+ *   job with stonewall starts after all jobs before it have finished.
+ */
+
+#ifndef JOBFILE_H
+#define JOBFILE_H
+
+struct job;
+
+int parse_job_file(const char *path, const struct job *base,
+                   struct job *jobs, int max_jobs);
+
+#endif /* JOBFILE_H */
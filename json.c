@@ -0,0 +1,410 @@
+/*
+ *   json.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   JSON writer and parser.
+ */
+
+#include "json.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* writer */
+
+static void put_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c == '\n')
+            fputs("\\n", out);
+        else if (c == '\t')
+            fputs("\\t", out);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+/* comma, newline and indentation before an item, then its key */
+static void begin_item(struct json_writer *w, const char *key)
+{
+    if (w->depth > 0) {
+        if (w->nr_items[w->depth]++ > 0)
+            fputc(',', w->out);
+        fprintf(w->out, "\n%*s", w->depth * 2, "");
+    }
+    if (key != NULL) {
+        put_string(w->out, key);
+        fputs(": ", w->out);
+    }
+}
+
+static void open_level(struct json_writer *w, const char *key, char bracket)
+{
+    begin_item(w, key);
+    fputc(bracket, w->out);
+    if (w->depth < JSON_MAX_DEPTH - 1)
+        w->depth++;
+    w->nr_items[w->depth] = 0;
+}
+
+static void close_level(struct json_writer *w, char bracket)
+{
+    int empty = w->nr_items[w->depth] == 0;
+
+    w->depth--;
+    if (!empty)
+        fprintf(w->out, "\n%*s", w->depth * 2, "");
+    fputc(bracket, w->out);
+}
+
+void json_begin(struct json_writer *w, FILE *out)
+{
+    w->out = out;
+    w->depth = 0;
+    w->nr_items[0] = 0;
+}
+
+void json_end(struct json_writer *w)
+{
+    fputc('\n', w->out);
+    fflush(w->out);
+}
+
+void json_object_begin(struct json_writer *w, const char *key)
+{
+    open_level(w, key, '{');
+}
+
+void json_object_end(struct json_writer *w)
+{
+    close_level(w, '}');
+}
+
+void json_array_begin(struct json_writer *w, const char *key)
+{
+    open_level(w, key, '[');
+}
+
+void json_array_end(struct json_writer *w)
+{
+    close_level(w, ']');
+}
+
+void json_string(struct json_writer *w, const char *key, const char *value)
+{
+    begin_item(w, key);
+    put_string(w->out, value);
+}
+
+void json_int(struct json_writer *w, const char *key, long long value)
+{
+    begin_item(w, key);
+    fprintf(w->out, "%lld", value);
+}
+
+void json_uint(struct json_writer *w, const char *key, uint64_t value)
+{
+    begin_item(w, key);
+    fprintf(w->out, "%llu", (unsigned long long)value);
+}
+
+/* JSON has no inf or nan */
+void json_double(struct json_writer *w, const char *key, double value)
+{
+    begin_item(w, key);
+    if (isfinite(value))
+        fprintf(w->out, "%.17g", value);
+    else
+        fputs("null", w->out);
+}
+
+void json_bool(struct json_writer *w, const char *key, int value)
+{
+    begin_item(w, key);
+    fputs(value ? "true" : "false", w->out);
+}
+
+/* parser, recursive descent over a buffer holding the whole file */
+
+struct parser {
+    const char *p;
+    int depth;
+};
+
+static struct json_value *parse_value(struct parser *ps);
+
+static void skip_space(struct parser *ps)
+{
+    while (isspace((unsigned char)*ps->p))
+        ps->p++;
+}
+
+static struct json_value *new_value(int type)
+{
+    struct json_value *v = calloc(1, sizeof(struct json_value));
+    if (v != NULL)
+        v->type = type;
+    return v;
+}
+
+/* a string at ps->p, escapes other than \uXXXX below 0x80 are kept as '?' */
+static char *parse_string(struct parser *ps)
+{
+    size_t len = 0, cap = 32;
+    char *s;
+
+    if (*ps->p != '"')
+        return NULL;
+    ps->p++;
+    s = malloc(cap);
+    if (s == NULL)
+        return NULL;
+    while (*ps->p != '"') {
+        char c = *ps->p++;
+        if (c == '\0')
+            goto err;
+        if (c == '\\') {
+            c = *ps->p++;
+            switch (c) {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'u': {
+                unsigned int cp;
+                if (sscanf(ps->p, "%4x", &cp) != 1)
+                    goto err;
+                ps->p += 4;
+                c = cp < 0x80 ? (char)cp : '?';
+                break;
+            }
+            case '"': case '\\': case '/':
+                break;
+            default:
+                goto err;
+            }
+        }
+        if (len + 2 > cap) {
+            char *n = realloc(s, cap *= 2);
+            if (n == NULL)
+                goto err;
+            s = n;
+        }
+        s[len++] = c;
+    }
+    ps->p++;
+    s[len] = '\0';
+    return s;
+err:
+    free(s);
+    return NULL;
+}
+
+/* members of an object or elements of an array, after the bracket */
+static struct json_value *parse_children(struct parser *ps,
+                                         struct json_value *v, char close)
+{
+    struct json_value **tail = &v->child;
+
+    skip_space(ps);
+    if (*ps->p == close) {
+        ps->p++;
+        return v;
+    }
+    for (;;) {
+        char *key = NULL;
+        struct json_value *c;
+
+        skip_space(ps);
+        if (v->type == JSON_OBJECT) {
+            key = parse_string(ps);
+            if (key == NULL)
+                goto err;
+            skip_space(ps);
+            if (*ps->p++ != ':') {
+                free(key);
+                goto err;
+            }
+        }
+        c = parse_value(ps);
+        if (c == NULL) {
+            free(key);
+            goto err;
+        }
+        c->key = key;
+        *tail = c;
+        tail = &c->next;
+
+        skip_space(ps);
+        if (*ps->p == ',') {
+            ps->p++;
+            continue;
+        }
+        if (*ps->p++ == close)
+            return v;
+        goto err;
+    }
+err:
+    json_free(v);
+    return NULL;
+}
+
+static struct json_value *parse_value(struct parser *ps)
+{
+    struct json_value *v;
+
+    skip_space(ps);
+    switch (*ps->p) {
+    case '{':
+    case '[':
+        if (++ps->depth > 64)
+            return NULL;
+        v = new_value(*ps->p == '{' ? JSON_OBJECT : JSON_ARRAY);
+        if (v == NULL)
+            return NULL;
+        ps->p++;
+        v = parse_children(ps, v, v->type == JSON_OBJECT ? '}' : ']');
+        ps->depth--;
+        return v;
+    case '"':
+        v = new_value(JSON_STRING);
+        if (v != NULL && (v->string = parse_string(ps)) == NULL) {
+            free(v);
+            v = NULL;
+        }
+        return v;
+    case 't':
+    case 'f':
+    case 'n': {
+        static const char *words[3] = { "true", "false", "null" };
+        int i;
+        for (i = 0; i < 3; i++) {
+            size_t len = strlen(words[i]);
+            if (strncmp(ps->p, words[i], len) == 0) {
+                ps->p += len;
+                v = new_value(i == 2 ? JSON_NULL : JSON_BOOL);
+                if (v != NULL)
+                    v->number = i == 0;
+                return v;
+            }
+        }
+        return NULL;
+    }
+    default: {
+        char *end;
+        double d = strtod(ps->p, &end);
+        if (end == ps->p)
+            return NULL;
+        ps->p = end;
+        v = new_value(JSON_NUMBER);
+        if (v != NULL)
+            v->number = d;
+        return v;
+    }
+    }
+}
+
+/* Parse a whole file. Return NULL with errno set, or errno 0 if malformed. */
+struct json_value *json_parse_file(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    struct json_value *v = NULL;
+    struct parser ps;
+    char *buf = NULL;
+    size_t len = 0, cap = 0, n;
+
+    if (fp == NULL)
+        return NULL;
+    do {
+        if (len + 4096 + 1 > cap) {
+            char *b = realloc(buf, cap = (cap + 4096) * 2);
+            if (b == NULL) {
+                free(buf);
+                fclose(fp);
+                return NULL;
+            }
+            buf = b;
+        }
+        n = fread(buf + len, 1, cap - len - 1, fp);
+        len += n;
+    } while (n > 0);
+    fclose(fp);
+    buf[len] = '\0';
+
+    ps.p = buf;
+    ps.depth = 0;
+    v = parse_value(&ps);
+    if (v != NULL) {
+        skip_space(&ps);
+        if (*ps.p != '\0') {
+            json_free(v);
+            v = NULL;
+        }
+    }
+    free(buf);
+    if (v == NULL)
+        errno = 0;
+    return v;
+}
+
+void json_free(struct json_value *v)
+{
+    while (v != NULL) {
+        struct json_value *next = v->next;
+        json_free(v->child);
+        free(v->string);
+        free(v->key);
+        free(v);
+        v = next;
+    }
+}
+
+struct json_value *json_get(const struct json_value *obj, const char *key)
+{
+    struct json_value *c;
+
+    if (obj == NULL || obj->type != JSON_OBJECT)
+        return NULL;
+    for (c = obj->child; c != NULL; c = c->next)
+        if (strcmp(c->key, key) == 0)
+            return c;
+    return NULL;
+}
+
+double json_get_number(const struct json_value *obj, const char *key,
+                       double def)
+{
+    struct json_value *v = json_get(obj, key);
+    return v != NULL && v->type == JSON_NUMBER ? v->number : def;
+}
+
+const char *json_get_string(const struct json_value *obj, const char *key)
+{
+    struct json_value *v = json_get(obj, key);
+    return v != NULL && v->type == JSON_STRING ? v->string : NULL;
+}
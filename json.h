@@ -0,0 +1,75 @@
+/*
+ *   json.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Minimal JSON support for --output-format json and --compare: a
+ *   streaming writer that handles commas and indentation, and a small DOM
+ *   parser for reading a baseline back. Numbers are doubles, which holds
+ *   every counter iombench writes exactly up to 2^53.
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define JSON_MAX_DEPTH 16
+
+struct json_writer {
+    FILE *out;
+    int depth;
+    int nr_items[JSON_MAX_DEPTH];   /* items written at each level */
+};
+
+/* key is NULL for array elements and the top level value */
+void json_begin(struct json_writer *w, FILE *out);
+void json_end(struct json_writer *w);
+void json_object_begin(struct json_writer *w, const char *key);
+void json_object_end(struct json_writer *w);
+void json_array_begin(struct json_writer *w, const char *key);
+void json_array_end(struct json_writer *w);
+void json_string(struct json_writer *w, const char *key, const char *value);
+void json_int(struct json_writer *w, const char *key, long long value);
+void json_uint(struct json_writer *w, const char *key, uint64_t value);
+void json_double(struct json_writer *w, const char *key, double value);
+void json_bool(struct json_writer *w, const char *key, int value);
+
+#define JSON_NULL 0
+#define JSON_BOOL 1
+#define JSON_NUMBER 2
+#define JSON_STRING 3
+#define JSON_ARRAY 4
+#define JSON_OBJECT 5
+
+struct json_value {
+    int type;
+    double number;              /* also 0/1 for JSON_BOOL */
+    char *string;
+    char *key;                  /* member name inside an object */
+    struct json_value *child;   /* first element or member */
+    struct json_value *next;
+};
+
+struct json_value *json_parse_file(const char *path);
+void json_free(struct json_value *v);
+struct json_value *json_get(const struct json_value *obj, const char *key);
+double json_get_number(const struct json_value *obj, const char *key,
+                       double def);
+const char *json_get_string(const struct json_value *obj, const char *key);
+
+#endif /* JSON_H */
@@ -0,0 +1,372 @@
+/*
+ *   meta.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   The directory tree and the operation loop of --meta_mix.
+ */
+
+#include "iombench.h"
+#include "meta.h"
+#include "gettime.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+const char *meta_op_names[META_NR_OPS] = {
+    "create", "read", "stat", "rename", "unlink"
+};
+
+/* the file names of one thread, present ones first in order[] */
+struct meta_names {
+    uint32_t *dir;              /* leaf directory of each name */
+    uint32_t *gen;              /* changes with every create and rename */
+    uint32_t *order;
+    uint32_t *pos;              /* index of each name in order[] */
+    uint32_t nr;
+    uint32_t present;
+};
+
+/*
+ * Parse "create:40,stat:30,unlink:30" into mix[], percent per op. The
+ * percentages must add up to 100. Return 0, or -1 on malformed input.
+ */
+int meta_parse_mix(int *mix, const char *spec)
+{
+    char copy[256];
+    char *save, *tok;
+    int op, sum = 0;
+
+    if (strlen(spec) >= sizeof(copy))
+        return -1;
+    strcpy(copy, spec);
+    memset(mix, 0, sizeof(int) * META_NR_OPS);
+    for (tok = strtok_r(copy, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        char *colon = strchr(tok, ':');
+        char *end;
+        long pct;
+        if (colon == NULL)
+            return -1;
+        *colon = '\0';
+        for (op = 0; op < META_NR_OPS; op++)
+            if (strcmp(tok, meta_op_names[op]) == 0)
+                break;
+        pct = strtol(colon + 1, &end, 10);
+        if (op == META_NR_OPS || end == colon + 1 || *end != '\0' ||
+            pct < 0 || pct > 100)
+            return -1;
+        mix[op] += (int)pct;
+        sum += (int)pct;
+    }
+    return sum == 100 ? 0 : -1;
+}
+
+/* fanout^depth, or 0 if that exceeds META_MAX_DIRS */
+uint32_t meta_leaf_dirs(const struct job *job)
+{
+    uint64_t n = 1;
+    int i;
+
+    for (i = 0; i < job->meta_depth; i++) {
+        n *= job->meta_fanout;
+        if (n > META_MAX_DIRS)
+            return 0;
+    }
+    return (uint32_t)n;
+}
+
+/* "<root>/d<a>/d<b>..." of directory <index> at <level> of the tree */
+static int dir_path(const struct job *job, int level, uint32_t index,
+                    char *buf, size_t len)
+{
+    uint32_t digits[32];
+    int i, n;
+
+    for (i = level - 1; i >= 0; i--) {
+        digits[i] = index % job->meta_fanout;
+        index /= job->meta_fanout;
+    }
+    n = snprintf(buf, len, "%s", job->filename);
+    for (i = 0; i < level && n < (int)len; i++)
+        n += snprintf(buf + n, len - n, "/d%u", digits[i]);
+    return n < (int)len ? 0 : -1;
+}
+
+/*
+ * Create the root and the directory tree of a finalized job, directories
+ * left by an earlier run are reused. Return 0, or -errno with a message
+ * printed.
+ */
+int meta_setup_job(const struct job *job)
+{
+    char path[MAX_FILE_NAME_LENGTH];
+    uint32_t count = 1, i;
+    int level;
+
+    for (level = 0; level <= job->meta_depth; level++) {
+        for (i = 0; i < count; i++) {
+            if (dir_path(job, level, i, path, sizeof(path)) != 0)
+                return -ENAMETOOLONG;
+            if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+                int err = errno;
+                perror("meta_setup_job:mkdir()");
+                return -err;
+            }
+        }
+        count *= job->meta_fanout;
+    }
+    return 0;
+}
+
+static void file_path(const struct thread_data *td,
+                      const struct meta_names *f, uint32_t slot, char *buf,
+                      size_t len)
+{
+    const struct job *job = td->job;
+    int n;
+
+    dir_path(job, job->meta_depth, f->dir[slot], buf, len);
+    n = strlen(buf);
+    snprintf(buf + n, len - n, "/j%d.t%d.%u.%u", job->index, td->thread_id,
+             slot, f->gen[slot]);
+}
+
+/* move <slot> to the present or the absent side of order[] */
+static void mark(struct meta_names *f, uint32_t slot, int present)
+{
+    uint32_t edge = present ? f->present : f->present - 1;
+    uint32_t other = f->order[edge];
+    uint32_t at = f->pos[slot];
+
+    f->order[edge] = slot;
+    f->pos[slot] = edge;
+    f->order[at] = other;
+    f->pos[other] = at;
+    f->present += present ? 1 : -1;
+}
+
+static void meta_fail(const char *what, const char *path)
+{
+    fprintf(stderr, "metadata %s of %s failed: %s\n", what, path,
+            strerror(errno));
+    exit(errno);
+}
+
+static void create_file(struct thread_data *td, const char *path, int sync)
+{
+    const struct job *job = td->job;
+    int fd = open(path, O_CREAT | O_EXCL | O_WRONLY, 0644);
+    ssize_t done = 0;
+
+    if (fd < 0)
+        meta_fail("create", path);
+    while (done < job->meta_file_size) {
+        ssize_t ret = write(fd, td->buffers + done,
+                            job->meta_file_size - done);
+        if (ret <= 0)
+            meta_fail("write", path);
+        done += ret;
+    }
+    if (sync && fsync(fd) != 0)
+        meta_fail("fsync", path);
+    close(fd);
+}
+
+static ssize_t read_file(struct thread_data *td, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    ssize_t ret, total = 0;
+
+    if (fd < 0)
+        meta_fail("open", path);
+    while ((ret = read(fd, td->buffers, td->job->meta_file_size)) > 0)
+        total += ret;
+    if (ret < 0)
+        meta_fail("read", path);
+    close(fd);
+    return total;
+}
+
+/* pick an op of the mix that the thread's files allow */
+static int next_op(struct thread_data *td, const struct meta_names *f)
+{
+    uint64_t r = rand_below(&td->rand, 100);
+    int op;
+
+    for (op = 0; op < META_NR_OPS - 1; op++) {
+        if (r < (uint64_t)td->job->meta_mix[op])
+            break;
+        r -= td->job->meta_mix[op];
+    }
+    if (op != META_CREATE && f->present == 0)
+        return META_CREATE;
+    if (op == META_CREATE && f->present == f->nr)
+        return META_UNLINK;
+    return op;
+}
+
+static void account(struct thread_data *td, int op, uint64_t start,
+                    uint64_t bytes)
+{
+    uint64_t lat = td->now - start;
+    int ddir = op == META_READ || op == META_STAT ? DDIR_READ : DDIR_WRITE;
+
+    hist_add(&td->meta_hist[op], lat);
+    hist_add(&td->hist[ddir], lat);
+    __atomic_store_n(&td->io_bytes[ddir], td->io_bytes[ddir] + bytes,
+                     __ATOMIC_RELAXED);
+    td->wait_ns += lat;
+    td->issued++;
+}
+
+static int files_init(struct meta_names *f, const struct job *job)
+{
+    uint32_t i;
+
+    f->nr = (uint32_t)job->meta_files;
+    f->dir = calloc(f->nr, sizeof(uint32_t));
+    f->gen = calloc(f->nr, sizeof(uint32_t));
+    f->order = malloc(sizeof(uint32_t) * f->nr);
+    f->pos = malloc(sizeof(uint32_t) * f->nr);
+    if (f->dir == NULL || f->gen == NULL || f->order == NULL ||
+        f->pos == NULL)
+        return -1;
+    for (i = 0; i < f->nr; i++)
+        f->order[i] = f->pos[i] = i;
+    f->present = 0;
+    return 0;
+}
+
+static void files_free(struct meta_names *f)
+{
+    free(f->dir);
+    free(f->gen);
+    free(f->order);
+    free(f->pos);
+}
+
+/*
+ * The IO loop of a --meta_mix thread, in place of the request loop of
+ * do_io(). Runs until -d or -n like it.
+ */
+void meta_thread(struct thread_data *td)
+{
+    const struct job *job = td->job;
+    uint32_t leaves = meta_leaf_dirs(job);
+    char path[MAX_FILE_NAME_LENGTH], to[MAX_FILE_NAME_LENGTH];
+    struct meta_names f;
+    uint64_t stop_ns, start;
+    uint32_t i;
+    int op;
+
+    td->buffers = malloc(job->meta_file_size);
+    td->meta_hist = malloc(sizeof(struct histogram) * META_NR_OPS);
+    if (td->buffers == NULL || td->meta_hist == NULL ||
+        files_init(&f, job) != 0) {
+        perror("meta_thread:malloc()");
+        exit(errno);
+    }
+    for (op = 0; op < META_NR_OPS; op++)
+        hist_init(&td->meta_hist[op]);
+    memset(td->buffers, td->iData, job->meta_file_size);
+
+    /* half of the names exist before the run, not timed */
+    for (i = 0; i < f.nr / 2; i++) {
+        uint32_t slot = f.order[f.present];
+        f.dir[slot] = (uint32_t)rand_below(&td->rand, leaves);
+        file_path(td, &f, slot, path, sizeof(path));
+        create_file(td, path, 0);
+        mark(&f, slot, 1);
+    }
+
+    cpu_stat_open(&td->cpu_stat);
+    cpu_stat_begin(&td->cpu_stat);
+    td->start_ns = td->now = now_ns();
+    stop_ns = td->start_ns + (uint64_t)job->duration * NSEC_PER_SEC;
+    while (td->issued < job->request_count && td->now < stop_ns) {
+        uint32_t slot;
+        uint64_t bytes = 0;
+
+        op = next_op(td, &f);
+        if (op == META_CREATE)
+            slot = f.order[f.present + rand_below(&td->rand,
+                                                  f.nr - f.present)];
+        else
+            slot = f.order[rand_below(&td->rand, f.present)];
+
+        switch (op) {
+        case META_CREATE:
+            f.dir[slot] = (uint32_t)rand_below(&td->rand, leaves);
+            f.gen[slot]++;
+            file_path(td, &f, slot, path, sizeof(path));
+            start = now_ns();
+            create_file(td, path, job->meta_fsync);
+            bytes = job->meta_file_size;
+            mark(&f, slot, 1);
+            break;
+        case META_READ:
+            file_path(td, &f, slot, path, sizeof(path));
+            start = now_ns();
+            bytes = read_file(td, path);
+            break;
+        case META_STAT: {
+            struct stat st;
+            file_path(td, &f, slot, path, sizeof(path));
+            start = now_ns();
+            if (stat(path, &st) != 0)
+                meta_fail("stat", path);
+            break;
+        }
+        case META_RENAME:
+            file_path(td, &f, slot, path, sizeof(path));
+            f.dir[slot] = (uint32_t)rand_below(&td->rand, leaves);
+            f.gen[slot]++;
+            file_path(td, &f, slot, to, sizeof(to));
+            start = now_ns();
+            if (rename(path, to) != 0)
+                meta_fail("rename", path);
+            break;
+        default:
+            file_path(td, &f, slot, path, sizeof(path));
+            start = now_ns();
+            if (unlink(path) != 0)
+                meta_fail("unlink", path);
+            mark(&f, slot, 0);
+            break;
+        }
+        td->now = now_ns();
+        account(td, op, start, bytes);
+    }
+    td->end_ns = td->now;
+    cpu_stat_end(&td->cpu_stat);
+    cpu_stat_close(&td->cpu_stat);
+
+    /* leave the tree as it was found */
+    while (f.present > 0) {
+        uint32_t slot = f.order[f.present - 1];
+        file_path(td, &f, slot, path, sizeof(path));
+        unlink(path);
+        mark(&f, slot, 0);
+    }
+    files_free(&f);
+    free(td->buffers);
+    td->buffers = NULL;
+}
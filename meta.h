@@ -0,0 +1,64 @@
+/*
+ *   meta.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   File system metadata workload (--meta_mix). -f names a directory; a
+ *   tree of --meta_depth levels with --meta_fanout subdirectories each is
+ *   created under it. Every thread owns --meta_files file names spread
+ *   over the leaf directories, half of them created before the run, and
+ *   draws operations from the mix:
+ *
+ *     create  open(O_CREAT | O_EXCL), write --meta_file_size bytes, fsync
+ *             unless --meta_fsync 0, close
+ *     read    open, read the whole file, close
+ *     stat    stat
+ *     rename  move to another leaf directory under a new name
+ *     unlink  unlink
+ *
+ *   An operation that needs a file when the thread has none, or a free name
+ *   when all exist, is replaced by create or unlink. Each operation has its
+ *   own latency histogram; create, rename and unlink also count as writes
+ *   and read and stat as reads, so the summary, interval and JSON results
+ *   show operations per second. The thread's files are removed afterwards.
+ */
+
+#ifndef META_H
+#define META_H
+
+#include <stdint.h>
+
+#define META_CREATE 0
+#define META_READ 1
+#define META_STAT 2
+#define META_RENAME 3
+#define META_UNLINK 4
+#define META_NR_OPS 5
+
+#define META_MAX_DIRS (1 << 20)     /* leaf directories */
+#define META_MAX_FILES (1 << 26)    /* per thread */
+
+struct job;
+struct thread_data;
+
+extern const char *meta_op_names[META_NR_OPS];
+
+int meta_parse_mix(int *mix, const char *spec);
+uint32_t meta_leaf_dirs(const struct job *job);
+int meta_setup_job(const struct job *job);
+void meta_thread(struct thread_data *td);
+
+#endif /* META_H */
@@ -0,0 +1,135 @@
+/*
+ *   payload.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   The write data pool of --compress_ratio and --dedupe_percent.
+ */
+
+#include "iombench.h"
+#include "payload.h"
+
+#include <string.h>
+#include <sys/uio.h>
+
+int payload_enabled(const struct job *job)
+{
+    return job->compress_ratio > 0 && job->write_percent > 0;
+}
+
+/* pool blocks per request slot */
+static int pool_blocks(const struct job *job)
+{
+    size_t per_slot = (size_t)job->page_size * job->iodepth;
+    size_t n = PAYLOAD_POOL_SIZE / per_slot;
+
+    return n > 0 ? (int)n : 1;
+}
+
+/* bytes to allocate after the request buffers, 0 without a pool */
+size_t payload_pool_size(const struct job *job)
+{
+    if (!payload_enabled(job))
+        return 0;
+    return (size_t)job->page_size *
+           (1 + (size_t)job->iodepth * pool_blocks(job));
+}
+
+/* random bytes then zeros in every segment */
+static void fill_block(char *buf, size_t len, double ratio,
+                       struct rand_state *rand)
+{
+    size_t random = (size_t)(PAYLOAD_SEGMENT / ratio + 0.5);
+    size_t off, i;
+
+    random = (random + PAYLOAD_STAMP - 1) / PAYLOAD_STAMP * PAYLOAD_STAMP;
+    if (random < PAYLOAD_STAMP)
+        random = PAYLOAD_STAMP;
+    for (off = 0; off < len; off += PAYLOAD_SEGMENT) {
+        for (i = 0; i < random; i += 8) {
+            uint64_t v = rand_u64(rand);
+            memcpy(buf + off + i, &v, 8);
+        }
+        memset(buf + off + random, 0, PAYLOAD_SEGMENT - random);
+    }
+}
+
+/*
+ * Fill the pool, before the thread's IO starts. The duplicate block comes
+ * from the job's seed alone, so all threads of a job write the same one.
+ */
+void payload_setup(struct thread_data *td, char *pool)
+{
+    const struct job *job = td->job;
+    struct rand_state dup;
+    size_t blocks = (size_t)job->iodepth * pool_blocks(job);
+
+    td->pool = pool;
+    td->pool_blocks = pool_blocks(job);
+    rand_init(&dup, rand_seed, ((uint64_t)job->index << 32) | 0xffffffffu);
+    fill_block(pool, job->page_size, job->compress_ratio, &dup);
+    fill_block(pool + job->page_size, blocks * job->page_size,
+               job->compress_ratio, &td->payload_rand);
+    td->payload_stamp = rand_u64(&td->payload_rand);
+}
+
+/* point a write at its data in the pool */
+void payload_fill(struct thread_data *td, struct io_u *io_u)
+{
+    const struct job *job = td->job;
+    int off;
+    char *buf;
+
+    if (job->dedupe_percent > 0 &&
+        rand_below(&td->payload_rand, 100) < (uint64_t)job->dedupe_percent) {
+        io_u->buf = td->pool;
+        io_u->buf_index = job->iodepth;
+        td->dedupe_writes++;
+        return;
+    }
+    buf = td->pool + (size_t)job->page_size *
+          (1 + (size_t)io_u->index * td->pool_blocks + io_u->pool_next);
+    if (++io_u->pool_next == td->pool_blocks)
+        io_u->pool_next = 0;
+    for (off = 0; off < io_u->size; off += PAYLOAD_SEGMENT) {
+        uint64_t v = splitmix64(&td->payload_stamp);
+        memcpy(buf + off, &v, PAYLOAD_STAMP);
+    }
+    io_u->buf = buf;
+    io_u->buf_index = job->iodepth + 1 + io_u->index;
+}
+
+/*
+ * The pool as registered buffers, following the iodepth request buffers:
+ * the duplicate block, then the blocks of each request slot. Return the
+ * number of iovecs filled.
+ */
+int payload_iovecs(const struct thread_data *td, struct iovec *iov)
+{
+    const struct job *job = td->job;
+    size_t slot_len = (size_t)job->page_size * td->pool_blocks;
+    int i;
+
+    if (td->pool == NULL)
+        return 0;
+    iov[0].iov_base = td->pool;
+    iov[0].iov_len = job->page_size;
+    for (i = 0; i < job->iodepth; i++) {
+        iov[1 + i].iov_base = td->pool + job->page_size + i * slot_len;
+        iov[1 + i].iov_len = slot_len;
+    }
+    return 1 + job->iodepth;
+}
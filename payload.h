@@ -0,0 +1,58 @@
+/*
+ *   payload.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Write data with a given compressibility and dedupability
+ *   (--compress_ratio, --dedupe_percent).
+ *
+ *   Each thread fills a pool once, before its IO starts. Every 512 byte
+ *   segment of the pool is random bytes followed by zeros, 1/ratio of it
+ *   random, so any compressor window sees the target ratio. Each request
+ *   slot owns a few pool blocks and its writes rotate through them: the
+ *   request points into the pool, nothing is copied. To keep the blocks
+ *   unique for a deduplicating target, a write stamps a fresh 8 byte value
+ *   at the start of each segment, which is all the per write work. A
+ *   write chosen to be a duplicate (--dedupe_percent) instead points at
+ *   one block that is never stamped, so all of them hold the same data.
+ *
+ *   Reads still go to the request slot's own buffer, so the pool is never
+ *   overwritten by data from the device.
+ */
+
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PAYLOAD_SEGMENT 512
+#define PAYLOAD_STAMP 8             /* bytes stamped per segment */
+#define PAYLOAD_MAX_RATIO ((double)PAYLOAD_SEGMENT / PAYLOAD_STAMP)
+#define PAYLOAD_POOL_SIZE (1 << 20) /* per thread, at least one block per slot */
+
+struct job;
+struct thread_data;
+struct io_u;
+struct iovec;
+
+int payload_enabled(const struct job *job);
+size_t payload_pool_size(const struct job *job);
+void payload_setup(struct thread_data *td, char *pool);
+void payload_fill(struct thread_data *td, struct io_u *io_u);
+int payload_iovecs(const struct thread_data *td, struct iovec *iov);
+
+#endif /* PAYLOAD_H */
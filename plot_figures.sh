@@ -73,36 +73,23 @@ done
 
 file_list_to_merge="$x_file "
 
-for rp in '' '-r'; do
-  for wp in '100' '0'; do
-    output_file="$output_dir/io_size_test_w_"$wp$rp
-
-    # req_size 512B to 64KB
-    for size in `seq 0 8`; do
-
-        if hash "bc" &> /dev/null; then
-
-          sector_num=`echo 2^$size | bc`
-
-        elif hash "python" &> /dev/null; then
+# request sizes 512B to 128KB as a --sweep_bs list
+sizes=`paste -s -d, $x_file`
 
-          sector_num=`python -c "print 2**$size"`
-        else
-          echo "Neither bc nor python is found."
-          exit
-        fi
-
-        echo "-w $wp $rp -p $sector_num" | tee -a $log_file
+# one process per pattern, each sweeps the sizes for reads and writes
+for rp in '' '-r'; do
+  output_file="$output_dir/io_size_sweep"$rp
 
-        $basedir/iombench -d ${duration:-2} -p $sector_num -o $output_file -w $wp $rp $other_iombench_opts
+  echo "--sweep_bs $sizes --sweep_read 0,100 $rp" | tee -a $log_file
 
-    done
+  $basedir/iombench -d ${duration:-2} --sweep_bs $sizes --sweep_read 0,100 -o $output_file $rp $other_iombench_opts
 
-    sleep 1
-    grep 'summary' $output_file | awk '{print $(NF-1)}' > $output_dir/w_$wp$rp.dat
+  # sweep,<bs>,<threads>,<iodepth>,<read_pct>,<iops>,<bw_bytes>,<mean_us>,...
+  for wp in '100' '0'; do
+    grep '^sweep,' $output_file | awk -F, -v rd=$((100 - wp)) '$5 == rd {print $8}' > $output_dir/w_$wp$rp.dat
     file_list_to_merge="${file_list_to_merge} $output_dir/w_$wp$rp.dat"
-
   done
+
 done
 
 plot_data_file="simple4.dat"
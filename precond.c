@@ -0,0 +1,376 @@
+/*
+ *   precond.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Preconditioning writers and the steady-state detector thread.
+ */
+
+#include "iombench.h"
+#include "precond.h"
+#include "gettime.h"
+#include "json.h"
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FILL_BLOCK_SIZE (1024 * 1024)
+#define STEADY_POLL_NS (10 * 1000 * 1000ULL)
+
+uint64_t measure_start_ns;
+
+struct precond_worker {
+    const struct job *job;
+    pthread_t tid;
+    int id;
+    int pass;                   /* 0: sequential fill, then random passes */
+    uint64_t bytes;
+};
+
+static struct block_perm precond_perm;
+
+/* one per preconditioned target, for the JSON results */
+static struct {
+    char filename[MAX_FILE_NAME_LENGTH];
+    double fill_secs;
+    double random_secs;
+    uint64_t bytes;
+} precond_results[MAX_JOBS];
+static int nr_precond_results;
+
+static void write_block(int fd, char *buf, size_t size, off_t offset)
+{
+    ssize_t ret = pwrite(fd, buf, size, offset);
+    if (ret < 0) {
+        perror("precondition:pwrite()");
+        exit(errno);
+    }
+}
+
+/*
+ * One thread's share of a pass: a contiguous slice of the range for the
+ * fill, a slice of the block permutation for a random pass.
+ */
+static void *precond_write(void *arg)
+{
+    struct precond_worker *w = arg;
+    const struct job *job = w->job;
+    struct rand_state st;
+    uint64_t keys[PERM_ROUNDS];
+    uint64_t i, begin, end;
+    char *buf;
+    int fd = open_target(job);
+
+    if (posix_memalign((void **)&buf, SECTOR_SIZE, FILL_BLOCK_SIZE)) {
+        perror("precondition:posix_memalign()");
+        exit(errno);
+    }
+    /* random data, so compressing or deduplicating devices store it all */
+    rand_init(&st, rand_seed ^ 0x5eed, w->id);
+    for (i = 0; i < FILL_BLOCK_SIZE / sizeof(uint64_t); i++)
+        ((uint64_t *)buf)[i] = rand_u64(&st);
+
+    if (w->pass == 0) {
+        uint64_t nfill = (job->seek_span - job->start_addr +
+                          FILL_BLOCK_SIZE - 1) / FILL_BLOCK_SIZE;
+        begin = nfill * w->id / job->thread_count;
+        end = nfill * (w->id + 1) / job->thread_count;
+        for (i = begin; i < end; i++) {
+            off_t offset = job->start_addr + (off_t)i * FILL_BLOCK_SIZE;
+            size_t size = job->seek_span - offset < FILL_BLOCK_SIZE ?
+                          (size_t)(job->seek_span - offset) : FILL_BLOCK_SIZE;
+            write_block(fd, buf, size, offset);
+            w->bytes += size;
+        }
+    } else {
+        perm_keys(keys, rand_seed ^ 0x5eed, w->pass);
+        begin = precond_perm.nblocks * w->id / job->thread_count;
+        end = precond_perm.nblocks * (w->id + 1) / job->thread_count;
+        for (i = begin; i < end; i++) {
+            off_t offset = job->start_addr + (off_t)perm_index(&precond_perm,
+                                                keys, i) * job->page_size;
+            write_block(fd, buf, job->page_size, offset);
+            w->bytes += job->page_size;
+        }
+    }
+    free(buf);
+    close(fd);
+    return NULL;
+}
+
+/* run one pass on all threads, return the seconds it took */
+static double run_pass(const struct job *job, struct precond_worker *workers,
+                       int pass)
+{
+    uint64_t t0 = now_ns();
+    int i;
+
+    for (i = 0; i < job->thread_count; i++) {
+        workers[i].job = job;
+        workers[i].id = i;
+        workers[i].pass = pass;
+        if (pthread_create(&workers[i].tid, NULL, precond_write,
+                           &workers[i]) != 0) {
+            perror("precondition:pthread_create()");
+            exit(errno);
+        }
+    }
+    for (i = 0; i < job->thread_count; i++)
+        pthread_join(workers[i].tid, NULL);
+    return (now_ns() - t0) / (double)NSEC_PER_SEC;
+}
+
+void precondition(const struct job *job)
+{
+    struct precond_worker *workers = calloc(job->thread_count,
+                                            sizeof(struct precond_worker));
+    double fill_secs, random_secs = 0;
+    uint64_t bytes = 0;
+    int i;
+
+    if (workers == NULL) {
+        perror("precondition:calloc()");
+        exit(errno);
+    }
+    perm_init(&precond_perm,
+              (job->seek_span - job->start_addr) / job->page_size);
+
+    fill_secs = run_pass(job, workers, 0);
+    for (i = 1; i <= precondition_passes; i++)
+        random_secs += run_pass(job, workers, i);
+    for (i = 0; i < job->thread_count; i++)
+        bytes += workers[i].bytes;
+    free(workers);
+
+    if (nr_precond_results < MAX_JOBS) {
+        i = nr_precond_results++;
+        strcpy(precond_results[i].filename, job->filename);
+        precond_results[i].fill_secs = fill_secs;
+        precond_results[i].random_secs = random_secs;
+        precond_results[i].bytes = bytes;
+    }
+    if (output_format == OUTPUT_JSON)
+        return;
+    fprintf(GET_OUTPUT(output_file), "precondition: fill(s) %.3f , "
+            "random_passes %d , random(s) %.3f , bytes_written %llu\n",
+            fill_secs, precondition_passes, random_secs,
+            (unsigned long long)bytes);
+    fflush(GET_OUTPUT(output_file));
+}
+
+void precondition_json(struct json_writer *w)
+{
+    int i;
+
+    json_array_begin(w, "precondition");
+    for (i = 0; i < nr_precond_results; i++) {
+        json_object_begin(w, NULL);
+        json_string(w, "filename", precond_results[i].filename);
+        json_double(w, "fill_s", precond_results[i].fill_secs);
+        json_int(w, "random_passes", precondition_passes);
+        json_double(w, "random_s", precond_results[i].random_secs);
+        json_uint(w, "bytes_written", precond_results[i].bytes);
+        json_object_end(w);
+    }
+    json_array_end(w);
+}
+
+/* steady state detector */
+
+static struct thread_data *steady_threads;
+static int steady_nr_threads;
+static pthread_t detector;
+static int steady_done;
+
+static struct {
+    int reached;
+    double secs;                /* from start to the end of the window */
+    int nr_samples;
+    double iops, iops_range, iops_slope;
+    double lat_us, lat_range, lat_slope;
+} steady;
+
+/*
+ * Mean of the window, and its range and the excursion of the least squares
+ * line across it, both as percent of the mean.
+ */
+static double window_stats(const double *y, int n, double *range,
+                           double *slope)
+{
+    double sx = 0, sy = 0, sxy = 0, sxx = 0, lo = y[0], hi = y[0], mean, b;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        sx += i;
+        sy += y[i];
+        sxy += i * y[i];
+        sxx += (double)i * i;
+        if (y[i] < lo)
+            lo = y[i];
+        if (y[i] > hi)
+            hi = y[i];
+    }
+    mean = sy / n;
+    b = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+    if (mean <= 0) {
+        *range = *slope = 100;
+        return mean;
+    }
+    *range = (hi - lo) / mean * 100;
+    *slope = fabs(b) * (n - 1) / mean * 100;
+    return mean;
+}
+
+static int steady_wait(uint64_t target)
+{
+    for (;;) {
+        uint64_t now = now_ns();
+        struct timespec ts;
+        uint64_t delta;
+
+        if (__atomic_load_n(&steady_done, __ATOMIC_ACQUIRE))
+            return -1;
+        if (now >= target)
+            return 0;
+        delta = target - now < STEADY_POLL_NS ? target - now : STEADY_POLL_NS;
+        ts.tv_sec = 0;
+        ts.tv_nsec = (long)delta;
+        nanosleep(&ts, NULL);
+    }
+}
+
+static void *steady_loop(void *arg)
+{
+    int w = ss_window;
+    double *iops = calloc(w, sizeof(double));
+    double *lat = calloc(w, sizeof(double));
+    uint64_t start = now_ns(), last = start, next = start;
+    uint64_t prev_ios = 0, prev_lat = 0;
+    uint64_t max_ns = (uint64_t)ss_max * NSEC_PER_SEC;
+    (void)arg;
+
+    if (iops == NULL || lat == NULL) {
+        perror("steady_loop:calloc()");
+        exit(errno);
+    }
+
+    for (;;) {
+        uint64_t ios = 0, lat_sum = 0, now;
+        int t;
+
+        next += (uint64_t)ss_interval * 1000 * 1000;
+        if (steady_wait(next) != 0)
+            break;
+
+        for (t = 0; t < steady_nr_threads; t++) {
+            ios += __atomic_load_n(&steady_threads[t].warmup_ios,
+                                   __ATOMIC_RELAXED);
+            lat_sum += __atomic_load_n(&steady_threads[t].warmup_lat_ns,
+                                       __ATOMIC_RELAXED);
+        }
+        now = now_ns();
+
+        /* slide the window */
+        memmove(iops, iops + 1, (w - 1) * sizeof(double));
+        memmove(lat, lat + 1, (w - 1) * sizeof(double));
+        iops[w - 1] = (ios - prev_ios) / ((now - last) /
+                                          (double)NSEC_PER_SEC);
+        lat[w - 1] = ios > prev_ios ? (lat_sum - prev_lat) /
+                     (double)(ios - prev_ios) / NSEC_PER_USEC : 0;
+        prev_ios = ios;
+        prev_lat = lat_sum;
+        last = now;
+        steady.nr_samples++;
+
+        if (steady.nr_samples >= w) {
+            steady.iops = window_stats(iops, w, &steady.iops_range,
+                                       &steady.iops_slope);
+            steady.lat_us = window_stats(lat, w, &steady.lat_range,
+                                         &steady.lat_slope);
+            steady.reached = steady.iops_range <= ss_tolerance &&
+                             steady.iops_slope <= ss_tolerance / 2.0 &&
+                             steady.lat_range <= ss_tolerance &&
+                             steady.lat_slope <= ss_tolerance / 2.0;
+        }
+        if (steady.reached || now - start >= max_ns) {
+            steady.secs = (now - start) / (double)NSEC_PER_SEC;
+            __atomic_store_n(&measure_start_ns, now, __ATOMIC_RELEASE);
+            break;
+        }
+    }
+    free(iops);
+    free(lat);
+    return NULL;
+}
+
+/*
+ * Watch the given threads until they are steady, then set
+ * measure_start_ns. Return 0, or -1 with errno set.
+ */
+int steady_start(struct thread_data *threads, int nr_threads)
+{
+    int ret;
+
+    steady_threads = threads;
+    steady_nr_threads = nr_threads;
+    ret = pthread_create(&detector, NULL, steady_loop, NULL);
+    if (ret != 0) {
+        errno = ret;
+        return -1;
+    }
+    return 0;
+}
+
+/* after the IO threads are joined, in case they ended before measuring */
+void steady_stop(void)
+{
+    __atomic_store_n(&steady_done, 1, __ATOMIC_RELEASE);
+    pthread_join(detector, NULL);
+}
+
+void print_steady_line(const char *sep)
+{
+    fprintf(GET_OUTPUT(output_file), "steady_state: reached %d , "
+            "time(s) %.3f , window %d , interval(ms) %d , %s"
+            "iops %.1f , iops_range(%%) %.2f , iops_slope(%%) %.2f , %s"
+            "latency(us) %.3f , latency_range(%%) %.2f , "
+            "latency_slope(%%) %.2f\n", steady.reached, steady.secs,
+            ss_window, ss_interval, sep, steady.iops, steady.iops_range,
+            steady.iops_slope, sep, steady.lat_us, steady.lat_range,
+            steady.lat_slope);
+}
+
+void steady_json(struct json_writer *w)
+{
+    json_object_begin(w, "steady_state");
+    json_bool(w, "reached", steady.reached);
+    json_double(w, "time_s", steady.secs);
+    json_int(w, "window", ss_window);
+    json_int(w, "interval_ms", ss_interval);
+    json_int(w, "tolerance_percent", ss_tolerance);
+    json_double(w, "iops", steady.iops);
+    json_double(w, "iops_range_percent", steady.iops_range);
+    json_double(w, "iops_slope_percent", steady.iops_slope);
+    json_double(w, "latency_us", steady.lat_us);
+    json_double(w, "latency_range_percent", steady.lat_range);
+    json_double(w, "latency_slope_percent", steady.lat_slope);
+    json_object_end(w);
+}
@@ -0,0 +1,53 @@
+/*
+ *   precond.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Device preconditioning and steady-state detection, in the spirit of the
+ *   SNIA Solid State Storage Performance Test Specification.
+ *
+ *   --precondition N writes [start_addr, seek_span) once sequentially and
+ *   then N times in random order (every block once per pass) before the
+ *   workload starts.
+ *
+ *   --steady_state W runs the workload unmeasured while a detector thread
+ *   samples IOPS and mean latency every --ss_interval ms. The device is
+ *   steady once, over the last W samples, both series stay within a range
+ *   of --ss_tolerance percent of their mean and the least squares line
+ *   through them moves less than half that. Measurement for -d seconds
+ *   starts then, or after --ss_max seconds if the device never settles.
+ */
+
+#ifndef PRECOND_H
+#define PRECOND_H
+
+#include <stdint.h>
+
+struct job;
+struct json_writer;
+struct thread_data;
+
+/* when measurement began, 0 while still waiting for steady state */
+extern uint64_t measure_start_ns;
+
+void precondition(const struct job *job);
+int steady_start(struct thread_data *threads, int nr_threads);
+void steady_stop(void);
+void print_steady_line(const char *sep);
+void precondition_json(struct json_writer *w);
+void steady_json(struct json_writer *w);
+
+#endif /* PRECOND_H */
@@ -0,0 +1,87 @@
+/*
+ *   rand.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Per-thread pseudo random numbers for workload generation: xoshiro256**
+ *   (Blackman and Vigna) seeded through splitmix64. Each IO thread owns its
+ *   own state, so there is no shared lock as with rand(), and a given seed
+ *   always produces the same offset and read/write sequence.
+ */
+
+#ifndef RAND_H
+#define RAND_H
+
+#include <stdint.h>
+
+struct rand_state {
+    uint64_t s[4];
+};
+
+static inline uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl64(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rand_u64(struct rand_state *st)
+{
+    uint64_t *s = st->s;
+    uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+    return result;
+}
+
+/* uniform in [0, n), Lemire's multiply-shift, no division */
+static inline uint64_t rand_below(struct rand_state *st, uint64_t n)
+{
+    return (uint64_t)(((unsigned __int128)rand_u64(st) * n) >> 64);
+}
+
+/* uniform in [0, 1) with 53 bits of precision */
+static inline double rand_double(struct rand_state *st)
+{
+    return (rand_u64(st) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Seed a stream. Streams with the same seed and different ids (one per
+ * thread) are independent but each is reproducible on its own.
+ */
+static inline void rand_init(struct rand_state *st, uint64_t seed,
+                             uint64_t id)
+{
+    uint64_t x = seed ^ (id * 0xd1342543de82ef95ULL);
+    int i;
+    for (i = 0; i < 4; i++)
+        st->s[i] = splitmix64(&x);
+}
+
+#endif /* RAND_H */
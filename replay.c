@@ -0,0 +1,333 @@
+/*
+ *   replay.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Trace readers, the reorder window and the replay schedule.
+ */
+
+#include "iombench.h"
+#include "replay.h"
+#include "trace.h"
+#include "gettime.h"
+#include "json.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FORMAT_TEXT 0           /* "io," records and blkparse, per line */
+#define FORMAT_BINARY 1
+
+struct replay {
+    FILE *fp;
+    int format;
+    char action;                /* blkparse event used, 0 until seen */
+    pthread_mutex_t lock;
+    int eof;
+
+    /* reorder window, a min-heap on the trace time */
+    struct replay_rec *heap;
+    int nr;
+
+    /* schedule */
+    double speed;
+    int started;
+    uint64_t first_ns;          /* trace time of the first request */
+    uint64_t last_ns;           /* latest trace time handed out */
+    uint64_t base_ns;           /* now_ns() when the first request was due */
+
+    /* where requests go: folded into [start, span), at most max_size */
+    uint64_t start;
+    uint64_t span;
+    uint32_t max_size;
+
+    uint64_t records;
+    uint64_t late;              /* older than one already handed out */
+    uint64_t folded;
+    uint64_t clipped;
+    uint64_t skipped;           /* lines that are neither requests nor events */
+};
+
+static void heap_push(struct replay *r, const struct replay_rec *rec)
+{
+    int i = r->nr++;
+
+    while (i > 0 && r->heap[(i - 1) / 2].ns > rec->ns) {
+        r->heap[i] = r->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    r->heap[i] = *rec;
+}
+
+static void heap_pop(struct replay *r, struct replay_rec *rec)
+{
+    struct replay_rec last = r->heap[--r->nr];
+    int i = 0;
+
+    *rec = r->heap[0];
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= r->nr)
+            break;
+        if (c + 1 < r->nr && r->heap[c + 1].ns < r->heap[c].ns)
+            c++;
+        if (last.ns <= r->heap[c].ns)
+            break;
+        r->heap[i] = r->heap[c];
+        i = c;
+    }
+    if (r->nr > 0)
+        r->heap[i] = last;
+}
+
+/*
+ * blkparse default output:
+ *   8,0    3        1     0.000000000  697  Q  WS 1234567 + 8 [jbd2]
+ * Return 0 for a read or write event of the chosen kind, 1 for other
+ * events, -1 for a line that is not an event.
+ */
+static int parse_blkparse(struct replay *r, const char *line,
+                          struct replay_rec *rec)
+{
+    unsigned int major, minor, cpu, pid, nsect;
+    unsigned long long seq, sector;
+    double secs;
+    char action[4], rwbs[16];
+
+    if (sscanf(line, "%u,%u %u %llu %lf %u %3s %15s %llu + %u", &major,
+               &minor, &cpu, &seq, &secs, &pid, action, rwbs, &sector,
+               &nsect) != 10)
+        return -1;
+    if (action[1] != '\0' || (action[0] != 'Q' && action[0] != 'D'))
+        return 1;
+    if (r->action == 0)
+        r->action = action[0];
+    if (action[0] != r->action || nsect == 0)
+        return 1;
+    if (strchr(rwbs, 'W') != NULL)
+        rec->is_write = 1;
+    else if (strchr(rwbs, 'R') != NULL)
+        rec->is_write = 0;
+    else
+        return 1;               /* discard, flush only */
+    rec->ns = (uint64_t)(secs * NSEC_PER_SEC + 0.5);
+    rec->offset = (uint64_t)sector * SECTOR_SIZE;
+    rec->size = nsect * SECTOR_SIZE;
+    return 0;
+}
+
+/* "io,<epoch s>,<r|w>,<size>,<offset>,<latency us>" */
+static int parse_io_record(const char *line, struct replay_rec *rec)
+{
+    long secs;
+    char dir;
+    unsigned int size;
+    long long offset;
+
+    if (sscanf(line, "io,%ld,%c,%u,%lld", &secs, &dir, &size, &offset) != 4 ||
+        (dir != 'r' && dir != 'w') || offset < 0 || size == 0)
+        return -1;
+    rec->ns = (uint64_t)secs * NSEC_PER_SEC;
+    rec->is_write = dir == 'w';
+    rec->size = size;
+    rec->offset = (uint64_t)offset;
+    return 0;
+}
+
+/* next request in file order. Return 0, or -1 at the end of the trace. */
+static int read_record(struct replay *r, struct replay_rec *rec)
+{
+    char line[REPLAY_LINE];
+
+    if (r->format == FORMAT_BINARY) {
+        struct trace_rec t;
+        if (fread(&t, sizeof(t), 1, r->fp) != 1)
+            return -1;
+        rec->ns = t.issue_ns;
+        rec->offset = t.offset;
+        rec->size = t.size;
+        rec->is_write = t.is_write;
+        return 0;
+    }
+    while (fgets(line, sizeof(line), r->fp) != NULL) {
+        const char *p = line;
+        int ret;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        ret = strncmp(p, "io,", 3) == 0 ? parse_io_record(p, rec)
+                                        : parse_blkparse(r, p, rec);
+        if (ret == 0)
+            return 0;
+        if (ret < 0 && *p != '\n' && *p != '\0')
+            r->skipped++;
+    }
+    return -1;
+}
+
+/*
+ * Open the trace of a finalized job. Return NULL with a message printed
+ * if it cannot be read.
+ */
+struct replay *replay_open(const struct job *job)
+{
+    struct replay *r = calloc(1, sizeof(struct replay));
+    struct trace_header hdr;
+
+    if (r == NULL)
+        return NULL;
+    r->heap = malloc(sizeof(struct replay_rec) * REPLAY_WINDOW);
+    r->fp = fopen(job->replay_filename, "rb");
+    if (r->heap == NULL || r->fp == NULL) {
+        perror("replay_open()");
+        replay_close(r);
+        return NULL;
+    }
+    setvbuf(r->fp, NULL, _IOFBF, REPLAY_BUFFER);
+    if (fread(&hdr, sizeof(hdr), 1, r->fp) == 1 &&
+        memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic)) == 0) {
+        if (hdr.record_size != sizeof(struct trace_rec)) {
+            printf("trace %s has records of %u bytes, expected %zu.\n",
+                   job->replay_filename, hdr.record_size,
+                   sizeof(struct trace_rec));
+            replay_close(r);
+            return NULL;
+        }
+        r->format = FORMAT_BINARY;
+    } else {
+        rewind(r->fp);
+        r->format = FORMAT_TEXT;
+    }
+    pthread_mutex_init(&r->lock, NULL);
+    r->speed = job->replay_speed;
+    r->start = (uint64_t)job->start_addr;
+    r->span = (uint64_t)job->seek_span;
+    r->max_size = (uint32_t)job->page_size;
+    return r;
+}
+
+/* keep a request inside [start, span) and the buffers */
+static void fit_record(struct replay *r, struct replay_rec *rec)
+{
+    uint64_t range = r->span - r->start;
+
+    if (rec->size > r->max_size) {
+        rec->size = r->max_size;
+        r->clipped++;
+    }
+    if (rec->offset < r->start || rec->offset + rec->size > r->span) {
+        rec->offset = r->start + rec->offset % range;
+        rec->offset -= rec->offset % SECTOR_SIZE;
+        if (rec->offset + rec->size > r->span)
+            rec->offset = r->span - rec->size -
+                          (r->span - rec->size) % SECTOR_SIZE;
+        r->folded++;
+    }
+}
+
+/*
+ * The next request of the trace and when to issue it on the now_ns()
+ * clock, 0 for right away. Called by all threads of the job. Return 0,
+ * or -1 when the trace is done.
+ */
+int replay_next(struct replay *r, struct replay_rec *rec, uint64_t *due_ns)
+{
+    pthread_mutex_lock(&r->lock);
+    while (!r->eof && r->nr < REPLAY_WINDOW) {
+        struct replay_rec in;
+        if (read_record(r, &in) != 0) {
+            r->eof = 1;
+            break;
+        }
+        heap_push(r, &in);
+    }
+    if (r->nr == 0) {
+        pthread_mutex_unlock(&r->lock);
+        return -1;
+    }
+    heap_pop(r, rec);
+    if (!r->started) {
+        r->started = 1;
+        r->first_ns = r->last_ns = rec->ns;
+        r->base_ns = now_ns();
+    }
+    if (rec->ns < r->last_ns) {
+        r->late++;
+        rec->ns = r->last_ns;
+    }
+    r->last_ns = rec->ns;
+    r->records++;
+    fit_record(r, rec);
+    *due_ns = r->speed > 0 ? r->base_ns + (uint64_t)((rec->ns - r->first_ns) /
+                                                     r->speed)
+                           : 0;
+    pthread_mutex_unlock(&r->lock);
+    return 0;
+}
+
+void replay_close(struct replay *r)
+{
+    if (r == NULL)
+        return;
+    if (r->fp != NULL)
+        fclose(r->fp);
+    free(r->heap);
+    free(r);
+}
+
+/* the trace time the job covered, in s */
+static double trace_secs(const struct replay *r)
+{
+    return (r->last_ns - r->first_ns) / (double)NSEC_PER_SEC;
+}
+
+void print_replay_line(const struct job *job, const char *sep)
+{
+    const struct replay *r = job->replay;
+    uint64_t ios = job->total_hist[DDIR_TOTAL].count;
+
+    fprintf(GET_OUTPUT(output_file), "replay: file %s , speed %g , %s"
+            "records %llu , trace_time(s) %.3f , run_time(s) %.3f , %s"
+            "avg_lag(us) %.3f , max_lag(us) %.3f , %s"
+            "late %llu , folded %llu , clipped %llu , skipped_lines %llu\n",
+            job->replay_filename, r->speed, sep,
+            (unsigned long long)r->records, trace_secs(r),
+            job->wall_ns / (double)NSEC_PER_SEC, sep,
+            ios == 0 ? 0.0 : job->total_lag_ns / 1000.0 / ios,
+            job->max_lag_ns / 1000.0, sep,
+            (unsigned long long)r->late, (unsigned long long)r->folded,
+            (unsigned long long)r->clipped, (unsigned long long)r->skipped);
+}
+
+void replay_json(struct json_writer *w, const struct job *job)
+{
+    const struct replay *r = job->replay;
+    uint64_t ios = job->total_hist[DDIR_TOTAL].count;
+
+    json_object_begin(w, "replay");
+    json_string(w, "file", job->replay_filename);
+    json_double(w, "speed", r->speed);
+    json_uint(w, "records", r->records);
+    json_double(w, "trace_time_s", trace_secs(r));
+    json_double(w, "avg_lag_us",
+                ios == 0 ? 0.0 : job->total_lag_ns / 1000.0 / ios);
+    json_double(w, "max_lag_us", job->max_lag_ns / 1000.0);
+    json_uint(w, "late", r->late);
+    json_uint(w, "folded", r->folded);
+    json_uint(w, "clipped", r->clipped);
+    json_uint(w, "skipped_lines", r->skipped);
+    json_object_end(w);
+}
@@ -0,0 +1,62 @@
+/*
+ *   replay.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Trace replay (--replay, --replay_speed). Instead of generating offsets,
+ *   sizes and directions, the threads of a job take the requests of a
+ *   recorded trace, in time order, and issue each one at its original time
+ *   from the start of the trace divided by the speed. Speed 0 issues them
+ *   as fast as the -t threads with -q requests each allow. Requests go
+ *   through the job's IO engine like generated ones.
+ *
+ *   Traces are read in chunks through stdio, never as a whole. Accepted
+ *   are iombench binary traces (--trace), "io," text records (-P, with
+ *   1 s timestamps only) and blkparse text output, of which the queue (Q)
+ *   events are used, or the issue (D) events if the trace starts with one.
+ *   iombench traces are written per thread in flush order, so records pass
+ *   through a reorder window of REPLAY_WINDOW records; a record older than
+ *   one already issued goes out right away.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+
+#define REPLAY_WINDOW (1 << 16)
+#define REPLAY_BUFFER (1 << 20)     /* stdio buffer of the trace */
+#define REPLAY_LINE 512
+
+struct job;
+struct json_writer;
+
+struct replay_rec {
+    uint64_t ns;            /* trace time */
+    uint64_t offset;
+    uint32_t size;
+    int is_write;
+};
+
+struct replay;
+
+struct replay *replay_open(const struct job *job);
+int replay_next(struct replay *r, struct replay_rec *rec, uint64_t *due_ns);
+void replay_close(struct replay *r);
+void print_replay_line(const struct job *job, const char *sep);
+void replay_json(struct json_writer *w, const struct job *job);
+
+#endif /* REPLAY_H */
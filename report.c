@@ -0,0 +1,268 @@
+/*
+ *   report.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Interval reporter thread: the "interval:" console lines and the CSV or
+ *   JSON lines of --report_file.
+ */
+
+#include "iombench.h"
+#include "report.h"
+#include "gettime.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define REPORT_POLL_NS (10 * 1000 * 1000ULL)   /* stop flag check */
+
+static struct thread_data *report_threads;
+static int report_nr_threads;
+static FILE *report_file;
+static pthread_t reporter;
+static int report_done;
+
+struct interval_stats {
+    double iops;
+    double mbps;
+    double p50_us;
+    double p99_us;
+    double max_us;
+};
+
+/* sleep until target, return -1 early if report_stop() was called */
+static int wait_until(uint64_t target)
+{
+    for (;;) {
+        uint64_t now = now_ns();
+        struct timespec ts;
+        uint64_t delta;
+
+        if (__atomic_load_n(&report_done, __ATOMIC_ACQUIRE))
+            return -1;
+        if (now >= target)
+            return 0;
+        delta = target - now < REPORT_POLL_NS ? target - now : REPORT_POLL_NS;
+        ts.tv_sec = 0;
+        ts.tv_nsec = (long)delta;
+        nanosleep(&ts, NULL);
+    }
+}
+
+static void fill_stats(struct interval_stats *s, const struct histogram *h,
+                       uint64_t bytes, double secs)
+{
+    s->iops = h->count / secs;
+    s->mbps = bytes / secs / (1024 * 1024);
+    s->p50_us = hist_percentile(h, 50) / (double)NSEC_PER_USEC;
+    s->p99_us = hist_percentile(h, 99) / (double)NSEC_PER_USEC;
+    s->max_us = h->count > 0 ? h->max / (double)NSEC_PER_USEC : 0;
+}
+
+static void print_console(double t, const struct interval_stats *s)
+{
+    const char *sep = human_readable;
+    FILE *out = GET_OUTPUT(output_file);
+
+    fprintf(out, "interval: time(s) %.3f , %s"
+            "[ read_iops %.0f , read_bw(MB/s) %.2f , read_p50(us) %.1f , "
+            "read_p99(us) %.1f , read_max(us) %.1f ], %s"
+            "[ write_iops %.0f , write_bw(MB/s) %.2f , write_p50(us) %.1f , "
+            "write_p99(us) %.1f , write_max(us) %.1f ]\n", t, sep,
+            s[DDIR_READ].iops, s[DDIR_READ].mbps, s[DDIR_READ].p50_us,
+            s[DDIR_READ].p99_us, s[DDIR_READ].max_us, sep,
+            s[DDIR_WRITE].iops, s[DDIR_WRITE].mbps, s[DDIR_WRITE].p50_us,
+            s[DDIR_WRITE].p99_us, s[DDIR_WRITE].max_us);
+    fflush(out);
+}
+
+static void print_file(double t, const struct interval_stats *s)
+{
+    static const char *names[DDIR_RW] = { "read", "write" };
+    int d;
+
+    if (report_format == REPORT_CSV) {
+        fprintf(report_file, "%.3f", t);
+        for (d = 0; d < DDIR_RW; d++)
+            fprintf(report_file, ",%.0f,%.3f,%.1f,%.1f,%.1f", s[d].iops,
+                    s[d].mbps, s[d].p50_us, s[d].p99_us, s[d].max_us);
+        fprintf(report_file, "\n");
+    } else {
+        fprintf(report_file, "{\"time\": %.3f", t);
+        for (d = 0; d < DDIR_RW; d++)
+            fprintf(report_file, ", \"%s\": {\"iops\": %.0f, "
+                    "\"bw_mbps\": %.3f, \"p50_us\": %.1f, \"p99_us\": %.1f, "
+                    "\"max_us\": %.1f}", names[d], s[d].iops, s[d].mbps,
+                    s[d].p50_us, s[d].p99_us, s[d].max_us);
+        fprintf(report_file, "}\n");
+    }
+    fflush(report_file);
+}
+
+/* whether a thread ran, and was measured, for all of [begin, end) */
+static int thread_ran(struct thread_data *td, uint64_t begin)
+{
+    uint64_t start = __atomic_load_n(&td->start_ns, __ATOMIC_RELAXED);
+    uint64_t measure = __atomic_load_n(&td->measure_ns, __ATOMIC_RELAXED);
+    uint64_t end = __atomic_load_n(&td->end_ns, __ATOMIC_RELAXED);
+
+    return start != 0 && start <= begin && measure <= begin && end == 0;
+}
+
+static void add_sample(struct job *job, double iops, double bw)
+{
+    if (job->nr_samples == job->max_samples) {
+        int max = job->max_samples > 0 ? job->max_samples * 2 : 64;
+        double *i = realloc(job->iops_samples, sizeof(double) * max);
+        double *b = i == NULL ? NULL :
+                    realloc(job->bw_samples, sizeof(double) * max);
+        if (i != NULL)
+            job->iops_samples = i;
+        if (b == NULL) {
+            perror("add_sample:realloc()");
+            exit(errno);
+        }
+        job->bw_samples = b;
+        job->max_samples = max;
+    }
+    job->iops_samples[job->nr_samples] = iops;
+    job->bw_samples[job->nr_samples++] = bw;
+}
+
+int report_sample_interval(void)
+{
+    return report_interval > 0 ? report_interval : SAMPLE_INTERVAL_MS;
+}
+
+static void *report_loop(void *arg)
+{
+    int n = report_nr_threads * DDIR_RW;
+    struct histogram *prev = calloc(n, sizeof(struct histogram));
+    uint64_t *prev_bytes = calloc(n, sizeof(uint64_t));
+    struct histogram *ivl = malloc(sizeof(struct histogram) * DDIR_RW);
+    uint64_t *job_ios = malloc(sizeof(uint64_t) * nr_jobs);
+    uint64_t *job_bytes = malloc(sizeof(uint64_t) * nr_jobs);
+    int *job_ran = malloc(sizeof(int) * nr_jobs);
+    uint64_t start = now_ns(), last = start, next = start;
+    int console = report_interval > 0 && output_format == OUTPUT_TEXT;
+    (void)arg;
+
+    if (prev == NULL || prev_bytes == NULL || ivl == NULL ||
+        job_ios == NULL || job_bytes == NULL || job_ran == NULL) {
+        perror("report_loop:malloc()");
+        exit(errno);
+    }
+
+    for (;;) {
+        struct interval_stats stats[DDIR_RW];
+        uint64_t bytes[DDIR_RW] = { 0, 0 };
+        uint64_t now;
+        double secs;
+        int t, d;
+
+        next += (uint64_t)report_sample_interval() * 1000 * 1000;
+        if (wait_until(next) != 0)
+            break;
+
+        hist_init(&ivl[DDIR_READ]);
+        hist_init(&ivl[DDIR_WRITE]);
+        for (t = 0; t < nr_jobs; t++) {
+            job_ios[t] = job_bytes[t] = 0;
+            job_ran[t] = 1;
+        }
+        for (t = 0; t < report_nr_threads; t++) {
+            struct thread_data *td = &report_threads[t];
+            int j = td->job->index;
+            for (d = 0; d < DDIR_RW; d++) {
+                uint64_t b = __atomic_load_n(&td->io_bytes[d],
+                                             __ATOMIC_RELAXED);
+                uint64_t count = ivl[d].count;
+                hist_delta(&ivl[d], &prev[t * DDIR_RW + d], &td->hist[d]);
+                job_ios[j] += ivl[d].count - count;
+                job_bytes[j] += b - prev_bytes[t * DDIR_RW + d];
+                bytes[d] += b - prev_bytes[t * DDIR_RW + d];
+                prev_bytes[t * DDIR_RW + d] = b;
+            }
+            if (!thread_ran(td, last))
+                job_ran[j] = 0;
+        }
+        now = now_ns();
+        secs = (now - last) / (double)NSEC_PER_SEC;
+        last = now;
+
+        /* throughput samples only cover intervals a job fully ran in */
+        for (t = 0; t < nr_jobs; t++)
+            if (job_ran[t])
+                add_sample(&jobs[t], job_ios[t] / secs, job_bytes[t] / secs);
+
+        for (d = 0; d < DDIR_RW; d++)
+            fill_stats(&stats[d], &ivl[d], bytes[d], secs);
+        if (console)
+            print_console((now - start) / (double)NSEC_PER_SEC, stats);
+        if (report_file != NULL)
+            print_file((now - start) / (double)NSEC_PER_SEC, stats);
+    }
+
+    free(prev);
+    free(prev_bytes);
+    free(ivl);
+    free(job_ios);
+    free(job_bytes);
+    free(job_ran);
+    return NULL;
+}
+
+/*
+ * Start reporting on the given threads, whose histograms must already be
+ * initialized. Return 0, or -1 with errno set.
+ */
+int report_start(struct thread_data *threads, int nr_threads)
+{
+    int ret;
+
+    report_threads = threads;
+    report_nr_threads = nr_threads;
+    report_done = 0;
+    if (report_filename[0] != '\0') {
+        report_file = fopen(report_filename, "w");
+        if (report_file == NULL)
+            return -1;
+        if (report_format == REPORT_CSV)
+            fprintf(report_file, "time_s,read_iops,read_mbps,read_p50_us,"
+                    "read_p99_us,read_max_us,write_iops,write_mbps,"
+                    "write_p50_us,write_p99_us,write_max_us\n");
+    }
+
+    ret = pthread_create(&reporter, NULL, report_loop, NULL);
+    if (ret != 0) {
+        errno = ret;
+        return -1;
+    }
+    return 0;
+}
+
+/* stop after the IO threads are joined, a partial last interval is dropped */
+void report_stop(void)
+{
+    __atomic_store_n(&report_done, 1, __ATOMIC_RELEASE);
+    pthread_join(reporter, NULL);
+    if (report_file != NULL) {
+        fclose(report_file);
+        report_file = NULL;
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ *   report.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Live interval reports (--report_interval). A reporter thread wakes up
+ *   every interval, reads the IO threads' histograms and byte counters with
+ *   relaxed atomic loads and prints what changed since the last interval:
+ *   IOPS, bandwidth and p50/p99/max latency per direction. The IO threads
+ *   take no lock and do no extra work for it.
+ *
+ *   The same thread keeps per job IOPS and bandwidth samples of the
+ *   intervals a job ran through, for --output-format json and --compare.
+ */
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#define REPORT_CSV 0
+#define REPORT_JSON 1
+
+/* interval for the per job throughput samples without --report_interval */
+#define SAMPLE_INTERVAL_MS 1000
+
+struct thread_data;
+
+int report_start(struct thread_data *threads, int nr_threads);
+void report_stop(void);
+int report_sample_interval(void);
+
+#endif /* REPORT_H */
@@ -0,0 +1,235 @@
+/*
+ *   sweep.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   The points of a --sweep, saturation and the --slo_p99 search.
+ */
+
+#include "iombench.h"
+#include "ioengine.h"
+#include "sweep.h"
+#include "gettime.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct sweep_result {
+    int bs;                 /* as the point ran, once finalized */
+    int threads;
+    int iodepth;
+    int read_percent;
+    double iops;
+    double bw;              /* B/s */
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double max_us;
+};
+
+/*
+ * Parse a comma separated list of values, sizes like 4k with <sizes> set.
+ * Return 0, or -1 on malformed input.
+ */
+int sweep_parse_axis(struct sweep_axis *a, const char *list, int sizes)
+{
+    char copy[256];
+    char *save, *tok;
+
+    if (strlen(list) >= sizeof(copy))
+        return -1;
+    strcpy(copy, list);
+    a->nr = 0;
+    for (tok = strtok_r(copy, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save)) {
+        long long v;
+        char *end;
+        if (a->nr == SWEEP_MAX_VALUES)
+            return -1;
+        if (sizes) {
+            v = parse_size(tok);
+        } else {
+            v = strtoll(tok, &end, 10);
+            if (end == tok || *end != '\0')
+                return -1;
+        }
+        if (v < 0)
+            return -1;
+        a->v[a->nr++] = v;
+    }
+    return a->nr > 0 ? 0 : -1;
+}
+
+int sweep_enabled(const struct sweep_spec *s)
+{
+    return s->bs.nr > 0 || s->threads.nr > 0 || s->iodepth.nr > 0 ||
+           s->read.nr > 0 || s->slo_p99_us > 0;
+}
+
+/* the listed values, or the job's own one */
+static int axis_len(const struct sweep_axis *a)
+{
+    return a->nr > 0 ? a->nr : 1;
+}
+
+static long long axis_value(const struct sweep_axis *a, int i,
+                            long long own)
+{
+    return a->nr > 0 ? a->v[i] : own;
+}
+
+static void run_point(const struct job *point, struct sweep_result *r)
+{
+    struct job job = *point;
+    const struct histogram *h;
+    double secs;
+
+    run_single_job(&job);
+    r->bs = job.page_size;
+    r->threads = job.thread_count;
+    r->iodepth = job.iodepth;
+    r->read_percent = 100 - job.write_percent;
+    h = &job.total_hist[DDIR_TOTAL];
+    secs = job.wall_ns / (double)NSEC_PER_SEC;
+    r->iops = secs > 0 ? h->count / secs : 0.0;
+    r->bw = secs > 0 ? job.total_bytes / secs : 0.0;
+    r->mean_us = hist_mean(h) / 1000.0;
+    r->p50_us = hist_percentile(h, 50) / 1000.0;
+    r->p99_us = hist_percentile(h, 99) / 1000.0;
+    r->max_us = h->max / 1000.0;
+    free_job_stats(&job);
+}
+
+/* an open loop run at <offered> IOPS, return 1 if it kept the SLO */
+static int slo_trial(const struct sweep_spec *s, const struct job *point,
+                     double offered, double *achieved)
+{
+    struct job job = *point;
+    struct sweep_result r;
+
+    job.rate_iops = (long long)offered;
+    job.rate_global = 1;
+    run_point(&job, &r);
+    *achieved = r.iops;
+    return r.p99_us <= s->slo_p99_us && r.iops >= SLO_ACHIEVED * offered;
+}
+
+/* the most IOPS of <point> within the SLO, from its saturated run <sat> */
+static double slo_search(const struct sweep_spec *s, const struct job *point,
+                         const struct sweep_result *sat)
+{
+    double lo = 0, hi = sat->iops, best = 0, achieved;
+    int k;
+
+    if (sat->p99_us <= s->slo_p99_us)
+        return sat->iops;
+    for (k = 1; k < SLO_STEPS; k++) {
+        double offered = sat->iops * k / SLO_STEPS;
+        if (offered < 1)
+            continue;
+        if (!slo_trial(s, point, offered, &achieved)) {
+            hi = offered;
+            break;
+        }
+        lo = offered;
+        if (achieved > best)
+            best = achieved;
+    }
+    for (k = 0; k < SLO_REFINE; k++) {
+        double offered = (lo + hi) / 2;
+        if (offered < 1)
+            break;
+        if (slo_trial(s, point, offered, &achieved)) {
+            lo = offered;
+            if (achieved > best)
+                best = achieved;
+        } else {
+            hi = offered;
+        }
+    }
+    return best;
+}
+
+static void print_record(const struct sweep_result *r, int saturated,
+                         double slo_iops)
+{
+    FILE *out = GET_OUTPUT(output_file);
+
+    fprintf(out, "sweep,%d,%d,%d,%d,%.1f,%.0f,%.3f,%.3f,%.3f,%.3f,%d,%.1f\n",
+            r->bs, r->threads, r->iodepth, r->read_percent, r->iops, r->bw,
+            r->mean_us, r->p50_us, r->p99_us, r->max_us, saturated, slo_iops);
+    fflush(out);
+}
+
+/*
+ * Run the points of the sweep on the command line job <base>, which is not
+ * finalized yet, and print their records.
+ */
+void sweep_run(const struct sweep_spec *s, const struct job *base)
+{
+    struct job first = *base;
+    int load_is_depth = s->iodepth.nr > 1;
+    int b, r, t, q;
+
+    if (first.ioengine == NULL)
+        first.ioengine = find_ioengine(first.ioengine_name);
+    first.target_fd = open_target(&first);
+
+    fprintf(GET_OUTPUT(output_file), "# sweep,bs,threads,iodepth,"
+            "read_percent,iops,bw_bytes,mean_us,p50_us,p99_us,max_us,"
+            "saturated,slo_iops\n");
+    for (b = 0; b < axis_len(&s->bs); b++) {
+        for (r = 0; r < axis_len(&s->read); r++) {
+            double prev_iops = 0;
+            int run = 0;        /* saturated points in a row */
+            for (t = 0; t < axis_len(&s->threads); t++) {
+                if (load_is_depth) {
+                    prev_iops = 0;
+                    run = 0;
+                } else if (run >= 2) {
+                    break;
+                }
+                for (q = 0; q < axis_len(&s->iodepth); q++) {
+                    struct job point = first;
+                    struct sweep_result res;
+                    double slo_iops = 0;
+                    int saturated;
+
+                    if (load_is_depth && run >= 2)
+                        break;
+                    point.page_size = (int)axis_value(&s->bs, b,
+                                                      base->page_size);
+                    point.write_percent = 100 - (int)axis_value(&s->read, r,
+                                                 100 - base->write_percent);
+                    point.thread_count = (int)axis_value(&s->threads, t,
+                                                         base->thread_count);
+                    point.iodepth = (int)axis_value(&s->iodepth, q,
+                                                    base->iodepth);
+                    run_point(&point, &res);
+                    saturated = prev_iops > 0 &&
+                                res.iops < prev_iops * (1 + SWEEP_SAT_GAIN);
+                    run = saturated ? run + 1 : 0;
+                    prev_iops = res.iops;
+                    if (s->slo_p99_us > 0)
+                        slo_iops = slo_search(s, &point, &res);
+                    print_record(&res, saturated, slo_iops);
+                }
+            }
+        }
+    }
+    close(first.target_fd);
+}
@@ -0,0 +1,67 @@
+/*
+ *   sweep.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Parameter sweep (--sweep_bs, --sweep_threads, --sweep_iodepth,
+ *   --sweep_read) in one process. The command line job is run once per
+ *   combination of the listed values, block size outermost and queue depth
+ *   innermost, for -d seconds or -n requests each. The target is opened
+ *   once and its fd shared by the threads of every point; request buffers
+ *   are sized per point.
+ *
+ *   Each point gives one "sweep," record of a tidy dataset: the parameters,
+ *   IOPS, bandwidth and latency. Along the load axis (queue depth, or the
+ *   thread count with a single depth) a point is saturated when it gains
+ *   less than SWEEP_SAT_GAIN IOPS over the previous one; after two
+ *   saturated points in a row the rest of that axis is skipped.
+ *
+ *   With --slo_p99 every point is also searched for the most IOPS that keep
+ *   p99 within the SLO: if the saturated p99 is too high, open loop runs at
+ *   a global --rate_iops ramp the offered load in steps of 1/SLO_STEPS of
+ *   the saturated IOPS until one misses the SLO or falls short of its
+ *   offered load, then SLO_REFINE bisections narrow it down.
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#define SWEEP_MAX_VALUES 32
+#define SWEEP_SAT_GAIN 0.10         /* IOPS gain below which it saturated */
+#define SLO_STEPS 10
+#define SLO_REFINE 3
+#define SLO_ACHIEVED 0.95           /* share of the offered load to reach */
+
+struct job;
+
+struct sweep_axis {
+    int nr;                 /* 0: the job's own value */
+    long long v[SWEEP_MAX_VALUES];
+};
+
+struct sweep_spec {
+    struct sweep_axis bs;
+    struct sweep_axis threads;
+    struct sweep_axis iodepth;
+    struct sweep_axis read;         /* read percent */
+    double slo_p99_us;              /* 0: no search */
+};
+
+int sweep_parse_axis(struct sweep_axis *a, const char *list, int sizes);
+int sweep_enabled(const struct sweep_spec *s);
+void sweep_run(const struct sweep_spec *s, const struct job *base);
+
+#endif /* SWEEP_H */
@@ -0,0 +1,410 @@
+/*
+ *   target.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   The targets of a -f list, the mapping of requests onto them and their
+ *   stats.
+ */
+
+#include "iombench.h"
+#include "target.h"
+#include "gettime.h"
+#include "json.h"
+
+#include <errno.h>
+#include <glob.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+const char *target_mode_names[] = { "thread", "stripe" };
+
+/* a list, a glob or a range: anything but one plain file name */
+int target_is_list(const char *spec)
+{
+    return strpbrk(spec, ",@*?[") != NULL;
+}
+
+static int add_target(struct job *job, const char *name, off_t start,
+                      off_t end)
+{
+    struct target *t;
+
+    if (job->nr_targets == MAX_TARGETS) {
+        printf("more than %d targets in -f %s.\n", MAX_TARGETS,
+               job->filename);
+        return -1;
+    }
+    if (strlen(name) >= MAX_FILE_NAME_LENGTH) {
+        printf("target name %s is too long.\n", name);
+        return -1;
+    }
+    t = &job->targets[job->nr_targets++];
+    memset(t, 0, sizeof(*t));
+    strcpy(t->name, name);
+    t->start = start;
+    t->end = end;
+    return 0;
+}
+
+/* "<start>-<end>" of a path@range, sizes like 4g */
+static int parse_range(char *range, off_t *start, off_t *end)
+{
+    char *dash = strchr(range, '-');
+    long long s, e;
+
+    if (dash == NULL)
+        return -1;
+    *dash = '\0';
+    s = parse_size(range);
+    e = parse_size(dash + 1);
+    if (s < 0 || e < 0)
+        return -1;
+    /* sector aligned like -s and -S, inward */
+    s = (s + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+    e = e / SECTOR_SIZE * SECTOR_SIZE;
+    if (e <= s)
+        return -1;
+    *start = (off_t)s;
+    *end = (off_t)e;
+    return 0;
+}
+
+/* one item of the list: a path or a glob pattern, with an optional range */
+static int add_item(struct job *job, char *item)
+{
+    char *at = strrchr(item, '@');
+    off_t start = job->start_addr, end = job->seek_span;
+    glob_t g;
+    size_t i;
+    int ret = 0;
+
+    if (at != NULL) {
+        *at = '\0';
+        if (parse_range(at + 1, &start, &end) != 0) {
+            printf("incorrect range %s of target %s in -f, should be "
+                   "@<start>-<end>.\n", at + 1, item);
+            return -1;
+        }
+    }
+    if (item[0] == '\0') {
+        printf("empty target name in -f %s.\n", job->filename);
+        return -1;
+    }
+    if (strpbrk(item, "*?[") == NULL)
+        return add_target(job, item, start, end);
+
+    if (glob(item, 0, NULL, &g) != 0) {
+        printf("no file matches %s in -f.\n", item);
+        return -1;
+    }
+    for (i = 0; i < g.gl_pathc && ret == 0; i++)
+        ret = add_target(job, g.gl_pathv[i], start, end);
+    globfree(&g);
+    return ret;
+}
+
+/*
+ * Parse the -f list of a job into its targets and set the job's logical
+ * address range [start_addr, seek_span) the requests are generated on.
+ * Needs the block sizes finalized. Return 0, or -1 with a message printed.
+ */
+int target_setup_job(struct job *job)
+{
+    char copy[MAX_FILE_NAME_LENGTH];
+    char *save, *tok;
+    off_t len = 0;
+    int i;
+
+    job->targets = malloc(sizeof(struct target) * MAX_TARGETS);
+    if (job->targets == NULL) {
+        perror("target_setup_job:malloc()");
+        exit(errno);
+    }
+    job->nr_targets = 0;
+    strcpy(copy, job->filename);
+    for (tok = strtok_r(copy, ",", &save); tok != NULL;
+         tok = strtok_r(NULL, ",", &save))
+        if (add_item(job, tok) != 0)
+            return -1;
+    if (job->nr_targets == 0) {
+        printf("no target in -f %s.\n", job->filename);
+        return -1;
+    }
+
+    for (i = 0; i < job->nr_targets; i++) {
+        const struct target *t = &job->targets[i];
+        if (t->end <= t->start) {
+            printf("target %s has an empty address range [%lld, %lld).\n",
+                   t->name, (long long)t->start, (long long)t->end);
+            return -1;
+        }
+        if (i == 0 || t->end - t->start < len)
+            len = t->end - t->start;
+    }
+
+    if (job->target_mode == TARGET_MODE_THREAD) {
+        if (job->target_threads > 0)
+            job->thread_count = job->target_threads * job->nr_targets;
+        if (job->thread_count < job->nr_targets) {
+            printf("-t %d is fewer threads than the %d targets of "
+                   "--target_mode thread.\n", job->thread_count,
+                   job->nr_targets);
+            return -1;
+        }
+        for (i = 0; i < job->nr_targets; i++)
+            job->targets[i].threads = (job->thread_count - i +
+                                       job->nr_targets - 1) / job->nr_targets;
+        job->start_addr = 0;
+        job->seek_span = len;
+    } else {
+        off_t chunks = len / job->stripe_size;
+        if (chunks == 0) {
+            printf("the shortest target range, %lld bytes, is smaller than "
+                   "--stripe_size %lld.\n", (long long)len,
+                   job->stripe_size);
+            return -1;
+        }
+        for (i = 0; i < job->nr_targets; i++)
+            job->targets[i].threads = job->thread_count;
+        job->start_addr = 0;
+        job->seek_span = chunks * job->stripe_size * job->nr_targets;
+    }
+    return 0;
+}
+
+static int open_one(const struct job *job, int index)
+{
+    return open_target_path(job, job->targets[index].name);
+}
+
+/*
+ * Open the targets of an IO thread into td->fds: its own one in thread
+ * mode, all of them when striped.
+ */
+void target_open(struct thread_data *td)
+{
+    const struct job *job = td->job;
+    int i, n = job->nr_targets;
+
+    td->target_hist = malloc(sizeof(struct histogram) * DDIR_RW * n);
+    td->target_bytes = calloc(n, sizeof(uint64_t));
+    if (td->target_hist == NULL || td->target_bytes == NULL) {
+        perror("target_open:malloc()");
+        exit(errno);
+    }
+    for (i = 0; i < DDIR_RW * n; i++)
+        hist_init(&td->target_hist[i]);
+
+    if (job->target_mode == TARGET_MODE_THREAD) {
+        td->target = td->thread_id % n;
+        td->fd = open_one(job, td->target);
+        td->fds = &td->fd;
+        td->nr_fds = 1;
+        return;
+    }
+    td->target = -1;
+    td->fds = malloc(sizeof(int) * n);
+    if (td->fds == NULL) {
+        perror("target_open:malloc()");
+        exit(errno);
+    }
+    for (i = 0; i < n; i++)
+        td->fds[i] = open_one(job, i);
+    td->fd = td->fds[0];
+    td->nr_fds = n;
+}
+
+/*
+ * Move a request from the logical range to its target: set io_u->file and
+ * the offset on the target.
+ */
+void target_map(struct thread_data *td, struct io_u *io_u)
+{
+    const struct job *job = td->job;
+    off_t stripe = job->stripe_size;
+    off_t chunk, in;
+    int t;
+
+    if (job->target_mode == TARGET_MODE_THREAD) {
+        io_u->file = 0;
+        io_u->offset += job->targets[td->target].start;
+        return;
+    }
+    chunk = io_u->offset / stripe;
+    in = io_u->offset % stripe;
+    if (in + io_u->size > stripe)
+        in = stripe - io_u->size;
+    t = (int)(chunk % job->nr_targets);
+    io_u->file = t;
+    io_u->offset = job->targets[t].start +
+                   chunk / job->nr_targets * stripe + in;
+}
+
+void target_close(struct thread_data *td)
+{
+    int i;
+
+    for (i = 0; i < td->nr_fds; i++)
+        close(td->fds[i]);
+    if (td->fds != &td->fd)
+        free(td->fds);
+    td->fds = &td->fd;
+    td->nr_fds = 1;
+}
+
+/* fold the threads' per-target stats into the job's targets */
+void target_merge(struct job *job, struct thread_data *threads)
+{
+    int i, t;
+
+    for (t = 0; t < job->nr_targets; t++) {
+        struct target *tg = &job->targets[t];
+        hist_init(&tg->hist[DDIR_READ]);
+        hist_init(&tg->hist[DDIR_WRITE]);
+        hist_init(&tg->hist[DDIR_TOTAL]);
+        tg->bytes = 0;
+        for (i = 0; i < job->thread_count; i++) {
+            const struct thread_data *td = &threads[i];
+            hist_merge(&tg->hist[DDIR_READ],
+                       &td->target_hist[t * DDIR_RW + DDIR_READ]);
+            hist_merge(&tg->hist[DDIR_WRITE],
+                       &td->target_hist[t * DDIR_RW + DDIR_WRITE]);
+            tg->bytes += td->target_bytes[t];
+        }
+        hist_merge(&tg->hist[DDIR_TOTAL], &tg->hist[DDIR_READ]);
+        hist_merge(&tg->hist[DDIR_TOTAL], &tg->hist[DDIR_WRITE]);
+    }
+    for (i = 0; i < job->thread_count; i++) {
+        free(threads[i].target_hist);
+        free(threads[i].target_bytes);
+        threads[i].target_hist = NULL;
+        threads[i].target_bytes = NULL;
+    }
+}
+
+struct target_spread {
+    double iops_min;
+    double iops_max;
+    double lat_min;         /* average latency, ns */
+    double lat_max;
+    int slowest;            /* highest average latency */
+};
+
+static double target_iops(const struct job *job, const struct target *t)
+{
+    double secs = job->wall_ns / (double)NSEC_PER_SEC;
+
+    return secs > 0 ? t->hist[DDIR_TOTAL].count / secs : 0.0;
+}
+
+static void spread(const struct job *job, struct target_spread *s)
+{
+    int i;
+
+    memset(s, 0, sizeof(*s));
+    for (i = 0; i < job->nr_targets; i++) {
+        const struct target *t = &job->targets[i];
+        double iops = target_iops(job, t);
+        double lat = hist_mean(&t->hist[DDIR_TOTAL]);
+        if (i == 0 || iops < s->iops_min)
+            s->iops_min = iops;
+        if (i == 0 || iops > s->iops_max)
+            s->iops_max = iops;
+        if (i == 0 || lat < s->lat_min)
+            s->lat_min = lat;
+        if (i == 0 || lat > s->lat_max) {
+            s->lat_max = lat;
+            s->slowest = i;
+        }
+    }
+}
+
+static double ratio(double max, double min)
+{
+    return min > 0 ? max / min : 0.0;
+}
+
+void print_target_lines(const struct job *job, const char *sep)
+{
+    FILE *out = GET_OUTPUT(output_file);
+    uint64_t ios = job->total_hist[DDIR_TOTAL].count;
+    double secs = job->wall_ns / (double)NSEC_PER_SEC;
+    struct target_spread s;
+    int i;
+
+    for (i = 0; i < job->nr_targets; i++) {
+        const struct target *t = &job->targets[i];
+        const struct histogram *h = &t->hist[DDIR_TOTAL];
+        fprintf(out, "target: name %s , start_addr %lld , seek_span %lld , "
+                "threads %d , %sios %llu , share_percent %.1f , iops %.1f , "
+                "bw(MB/s) %.2f , %savg_latency(us) %.3f , p99(us) %.3f , "
+                "max(us) %.3f\n", t->name, (long long)t->start,
+                (long long)t->end, t->threads, sep,
+                (unsigned long long)h->count,
+                ios > 0 ? 100.0 * h->count / ios : 0.0, target_iops(job, t),
+                secs > 0 ? t->bytes / secs / (1024 * 1024) : 0.0, sep,
+                hist_mean(h) / 1000.0, hist_percentile(h, 99) / 1000.0,
+                h->max / 1000.0);
+    }
+    spread(job, &s);
+    fprintf(out, "targets: count %d , mode %s , stripe_size %lld , %s"
+            "iops_min %.1f , iops_max %.1f , iops_spread %.2f , %s"
+            "latency_spread %.2f , slowest %s , slowest_avg_latency(us) "
+            "%.3f\n", job->nr_targets, target_mode_names[job->target_mode],
+            job->target_mode == TARGET_MODE_STRIPE ? job->stripe_size : 0,
+            sep, s.iops_min, s.iops_max, ratio(s.iops_max, s.iops_min), sep,
+            ratio(s.lat_max, s.lat_min), job->targets[s.slowest].name,
+            s.lat_max / 1000.0);
+}
+
+void target_json(struct json_writer *w, const struct job *job)
+{
+    double secs = job->wall_ns / (double)NSEC_PER_SEC;
+    struct target_spread s;
+    int i;
+
+    spread(job, &s);
+    json_object_begin(w, "targets");
+    json_string(w, "mode", target_mode_names[job->target_mode]);
+    json_int(w, "stripe_size", job->target_mode == TARGET_MODE_STRIPE ?
+                               job->stripe_size : 0);
+    json_double(w, "iops_spread", ratio(s.iops_max, s.iops_min));
+    json_double(w, "latency_spread", ratio(s.lat_max, s.lat_min));
+    json_string(w, "slowest", job->targets[s.slowest].name);
+    json_array_begin(w, "list");
+    for (i = 0; i < job->nr_targets; i++) {
+        const struct target *t = &job->targets[i];
+        const struct histogram *h = &t->hist[DDIR_TOTAL];
+        json_object_begin(w, NULL);
+        json_string(w, "name", t->name);
+        json_int(w, "start_addr", (long long)t->start);
+        json_int(w, "seek_span", (long long)t->end);
+        json_int(w, "threads", t->threads);
+        json_uint(w, "read_ios", t->hist[DDIR_READ].count);
+        json_uint(w, "write_ios", t->hist[DDIR_WRITE].count);
+        json_uint(w, "bytes", t->bytes);
+        json_double(w, "iops", target_iops(job, t));
+        json_double(w, "bw_bytes", secs > 0 ? t->bytes / secs : 0.0);
+        json_double(w, "mean_us", hist_mean(h) / 1000.0);
+        json_double(w, "p99_us", hist_percentile(h, 99) / 1000.0);
+        json_double(w, "max_us", h->max / 1000.0);
+        json_object_end(w);
+    }
+    json_array_end(w);
+    json_object_end(w);
+}
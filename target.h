@@ -0,0 +1,86 @@
+/*
+ *   target.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Several targets in one job, e.g. the drives of a JBOF, to measure how
+ *   they scale together and which one holds the others back. -f takes a
+ *   comma separated list of paths and glob patterns, such as
+ *   "/dev/nvme*n1" or "a.dat@0-1g,b.dat@4g-5g". A path may end in
+ *   @<start>-<end>, its own address range [start, end); the others use
+ *   [-s, -S).
+ *
+ *   The job's requests are generated on one logical range, as for a single
+ *   file, and then mapped onto the targets by --target_mode:
+ *
+ *     thread   each thread works on one target, assigned round robin,
+ *              --target_threads gives each target that many threads. The
+ *              logical range is the length of the shortest target range,
+ *              from the start of each target's range.
+ *     stripe   every thread works on all targets, striped RAID-0 style:
+ *              chunk i of --stripe_size bytes is chunk i / N of target
+ *              i % N. A request never crosses a chunk.
+ *
+ *   Targets longer than the shortest range are used up to its length. A
+ *   "target:" line per target reports its IOPS, bandwidth and latency and
+ *   a "targets:" line the spread, max over min, of IOPS and of average
+ *   latency with the slowest target. Striped, a slow drive shows up as the
+ *   latency spread: every target gets the same share of the requests.
+ */
+
+#ifndef TARGET_H
+#define TARGET_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "histogram.h"
+
+#define MAX_TARGETS 256
+#define DEFAULT_STRIPE_SIZE (128 * 1024)
+
+/* --target_mode */
+#define TARGET_MODE_THREAD 0
+#define TARGET_MODE_STRIPE 1
+
+struct job;
+struct thread_data;
+struct io_u;
+struct json_writer;
+
+struct target {
+    char name[MAX_FILE_NAME_LENGTH];
+    off_t start;
+    off_t end;
+    int threads;            /* threads issuing to the target */
+
+    /* stats, merged from the job's threads */
+    struct histogram hist[DDIR_TOTAL + 1];
+    uint64_t bytes;
+};
+
+extern const char *target_mode_names[];
+
+int target_is_list(const char *spec);
+int target_setup_job(struct job *job);
+void target_open(struct thread_data *td);
+void target_map(struct thread_data *td, struct io_u *io_u);
+void target_close(struct thread_data *td);
+void target_merge(struct job *job, struct thread_data *threads);
+void print_target_lines(const struct job *job, const char *sep);
+void target_json(struct json_writer *w, const struct job *job);
+
+#endif /* TARGET_H */
@@ -0,0 +1,233 @@
+/*
+ *   trace.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Trace rings, the flusher thread and the binary to text converter.
+ */
+
+#include "iombench.h"
+#include "trace.h"
+#include "gettime.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_VERSION 1
+#define TRACE_IDLE_NS (1000 * 1000)     /* flusher poll interval */
+#define TRACE_FILE_BUFFER (1024 * 1024)
+#define TRACE_CONVERT_CHUNK 4096
+
+static struct trace_ring *rings;
+static int nr_rings;
+static FILE *trace_out;
+static int trace_binary;        /* else "io," text records */
+static int trace_done;
+static pthread_t flusher;
+static uint64_t nr_records;
+static uint64_t nr_stalls;
+
+static void print_text_rec(FILE *out, const struct trace_rec *rec)
+{
+    fprintf(out, "io,%ld,%s,%u,%lld,%llu\n",
+            (long)(rec->issue_ns / NSEC_PER_SEC),
+            rec->is_write ? "w" : "r", rec->size, (long long)rec->offset,
+            (unsigned long long)(rec->lat_ns / NSEC_PER_USEC));
+}
+
+/* write out what the ring holds now, return the number of records */
+static uint64_t drain_ring(struct trace_ring *r)
+{
+    uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = r->tail;
+    uint64_t n = head - tail;
+
+    while (tail < head) {
+        uint64_t pos = tail & r->mask;
+        uint64_t seg = head - tail;
+        if (seg > r->mask + 1 - pos)
+            seg = r->mask + 1 - pos;
+
+        if (trace_binary) {
+            fwrite(&r->recs[pos], sizeof(struct trace_rec), seg, trace_out);
+        } else {
+            uint64_t i;
+            for (i = 0; i < seg; i++)
+                print_text_rec(trace_out, &r->recs[pos + i]);
+        }
+        tail += seg;
+        __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+    }
+    return n;
+}
+
+/*
+ * Drain all rings until told to stop. The stop flag is read before the
+ * pass, so the last pass runs after every IO thread has finished.
+ */
+static void *trace_flusher(void *arg)
+{
+    struct timespec idle = { 0, TRACE_IDLE_NS };
+    (void)arg;
+
+    for (;;) {
+        int done = __atomic_load_n(&trace_done, __ATOMIC_ACQUIRE);
+        uint64_t n = 0;
+        int i;
+
+        for (i = 0; i < nr_rings; i++)
+            n += drain_ring(&rings[i]);
+        nr_records += n;
+        if (n == 0) {
+            if (done)
+                break;
+            nanosleep(&idle, NULL);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Allocate one ring per IO thread and start the flusher. Records go to
+ * the binary trace file <path>, or as text to <text_out> if path is NULL.
+ * Return NULL with errno set on failure.
+ */
+struct trace_ring *trace_start(int nr, const char *path, FILE *text_out)
+{
+    int i, ret;
+
+    rings = calloc(nr, sizeof(struct trace_ring));
+    if (rings == NULL)
+        return NULL;
+    nr_rings = nr;
+    for (i = 0; i < nr; i++) {
+        rings[i].recs = malloc(sizeof(struct trace_rec) * TRACE_RING_RECORDS);
+        if (rings[i].recs == NULL)
+            return NULL;
+        rings[i].mask = TRACE_RING_RECORDS - 1;
+    }
+
+    if (path != NULL) {
+        struct trace_header hdr;
+
+        trace_out = fopen(path, "wb");
+        if (trace_out == NULL)
+            return NULL;
+        setvbuf(trace_out, NULL, _IOFBF, TRACE_FILE_BUFFER);
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+        hdr.version = TRACE_VERSION;
+        hdr.record_size = sizeof(struct trace_rec);
+        fwrite(&hdr, sizeof(hdr), 1, trace_out);
+        trace_binary = 1;
+    } else {
+        trace_out = text_out;
+        trace_binary = 0;
+    }
+
+    ret = pthread_create(&flusher, NULL, trace_flusher, NULL);
+    if (ret != 0) {
+        errno = ret;
+        return NULL;
+    }
+    return rings;
+}
+
+/*
+ * Flush the remaining records and stop the flusher, after the IO threads
+ * have been joined. Return 0, or -1 with errno set if writing failed.
+ */
+int trace_stop(void)
+{
+    int i, err = 0;
+
+    __atomic_store_n(&trace_done, 1, __ATOMIC_RELEASE);
+    pthread_join(flusher, NULL);
+
+    for (i = 0; i < nr_rings; i++) {
+        nr_stalls += rings[i].stalls;
+        free(rings[i].recs);
+    }
+    free(rings);
+    rings = NULL;
+
+    if (ferror(trace_out))
+        err = EIO;
+    if (trace_binary && fclose(trace_out) != 0)
+        err = errno;
+    else if (!trace_binary)
+        fflush(trace_out);
+    trace_out = NULL;
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+uint64_t trace_records(void)
+{
+    return nr_records;
+}
+
+uint64_t trace_stalls(void)
+{
+    return nr_stalls;
+}
+
+/*
+ * Print a binary trace as "io," text records, the format -P writes and
+ * plot_details.sh reads. Return 0, -1 with errno set if the file cannot
+ * be read, -2 if it is not a trace file.
+ */
+int trace_convert(const char *path, FILE *out)
+{
+    struct trace_header hdr;
+    struct trace_rec *recs;
+    size_t n, i;
+    FILE *in = fopen(path, "rb");
+
+    if (in == NULL)
+        return -1;
+    if (fread(&hdr, sizeof(hdr), 1, in) != 1 ||
+        memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.record_size != sizeof(struct trace_rec)) {
+        fclose(in);
+        return -2;
+    }
+
+    recs = malloc(sizeof(struct trace_rec) * TRACE_CONVERT_CHUNK);
+    if (recs == NULL) {
+        fclose(in);
+        return -1;
+    }
+    while ((n = fread(recs, sizeof(struct trace_rec), TRACE_CONVERT_CHUNK,
+                      in)) > 0) {
+        for (i = 0; i < n; i++)
+            print_text_rec(out, &recs[i]);
+    }
+    free(recs);
+    n = ferror(in);
+    fclose(in);
+    if (n != 0) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
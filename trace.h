@@ -0,0 +1,91 @@
+/*
+ *   trace.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Per-IO trace records (-P, --trace). Each IO thread appends fixed-size
+ *   binary records to its own single-producer ring; a flusher thread drains
+ *   the rings either to a binary trace file or, for -P alone, to the usual
+ *   "io," text records. The IO path never formats text or takes the stdio
+ *   lock. --trace_convert turns a binary trace back into the text records.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_MAGIC "IOMBTRC1"
+#define TRACE_RING_RECORDS (1 << 16)    /* per thread, power of two */
+
+/* trace file: one header, then records in per-thread flush order */
+struct trace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+struct trace_rec {
+    uint64_t issue_ns;      /* epoch time of the (intended) start */
+    uint64_t offset;
+    uint64_t lat_ns;
+    uint32_t size;
+    uint32_t qdepth;        /* requests in flight, this one included */
+    uint16_t thread_id;     /* within the job */
+    uint8_t is_write;
+    uint8_t job;            /* job index, jobs from --jobfile */
+    uint8_t pad[4];
+};
+
+/*
+ * head is only written by the IO thread, tail only by the flusher. They
+ * sit on separate cache lines so the two threads do not share one.
+ */
+struct trace_ring {
+    struct trace_rec *recs;
+    uint64_t mask;
+    uint64_t stalls;        /* appends that found the ring full */
+    uint64_t head __attribute__((aligned(64)));
+    uint64_t tail __attribute__((aligned(64)));
+};
+
+/*
+ * Append a record. A full ring means the flusher fell behind; wait for it
+ * rather than drop records, and count the stall so the report shows it.
+ */
+static inline void trace_add(struct trace_ring *r, const struct trace_rec *rec)
+{
+    uint64_t head = r->head;
+
+    if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) > r->mask) {
+        r->stalls++;
+        while (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) > r->mask)
+            sched_yield();
+    }
+    r->recs[head & r->mask] = *rec;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+struct trace_ring *trace_start(int nr_rings, const char *path,
+                               FILE *text_out);
+int trace_stop(void);
+uint64_t trace_records(void);
+uint64_t trace_stalls(void);
+int trace_convert(const char *path, FILE *out);
+
+#endif /* TRACE_H */
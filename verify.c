@@ -0,0 +1,521 @@
+/*
+ *   verify.c
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   CRC32C, verify headers and payloads, the read checks and the verify
+ *   pass.
+ */
+
+#include "iombench.h"
+#include "verify.h"
+#include "gettime.h"
+#include "json.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#define CRC32C_POLY 0x82f63b78      /* reflected Castagnoli */
+
+static uint32_t crc_table[8][256];
+static uint32_t (*crc_fn)(uint32_t crc, const unsigned char *p, size_t len);
+static const char *crc_name = "table";
+static uint64_t verify_base_ns;     /* epoch ns, table times count from it */
+
+static const char *err_names[VERIFY_NR_ERRS] = {
+    "checksum", "offset", "stale", "lost"
+};
+
+/* slicing-by-8 */
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *p, size_t len)
+{
+    while (len > 0 && ((uintptr_t)p & 7) != 0) {
+        crc = crc_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        w ^= crc;
+        crc = crc_table[7][w & 0xff] ^
+              crc_table[6][(w >> 8) & 0xff] ^
+              crc_table[5][(w >> 16) & 0xff] ^
+              crc_table[4][(w >> 24) & 0xff] ^
+              crc_table[3][(w >> 32) & 0xff] ^
+              crc_table[2][(w >> 40) & 0xff] ^
+              crc_table[1][(w >> 48) & 0xff] ^
+              crc_table[0][w >> 56];
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0)
+        crc = crc_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char *p, size_t len)
+{
+    uint64_t c = crc;
+
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        c = __builtin_ia32_crc32di(c, w);
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0)
+        c = __builtin_ia32_crc32qi((uint32_t)c, *p++);
+    return (uint32_t)c;
+}
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+static uint32_t crc32c_arm(uint32_t crc, const unsigned char *p, size_t len)
+{
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        crc = __crc32cd(crc, w);
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0)
+        crc = __crc32cb(crc, *p++);
+    return crc;
+}
+#endif
+
+/* CRC32C of buf, continuing from a previous result crc (0 to start) */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+{
+    return ~crc_fn(~crc, buf, len);
+}
+
+const char *crc32c_impl(void)
+{
+    return crc_name;
+}
+
+void verify_init(void)
+{
+    int i, k;
+
+    for (i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (k = 0; k < 8; k++)
+            c = c & 1 ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        crc_table[0][i] = c;
+    }
+    for (i = 0; i < 256; i++)
+        for (k = 1; k < 8; k++)
+            crc_table[k][i] = (crc_table[k - 1][i] >> 8) ^
+                              crc_table[0][crc_table[k - 1][i] & 0xff];
+    crc_fn = crc32c_sw;
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc_fn = crc32c_sse42;
+        crc_name = "sse4.2";
+    }
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    crc_fn = crc32c_arm;
+    crc_name = "armv8";
+#endif
+    verify_base_ns = ns_to_epoch_ns(now_ns());
+}
+
+/* table time of an epoch ns timestamp, 0 is reserved for unknown */
+static inline uint32_t table_time(uint64_t epoch_ns)
+{
+    return (uint32_t)((epoch_ns - verify_base_ns) >> VERIFY_TIME_SHIFT) + 1;
+}
+
+/*
+ * Allocate the job's unit table if its blocks are owned by one thread each
+ * and no other job uses its file. Return 0, or -1 if the table is too large
+ * or cannot be allocated, in which case stale data is not detected.
+ */
+int verify_setup_job(struct job *job)
+{
+    struct verify_state *vs = &job->verify_state;
+    /* random IO, --full_coverage too: it deals the blocks out anew every
+     * pass, and threads run their passes at their own speed */
+    int owned = job->thread_count == 1 ||
+                (job->random_addr == 0 &&
+                 job->seq_layout != SEQ_LAYOUT_SHARED);
+    int i;
+
+    for (i = 0; i < nr_jobs; i++)
+        if (&jobs[i] != job && strcmp(jobs[i].filename, job->filename) == 0)
+            owned = 0;
+    if (!owned)
+        return 0;
+    vs->nr_units = (uint64_t)job->seek_span / job->verify_interval;
+    if (vs->nr_units > VERIFY_MAX_UNITS)
+        return -1;
+    /* zeroed pages are mapped on first write, untouched ranges cost nothing */
+    vs->table = calloc(vs->nr_units, sizeof(uint32_t));
+    return vs->table != NULL ? 0 : -1;
+}
+
+static inline uint64_t payload_seed(uint64_t offset, uint64_t issue_ns)
+{
+    uint64_t x = rand_seed ^ (offset * 0x9e3779b97f4a7c15ULL) ^ issue_ns;
+    return splitmix64(&x);
+}
+
+static inline void fill_payload(uint64_t *w, size_t words, uint64_t seed)
+{
+    size_t i;
+
+    for (i = 0; i < words; i++)
+        w[i] = splitmix64(&seed);
+}
+
+/* header and payload of every unit of a write request */
+void verify_fill(struct thread_data *td, struct io_u *io_u)
+{
+    const struct job *job = td->job;
+    int len = job->verify_interval;
+    uint64_t issue = ns_to_epoch_ns(td->now);
+    int off;
+
+    io_u->verify_time = issue;
+    io_u->verify_overlap = 0;
+    td->verify_seq++;
+    for (off = 0; off < io_u->size; off += len) {
+        struct verify_hdr *hdr = (struct verify_hdr *)(io_u->buf + off);
+        uint64_t offset = (uint64_t)io_u->offset + off;
+
+        hdr->magic = VERIFY_MAGIC;
+        hdr->crc = 0;
+        hdr->offset = offset;
+        hdr->seq = td->verify_seq;
+        hdr->issue_ns = issue;
+        hdr->seed = payload_seed(offset, issue);
+        hdr->job = (uint16_t)job->index;
+        hdr->thread = (uint16_t)td->thread_id;
+        hdr->len = (uint32_t)len;
+        fill_payload((uint64_t *)(hdr + 1),
+                     (len - sizeof(struct verify_hdr)) / 8, hdr->seed);
+        hdr->crc = crc32c(0, hdr, len);
+    }
+}
+
+/*
+ * Before a request is queued: with a unit table, mark it and any request of
+ * this thread in flight that it overlaps, if one of them writes.
+ */
+void verify_issue(struct thread_data *td, struct io_u *io_u)
+{
+    int i;
+
+    if (!io_u->is_write)
+        io_u->verify_overlap = 0;
+    if (td->job->verify_state.table != NULL) {
+        for (i = 0; i < td->job->iodepth; i++) {
+            struct io_u *o = &td->io_us[i];
+            if (!o->inflight || (!o->is_write && !io_u->is_write))
+                continue;
+            if (o->offset >= io_u->offset + io_u->size ||
+                io_u->offset >= o->offset + o->size)
+                continue;
+            /* a read may see either data, two writes may land in any order */
+            if (!o->is_write)
+                o->verify_overlap = 1;
+            else if (!io_u->is_write)
+                io_u->verify_overlap = 1;
+            else
+                o->verify_overlap = io_u->verify_overlap = 1;
+        }
+    }
+    io_u->inflight = 1;
+}
+
+static void report(struct thread_data *td, int kind, uint64_t offset,
+                   const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+/* count an error, and print it while there are few */
+static void report(struct thread_data *td, int kind, uint64_t offset,
+                   const char *fmt, ...)
+{
+    struct verify_state *vs = &td->job->verify_state;
+    FILE *out = GET_OUTPUT(output_file);
+    va_list ap;
+
+    __atomic_fetch_add(&vs->errors[kind], 1, __ATOMIC_RELAXED);
+    if (__atomic_fetch_add(&vs->reports, 1, __ATOMIC_RELAXED) >=
+        VERIFY_MAX_REPORTS)
+        return;
+    flockfile(out);
+    fprintf(out, "verify_error: job %s , thread %d , offset %llu , "
+            "kind %s , ", td->job->name, td->thread_id,
+            (unsigned long long)offset, err_names[kind]);
+    va_start(ap, fmt);
+    vfprintf(out, fmt, ap);
+    va_end(ap);
+    fprintf(out, "\n");
+    fflush(out);
+    funlockfile(out);
+}
+
+/* which payload bytes differ from what the header's seed generates */
+static void report_crc(struct thread_data *td, const struct verify_hdr *hdr,
+                       uint64_t offset, uint32_t stored, uint32_t computed)
+{
+    size_t len = td->job->verify_interval - sizeof(struct verify_hdr);
+    const unsigned char *data = (const unsigned char *)(hdr + 1);
+    unsigned char *expect = malloc(len);
+    size_t i, bad = 0, first = 0, last = 0;
+
+    if (expect == NULL || hdr->len != (uint32_t)td->job->verify_interval) {
+        free(expect);
+        report(td, VERIFY_ERR_CRC, offset, "stored 0x%08x , computed 0x%08x "
+               ", header len %u", stored, computed, hdr->len);
+        return;
+    }
+    fill_payload((uint64_t *)expect, len / 8, hdr->seed);
+    for (i = 0; i < len; i++) {
+        if (data[i] == expect[i])
+            continue;
+        if (bad++ == 0)
+            first = i;
+        last = i;
+    }
+    free(expect);
+    if (bad == 0)
+        report(td, VERIFY_ERR_CRC, offset, "stored 0x%08x , computed 0x%08x "
+               ", payload intact, header or checksum corrupted", stored,
+               computed);
+    else
+        report(td, VERIFY_ERR_CRC, offset, "stored 0x%08x , computed 0x%08x "
+               ", bad_bytes %zu of %zu , first %zu , last %zu (unit "
+               "relative, after the %zu byte header) , seq %llu", stored,
+               computed, bad, len, first, last, sizeof(struct verify_hdr),
+               (unsigned long long)hdr->seq);
+}
+
+/*
+ * Check one unit read at <offset>. <overlap> is set if a write of this
+ * thread was in flight over it during the read, so either data is right.
+ */
+static void check_unit(struct thread_data *td, struct verify_hdr *hdr,
+                       uint64_t offset, int overlap)
+{
+    struct verify_state *vs = &td->job->verify_state;
+    uint32_t len = (uint32_t)td->job->verify_interval;
+    uint32_t expect = 0, stored, computed;
+
+    td->verify_units++;
+    if (vs->table != NULL && !overlap && offset / len < vs->nr_units)
+        expect = vs->table[offset / len];
+
+    /* a unit of another --verify_interval is left over from an earlier run */
+    if (hdr->magic != VERIFY_MAGIC || hdr->len != len) {
+        if (expect != 0)
+            report(td, VERIFY_ERR_LOST, offset, "no header , magic 0x%08x , "
+                   "len %u although it was written", hdr->magic, hdr->len);
+        else
+            td->verify_unwritten++;
+        return;
+    }
+    stored = hdr->crc;
+    hdr->crc = 0;
+    computed = crc32c(0, hdr, len);
+    hdr->crc = stored;
+    if (stored != computed) {
+        report_crc(td, hdr, offset, stored, computed);
+        return;
+    }
+    if (hdr->offset != offset) {
+        report(td, VERIFY_ERR_OFFSET, offset, "holds the data of offset "
+               "%llu , job %u , thread %u , seq %llu",
+               (unsigned long long)hdr->offset, hdr->job, hdr->thread,
+               (unsigned long long)hdr->seq);
+        return;
+    }
+    if (expect != 0 && table_time(hdr->issue_ns) < expect)
+        report(td, VERIFY_ERR_STALE, offset, "holds seq %llu written %.3f "
+               "ms before the last completed write", (unsigned long long)
+               hdr->seq, (double)((uint64_t)(expect - table_time(
+               hdr->issue_ns)) << VERIFY_TIME_SHIFT) / 1e6);
+}
+
+/* after a request returned: check a read, record a write */
+void verify_complete(struct thread_data *td, struct io_u *io_u)
+{
+    struct verify_state *vs = &td->job->verify_state;
+    int len = td->job->verify_interval;
+    int off;
+
+    io_u->inflight = 0;
+    if (io_u->is_write) {
+        if (vs->table == NULL)
+            return;
+        for (off = 0; off + len <= io_u->result; off += len) {
+            uint64_t u = ((uint64_t)io_u->offset + off) / len;
+            uint32_t t = table_time(io_u->verify_time);
+            if (u >= vs->nr_units)
+                continue;
+            if (io_u->verify_overlap)
+                vs->table[u] = 0;
+            else if (t > vs->table[u])
+                vs->table[u] = t;
+        }
+        return;
+    }
+    /* a read at the end of a file still being written may be short, the
+     * rest of the buffer holds an older request */
+    for (off = 0; off + len <= io_u->result; off += len)
+        check_unit(td, (struct verify_hdr *)(io_u->buf + off),
+                   (uint64_t)io_u->offset + off, io_u->verify_overlap);
+}
+
+/* wait until all threads of the job got here */
+static void job_barrier(struct job *job)
+{
+    struct verify_state *vs = &job->verify_state;
+
+    __atomic_fetch_add(&vs->arrived, 1, __ATOMIC_ACQ_REL);
+    while (__atomic_load_n(&vs->arrived, __ATOMIC_ACQUIRE) <
+           job->thread_count) {
+        struct timespec ts = { 0, 1000 * 1000 };
+        nanosleep(&ts, NULL);
+    }
+}
+
+/*
+ * --verify_pass: once all threads of the job are done, read back this
+ * thread's share of [start_addr, seek_span) and check every unit. Return
+ * 0, or -errno on a read error.
+ */
+int verify_pass(struct thread_data *td)
+{
+    struct job *job = td->job;
+    uint64_t len = job->verify_interval;
+    uint64_t first = ((uint64_t)job->start_addr + len - 1) / len;
+    uint64_t last = (uint64_t)job->seek_span / len;
+    uint64_t n = last > first ? last - first : 0;
+    uint64_t u = first + n * td->thread_id / job->thread_count;
+    uint64_t end = first + n * (td->thread_id + 1) / job->thread_count;
+    uint64_t chunk = (uint64_t)job->page_size * job->iodepth / len;
+    uint64_t start;
+
+    job_barrier(job);
+    start = now_ns();
+    while (u < end) {
+        uint64_t count = end - u < chunk ? end - u : chunk;
+        ssize_t ret = pread(td->fd, td->buffers, count * len,
+                            (off_t)(u * len));
+        uint64_t i;
+
+        if (ret < 0)
+            return -errno;
+        if (ret == 0)
+            break;              /* past the end of a regular file */
+        count = (uint64_t)ret / len;
+        for (i = 0; i < count; i++)
+            check_unit(td, (struct verify_hdr *)(td->buffers + i * len),
+                       (u + i) * len, 0);
+        td->verify_pass_bytes += count * len;
+        if (count == 0)
+            break;
+        u += count;
+    }
+    td->verify_pass_ns = now_ns() - start;
+    return 0;
+}
+
+static void sum_threads(const struct job *job, uint64_t *units,
+                        uint64_t *unwritten, uint64_t *pass_ns,
+                        uint64_t *pass_bytes)
+{
+    int i;
+
+    *units = *unwritten = *pass_ns = *pass_bytes = 0;
+    for (i = 0; i < job->thread_count; i++) {
+        const struct thread_data *td = &job->threads[i];
+        *units += td->verify_units;
+        *unwritten += td->verify_unwritten;
+        *pass_bytes += td->verify_pass_bytes;
+        if (td->verify_pass_ns > *pass_ns)
+            *pass_ns = td->verify_pass_ns;
+    }
+}
+
+uint64_t verify_errors(const struct job *job)
+{
+    uint64_t n = 0;
+    int i;
+
+    for (i = 0; i < VERIFY_NR_ERRS; i++)
+        n += job->verify_state.errors[i];
+    return n;
+}
+
+/* "verify:" line */
+void print_verify_line(const struct job *job, const char *sep)
+{
+    const struct verify_state *vs = &job->verify_state;
+    uint64_t units, unwritten, pass_ns, pass_bytes;
+
+    sum_threads(job, &units, &unwritten, &pass_ns, &pass_bytes);
+    fprintf(GET_OUTPUT(output_file), "verify: interval %d , crc32c %s , "
+            "stale_check %d , %sunits_checked %llu , unwritten %llu , "
+            "checksum_errors %llu , offset_errors %llu , stale_errors %llu "
+            ", lost_errors %llu , %spass(s) %.3f , pass_bw(MB/s) %.2f\n",
+            job->verify_interval, crc32c_impl(), vs->table != NULL, sep,
+            (unsigned long long)units, (unsigned long long)unwritten,
+            (unsigned long long)vs->errors[VERIFY_ERR_CRC],
+            (unsigned long long)vs->errors[VERIFY_ERR_OFFSET],
+            (unsigned long long)vs->errors[VERIFY_ERR_STALE],
+            (unsigned long long)vs->errors[VERIFY_ERR_LOST], sep,
+            pass_ns / (double)NSEC_PER_SEC, pass_ns == 0 ? 0.0 :
+            pass_bytes / (pass_ns / (double)NSEC_PER_SEC) / (1024 * 1024));
+}
+
+void verify_json(struct json_writer *w, const struct job *job)
+{
+    const struct verify_state *vs = &job->verify_state;
+    uint64_t units, unwritten, pass_ns, pass_bytes;
+    int i;
+
+    sum_threads(job, &units, &unwritten, &pass_ns, &pass_bytes);
+    json_object_begin(w, "verify");
+    json_int(w, "interval", job->verify_interval);
+    json_string(w, "crc32c", crc32c_impl());
+    json_bool(w, "stale_check", vs->table != NULL);
+    json_uint(w, "units_checked", units);
+    json_uint(w, "unwritten", unwritten);
+    json_object_begin(w, "errors");
+    for (i = 0; i < VERIFY_NR_ERRS; i++)
+        json_uint(w, err_names[i], vs->errors[i]);
+    json_object_end(w);
+    json_double(w, "pass_s", pass_ns / (double)NSEC_PER_SEC);
+    json_uint(w, "pass_bytes", pass_bytes);
+    json_object_end(w);
+}
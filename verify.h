@@ -0,0 +1,98 @@
+/*
+ *   verify.h
+ *
+ *   Copyright 2014 Yongkun Wang
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ *
+ *   Data integrity verification (--verify, --verify_pass).
+ *
+ *   Written data is split into units of --verify_interval bytes. Each unit
+ *   starts with a header (its offset, the writer's sequence number and
+ *   issue time, the seed of the payload) followed by a payload generated
+ *   from the seed, and carries a CRC32C of the whole unit. Reads check every
+ *   unit they cover: a bad checksum is a torn or corrupted write, a header
+ *   for another offset a misdirected one. The payload is regenerated from
+ *   its seed to tell exactly which bytes differ.
+ *
+ *   When every block is written by only one thread (one thread, or split
+ *   or stride sequential layout) and by only one job, a
+ *   table keeps the issue time of the last completed write of each unit.
+ *   A read then also catches stale data and lost writes. A read that
+ *   overlaps a write in flight may see either data and is not checked
+ *   against the table, nor are units of two overlapping writes until they
+ *   are written again.
+ *
+ *   CRC32C uses the SSE4.2 or ARMv8 CRC instructions when the CPU has them,
+ *   otherwise slicing-by-8 tables.
+ */
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VERIFY_MAGIC 0x56424d49     /* "IMBV" */
+#define VERIFY_MAX_REPORTS 32       /* error lines per job */
+#define VERIFY_MAX_UNITS (1ULL << 28)   /* table size limit, 1 GB */
+#define VERIFY_TIME_SHIFT 16        /* table time unit 65 us, 3 days range */
+
+/* at the start of every unit, little endian as written by the host */
+struct verify_hdr {
+    uint32_t magic;
+    uint32_t crc;           /* CRC32C of the unit with this field 0 */
+    uint64_t offset;
+    uint64_t seq;           /* per thread write sequence number */
+    uint64_t issue_ns;      /* epoch ns of the write */
+    uint64_t seed;          /* of the payload */
+    uint16_t job;
+    uint16_t thread;
+    uint32_t len;           /* unit size */
+};
+
+/* error kinds */
+#define VERIFY_ERR_CRC 0
+#define VERIFY_ERR_OFFSET 1
+#define VERIFY_ERR_STALE 2
+#define VERIFY_ERR_LOST 3
+#define VERIFY_NR_ERRS 4
+
+struct job;
+struct thread_data;
+struct io_u;
+struct json_writer;
+
+/* per job state, in struct job */
+struct verify_state {
+    uint32_t *table;        /* per unit, 0 if unknown */
+    uint64_t nr_units;
+    uint64_t errors[VERIFY_NR_ERRS];
+    int reports;
+    int arrived;            /* threads at the verify pass barrier */
+};
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+const char *crc32c_impl(void);
+void verify_init(void);
+int verify_setup_job(struct job *job);
+void verify_fill(struct thread_data *td, struct io_u *io_u);
+void verify_issue(struct thread_data *td, struct io_u *io_u);
+void verify_complete(struct thread_data *td, struct io_u *io_u);
+int verify_pass(struct thread_data *td);
+uint64_t verify_errors(const struct job *job);
+void print_verify_line(const struct job *job, const char *sep);
+void verify_json(struct json_writer *w, const struct job *job);
+
+#endif /* VERIFY_H */